@@ -1,3 +1,3 @@
 [
-  inputs: ["*.exs", "{lib,test}/**/*.{ex,exs}"]
+  inputs: ["*.exs", "{bench,lib,test}/**/*.{ex,exs}"]
 ]
@@ -0,0 +1,355 @@
+# Benchmark suite for all NIFs with upstream libsecp256k1 baselines
+#
+#   mix bench [options]
+#
+# Options
+#   --time MS            time spent measuring every case (default 1000)
+#   --sizes LIST         comma separated input sizes for batch cases (default 1,10,100,1000)
+#   --concurrency LIST   comma separated numbers of parallel callers (default 1,<schedulers>)
+#   --only LIST          comma separated case name prefixes to run
+#   --output FILE        where to save results (default bench/results/<version>.csv)
+#   --compare FILE       previous results to compare against
+#   --upstream FILE      upstream `bench` binary (default built by `make bench-upstream`)
+#
+# Every case is run for every concurrency level, batch cases also for every size. Results are
+# saved as CSV with one row per case, size and concurrency. Timings are per call in
+# microseconds, throughput is in processed items (signatures, keys, signers) per second.
+
+defmodule Secp256k1.Bench do
+  alias Secp256k1.BIP32
+  alias Secp256k1.ECDH
+  alias Secp256k1.ECDSA
+  alias Secp256k1.ElligatorSwift
+  alias Secp256k1.MuSig
+  alias Secp256k1.Recovery
+  alias Secp256k1.Schnorr
+
+  @upstream "c_src/secp256k1/build-bench/bin/bench"
+
+  # NIF cases with single item inputs measured by the upstream benchmark as well
+  @upstream_names %{
+    "pubkey" => "ec_keygen",
+    "ecdsa_sign" => "ecdsa_sign",
+    "ecdsa_verify" => "ecdsa_verify",
+    "schnorr_sign" => "schnorrsig_sign",
+    "schnorr_verify" => "schnorrsig_verify",
+    "ecdh" => "ecdh",
+    "ellswift_create" => "ellswift_keygen",
+    "ellswift_xdh" => "ellswift_ecdh",
+    "recover" => "ecdsa_recover"
+  }
+
+  @header ~w(source name size concurrency iterations min_us avg_us max_us items_per_s)
+
+  def main(argv) do
+    {opts, _args} =
+      OptionParser.parse!(argv,
+        strict: [
+          time: :integer,
+          sizes: :string,
+          concurrency: :string,
+          only: :string,
+          output: :string,
+          compare: :string,
+          upstream: :string
+        ]
+      )
+
+    time = Keyword.get(opts, :time, 1000)
+    sizes = int_list(opts[:sizes], [1, 10, 100, 1_000])
+    concurrency = int_list(opts[:concurrency], Enum.uniq([1, System.schedulers_online()]))
+    only = if opts[:only], do: String.split(opts[:only], ","), else: [""]
+    output = Keyword.get(opts, :output, "bench/results/#{version()}.csv")
+
+    nif_results =
+      for {name, batch?, setup, run} <- cases(),
+          Enum.any?(only, &String.starts_with?(name, &1)),
+          size <- if(batch?, do: sizes, else: [1]),
+          level <- concurrency do
+        result = measure(name, size, level, time, setup, run)
+        print_row(result)
+        result
+      end
+
+    upstream_results = upstream(Keyword.get(opts, :upstream, @upstream))
+    results = nif_results ++ upstream_results
+
+    print_overhead(nif_results, upstream_results)
+    if opts[:compare], do: print_comparison(results, load(opts[:compare]))
+
+    save(output, results)
+    IO.puts("\nResults saved to #{output}")
+  end
+
+  # Cases are `{name, batch?, setup, run}`. `setup` gets the input size and returns the state
+  # passed to every `run` call, `run` processes `size` items.
+  defp cases do
+    [
+      {"pubkey", false, fn _ -> :crypto.strong_rand_bytes(32) end,
+       fn seckey -> Secp256k1.pubkey(seckey, :compressed) end},
+      {"ecdsa_sign", false, fn _ -> {msg_hash(), seckey()} end,
+       fn {msg_hash, seckey} -> ECDSA.sign(msg_hash, seckey) end},
+      {"ecdsa_sign_keypair", false, fn _ -> {msg_hash(), ECDSA.keypair(seckey())} end,
+       fn {msg_hash, keypair} -> ECDSA.sign(msg_hash, keypair) end},
+      {"ecdsa_verify", false, fn _ -> ecdsa_item() end,
+       fn {sig, msg_hash, pubkey} -> true = ECDSA.valid?(sig, msg_hash, pubkey) end},
+      {"ecdsa_verify_many", true, fn size -> Enum.map(1..size, fn _ -> ecdsa_item() end) end,
+       &ECDSA.valid_many/1},
+      {"ecdsa_parse_der_many", true,
+       fn size -> Enum.map(1..size, fn _ -> ECDSA.serialize_der(elem(ecdsa_item(), 0)) end) end,
+       &ECDSA.parse_der_many/1},
+      {"schnorr_sign", false, fn _ -> {msg_hash(), seckey()} end,
+       fn {msg_hash, seckey} -> Schnorr.sign(msg_hash, seckey) end},
+      {"schnorr_sign_keypair", false, fn _ -> {msg_hash(), Schnorr.keypair(seckey())} end,
+       fn {msg_hash, keypair} -> Schnorr.sign(msg_hash, keypair) end},
+      {"schnorr_verify", false, fn _ -> schnorr_item() end,
+       fn {sig, msg_hash, pubkey} -> true = Schnorr.valid?(sig, msg_hash, pubkey) end},
+      {"schnorr_verify_each", true, fn size -> Enum.map(1..size, fn _ -> schnorr_item() end) end,
+       fn batch -> true = Enum.all?(batch, fn {s, m, p} -> Schnorr.valid?(s, m, p) end) end},
+      {"schnorr_verify_batch", true,
+       fn size -> Enum.map(1..size, fn _ -> schnorr_item() end) end,
+       fn batch -> true = Schnorr.valid_batch?(batch) end},
+      {"ecdh", false, fn _ -> {seckey(), elem(Secp256k1.keypair(:compressed), 1)} end,
+       fn {seckey, pubkey} -> ECDH.ecdh(seckey, pubkey) end},
+      {"ecdh_many", true,
+       fn size ->
+         pubkeys = for _ <- 1..size, do: elem(Secp256k1.keypair(:compressed), 1)
+         {ECDH.keypair(seckey()), pubkeys}
+       end, fn {keypair, pubkeys} -> ECDH.ecdh_many(keypair, pubkeys) end},
+      {"ellswift_create", false, fn _ -> seckey() end, &ElligatorSwift.create/1},
+      {"ellswift_xdh", false, fn _ -> ellswift_item() end,
+       fn {ell_a, ell_b, seckey} -> ElligatorSwift.xdh(ell_a, ell_b, seckey, :initiator) end},
+      {"recover", false, fn _ -> recoverable_item() end,
+       fn {sig, msg_hash} -> Recovery.recover(sig, msg_hash) end},
+      {"recover_many", true, fn size -> Enum.map(1..size, fn _ -> recoverable_item() end) end,
+       &Recovery.recover_many/1},
+      {"musig_round", true, &musig_setup/1, &musig_round/1},
+      {"bip32_range", true, &bip32_setup/1,
+       fn {parent, range} -> BIP32.derive_range(parent, range) end}
+    ]
+  end
+
+  defp seckey, do: :crypto.strong_rand_bytes(32)
+  defp msg_hash, do: :crypto.strong_rand_bytes(32)
+
+  defp bip32_setup(size) do
+    xpub = 32 |> :crypto.strong_rand_bytes() |> BIP32.master_key() |> BIP32.xpub()
+    {BIP32.parent(xpub), 0..(size - 1)}
+  end
+
+  defp ecdsa_item do
+    {seckey, pubkey} = Secp256k1.keypair(:compressed)
+    msg_hash = msg_hash()
+    {ECDSA.sign(msg_hash, seckey), msg_hash, pubkey}
+  end
+
+  defp ellswift_item do
+    seckey = seckey()
+    {ElligatorSwift.create(seckey), ElligatorSwift.create(seckey()), seckey}
+  end
+
+  defp schnorr_item do
+    {seckey, pubkey} = Secp256k1.keypair(:xonly)
+    msg_hash = msg_hash()
+    {Schnorr.sign(msg_hash, seckey), msg_hash, pubkey}
+  end
+
+  defp recoverable_item do
+    msg_hash = msg_hash()
+    {Recovery.sign(msg_hash, seckey()), msg_hash}
+  end
+
+  defp musig_setup(size) do
+    {Enum.map(1..size, fn _ -> Secp256k1.keypair(:compressed) end), msg_hash()}
+  end
+
+  # Full signing session: key aggregation, nonces, partial signatures and final verification
+  defp musig_round({signers, msg_hash}) do
+    {:ok, agg_pubkey, cache} = signers |> Enum.map(&elem(&1, 1)) |> MuSig.pubkey_agg()
+
+    nonces =
+      Enum.map(signers, fn {seckey, pubkey} ->
+        {:ok, secnonce, pubnonce} = MuSig.nonce_gen(seckey, pubkey, msg_hash, cache, nil)
+        {secnonce, pubnonce}
+      end)
+
+    aggnonce = nonces |> Enum.map(&elem(&1, 1)) |> MuSig.nonce_agg()
+    session = MuSig.nonce_process(aggnonce, msg_hash, cache)
+
+    partial_sigs =
+      Enum.zip_with(signers, nonces, fn {seckey, _pubkey}, {secnonce, _pubnonce} ->
+        MuSig.partial_sign(secnonce, seckey, cache, session)
+      end)
+
+    signature = MuSig.partial_sig_agg(session, partial_sigs)
+    true = Schnorr.valid?(signature, msg_hash, agg_pubkey)
+  end
+
+  # Measurement
+
+  defp measure(name, size, concurrency, time, setup, run) do
+    state = setup.(size)
+
+    # warm up and make sure the case works before spawning the callers
+    run.(state)
+
+    started = System.monotonic_time(:microsecond)
+    deadline = started + time * 1000
+
+    stats =
+      1..concurrency
+      |> Enum.map(fn _ -> Task.async(fn -> loop(run, state, deadline, {0, :infinity, 0, 0}) end) end)
+      |> Task.await_many(:infinity)
+
+    elapsed = System.monotonic_time(:microsecond) - started
+
+    {iterations, min, max, total} =
+      Enum.reduce(stats, {0, :infinity, 0, 0}, fn {n, mi, ma, t}, {an, ami, ama, at} ->
+        {an + n, min(mi, ami), max(ma, ama), at + t}
+      end)
+
+    %{
+      source: "nif",
+      name: name,
+      size: size,
+      concurrency: concurrency,
+      iterations: iterations,
+      min_us: min / 1000,
+      avg_us: total / iterations / 1000,
+      max_us: max / 1000,
+      items_per_s: iterations * size * 1_000_000 / elapsed
+    }
+  end
+
+  defp loop(run, state, deadline, {n, min, max, total}) do
+    started = System.monotonic_time(:nanosecond)
+    run.(state)
+    now = System.monotonic_time(:nanosecond)
+    duration = now - started
+    acc = {n + 1, min(min, duration), max(max, duration), total + duration}
+
+    if System.convert_time_unit(now, :nanosecond, :microsecond) < deadline do
+      loop(run, state, deadline, acc)
+    else
+      acc
+    end
+  end
+
+  # Upstream baseline
+
+  defp upstream(path) do
+    if File.exists?(path) do
+      IO.puts("\nRunning upstream #{path}")
+      {output, 0} = System.cmd(path, [])
+      parse_upstream(output)
+    else
+      IO.puts("\nUpstream benchmark not found at #{path}, run `make bench-upstream` to build it")
+      []
+    end
+  end
+
+  # Upstream prints `name, min, avg, max` rows with timings in microseconds
+  defp parse_upstream(output) do
+    for line <- String.split(output, "\n"),
+        [name, min, avg, max] <- [line |> String.split(",") |> Enum.map(&String.trim/1)],
+        {min, ""} <- [Float.parse(min)],
+        {avg, ""} <- [Float.parse(avg)],
+        {max, ""} <- [Float.parse(max)] do
+      %{
+        source: "upstream",
+        name: name,
+        size: 1,
+        concurrency: 1,
+        iterations: 0,
+        min_us: min,
+        avg_us: avg,
+        max_us: max,
+        items_per_s: 1_000_000 / avg
+      }
+    end
+  end
+
+  # Reporting
+
+  defp print_row(r) do
+    IO.puts(
+      String.pad_trailing(r.name, 24) <>
+        String.pad_leading("n=#{r.size}", 8) <>
+        String.pad_leading("c=#{r.concurrency}", 6) <>
+        String.pad_leading(format(r.avg_us) <> " us", 16) <>
+        String.pad_leading(format(r.items_per_s) <> " items/s", 24)
+    )
+  end
+
+  defp print_overhead(_nif_results, []), do: :ok
+
+  defp print_overhead(nif_results, upstream_results) do
+    IO.puts("\nNIF overhead against upstream (single caller)")
+
+    for %{name: name, size: 1, concurrency: 1, avg_us: avg} <- nif_results,
+        %{avg_us: upstream_avg} <-
+          Enum.filter(upstream_results, &(&1.name == @upstream_names[name])) do
+      IO.puts(
+        String.pad_trailing(name, 24) <>
+          String.pad_leading(format(avg) <> " us", 16) <>
+          String.pad_leading(format(upstream_avg) <> " us", 16) <>
+          String.pad_leading("+" <> format(avg - upstream_avg) <> " us", 16)
+      )
+    end
+  end
+
+  defp print_comparison(results, previous) do
+    IO.puts("\nChange of average call time against previous results")
+
+    previous = Map.new(previous, &{key(&1), &1})
+
+    for result <- results, %{avg_us: before} <- [previous[key(result)]] do
+      change = (result.avg_us - before) / before * 100
+
+      IO.puts(
+        String.pad_trailing("#{result.source}/#{result.name}", 32) <>
+          String.pad_leading("n=#{result.size}", 8) <>
+          String.pad_leading("c=#{result.concurrency}", 6) <>
+          String.pad_leading(:erlang.float_to_binary(change, decimals: 1) <> " %", 12)
+      )
+    end
+  end
+
+  defp key(r), do: {r.source, r.name, r.size, r.concurrency}
+
+  defp format(value) when is_float(value), do: :erlang.float_to_binary(value, decimals: 2)
+
+  # CSV
+
+  defp save(path, results) do
+    rows =
+      Enum.map(results, fn r ->
+        @header |> Enum.map_join(",", &to_string(Map.fetch!(r, String.to_atom(&1))))
+      end)
+
+    File.mkdir_p!(Path.dirname(path))
+    File.write!(path, Enum.join([Enum.join(@header, ",") | rows], "\n") <> "\n")
+  end
+
+  defp load(path) do
+    [header | rows] = path |> File.read!() |> String.split("\n", trim: true)
+    fields = header |> String.split(",") |> Enum.map(&String.to_atom/1)
+
+    Enum.map(rows, fn row ->
+      fields
+      |> Enum.zip(String.split(row, ","))
+      |> Map.new(fn
+        {field, value} when field in [:source, :name] -> {field, value}
+        {field, value} when field in [:size, :concurrency, :iterations] -> {field, String.to_integer(value)}
+        {field, value} -> {field, String.to_float(value)}
+      end)
+    end)
+  end
+
+  defp int_list(nil, default), do: default
+  defp int_list(list, _default), do: list |> String.split(",") |> Enum.map(&String.to_integer/1)
+
+  defp version, do: :lib_secp256k1 |> Application.spec(:vsn) |> to_string()
+end
+
+Secp256k1.Bench.main(System.argv())
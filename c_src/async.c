@@ -0,0 +1,473 @@
+#include "utils.h"
+
+#include <stdint.h>
+#include <secp256k1_extrakeys.h>
+#include <secp256k1_schnorrsig.h>
+
+#define MAX_THREADS 1024
+
+#define SCHEME_ECDSA 0
+#define SCHEME_SCHNORR 1
+
+/* Verification worker pool
+ *
+ * Jobs are queued by the calling process and verified by native threads
+ * started at load time, the result is sent back as `{ref, result}` so the
+ * caller neither blocks nor occupies a dirty scheduler. Every job owns a
+ * process independent environment with copies of its arguments, which is
+ * also used to send the result. The queue is bounded by the number of queued
+ * items (signatures), a full queue rejects new jobs instead of growing
+ * without limit.
+ *
+ * Changing the number of threads waits for the running jobs, so it runs on a
+ * dirty IO scheduler. Worker `i` reuses the stats slot of the previous worker
+ * `i`, restarts don't allocate new slots.
+ *
+ * Verification uses only public data so the workers share the base `ctx`. */
+
+typedef struct async_job {
+  struct async_job *next;
+  ErlNifEnv *env;        // owns the copied terms below
+  ErlNifPid pid;
+  ERL_NIF_TERM ref;
+  ERL_NIF_TERM items;    // one `{sig, msg, pubkey}` or list of them
+  unsigned int n_items;
+  int scheme;
+  int many;
+} async_job;
+
+static struct {
+  ErlNifMutex *lock;       // guards the queue and `stop`
+  ErlNifCond *cond;
+  ErlNifMutex *resize;     // serializes starting and stopping of threads
+  async_job *head, *tail;
+  unsigned int queued;     // items, atomic, written under `lock`
+  unsigned int max_queue;  // atomic
+  int stop;
+  unsigned int n_threads;  // atomic, written under `resize`
+  unsigned int requested;  // atomic, written under `resize`, last requested `n_threads`
+  int failed;              // atomic, no worker could be started
+  ErlNifTid *tids;
+  stats_slot *stats_slots[MAX_THREADS];  // of worker `i`, kept across restarts
+  unsigned long completed; // atomic
+  unsigned long rejected;  // atomic
+} pool;
+
+static void
+free_job(async_job *job)
+{
+  if (job->env) {
+    enif_free_env(job->env);
+  }
+  enif_free(job);
+}
+
+/* Verifies one item already checked by `check_item`, invalid pubkeys are just
+ * invalid signatures */
+static int
+verify_item(ErlNifEnv *env, int scheme, ERL_NIF_TERM item)
+{
+  const ERL_NIF_TERM *tuple;
+  ErlNifBinary sig, msg, pubkey;
+  secp256k1_ecdsa_signature ecdsa_sig;
+  secp256k1_pubkey ecdsa_pubkey;
+  secp256k1_xonly_pubkey xonly_pubkey;
+  int arity;
+
+  enif_get_tuple(env, item, &arity, &tuple);
+  enif_inspect_binary(env, tuple[0], &sig);
+  enif_inspect_binary(env, tuple[1], &msg);
+  enif_inspect_binary(env, tuple[2], &pubkey);
+
+  if (scheme == SCHEME_ECDSA) {
+    return secp256k1_ecdsa_signature_parse_compact(ctx, &ecdsa_sig, sig.data) &&
+           secp256k1_ec_pubkey_parse(ctx, &ecdsa_pubkey, pubkey.data, pubkey.size) &&
+           secp256k1_ecdsa_verify(ctx, &ecdsa_sig, msg.data, &ecdsa_pubkey);
+  }
+
+  return secp256k1_xonly_pubkey_parse(ctx, &xonly_pubkey, pubkey.data) &&
+         secp256k1_schnorrsig_verify(ctx, sig.data, msg.data, msg.size, &xonly_pubkey);
+}
+
+/* Runs the job and sends `{ref, result}`, result is a boolean for single
+ * item and list of booleans for lists */
+static void
+run_job(async_job *job)
+{
+  ERL_NIF_TERM head, tail, result, list = job->items;
+  unsigned int valid = 0, length = 0;
+  ErlNifTime start;
+  int ok;
+
+  start = stats_start();
+
+  if (!job->many) {
+    ok = verify_item(job->env, job->scheme, job->items);
+    stats_record(STATS_VERIFY, start, ok);
+    result = enif_make_atom(job->env, ok ? "true" : "false");
+  } else {
+    result = enif_make_list(job->env, 0);
+    while (enif_get_list_cell(job->env, list, &head, &tail)) {
+      ok = verify_item(job->env, job->scheme, head);
+      result = enif_make_list_cell(job->env, enif_make_atom(job->env, ok ? "true" : "false"), result);
+      valid += ok;
+      length++;
+      list = tail;
+    }
+
+    stats_record(STATS_VERIFY_BATCH, start, valid == length);
+    enif_make_reverse_list(job->env, result, &result);
+  }
+
+  // counted before sending so the count includes every result already received
+  __atomic_add_fetch(&pool.completed, 1, __ATOMIC_RELAXED);
+  enif_send(NULL, &job->pid, job->env, enif_make_tuple2(job->env, job->ref, result));
+}
+
+static void *
+async_worker(void *arg)
+{
+  unsigned int index = (unsigned int)(uintptr_t)arg;
+  async_job *job;
+
+  // only one worker with the index runs at a time, the slot keeps a single writer
+  if (pool.stats_slots[index]) {
+    enif_tsd_set(stats_slot_key, pool.stats_slots[index]);
+  } else {
+    pool.stats_slots[index] = new_stats_slot();
+  }
+
+  for (;;) {
+    enif_mutex_lock(pool.lock);
+    while (!pool.stop && !pool.head) {
+      enif_cond_wait(pool.cond, pool.lock);
+    }
+    if (pool.stop) {
+      enif_mutex_unlock(pool.lock);
+      break;
+    }
+
+    job = pool.head;
+    pool.head = job->next;
+    if (!pool.head) {
+      pool.tail = NULL;
+    }
+    __atomic_sub_fetch(&pool.queued, job->n_items, __ATOMIC_RELAXED);
+    enif_mutex_unlock(pool.lock);
+
+    run_job(job);
+    free_job(job);
+  }
+
+  release_context_slot();
+  return NULL;
+}
+
+// Stops and joins all workers, queued jobs are kept. Call with `pool.resize`.
+static void
+stop_workers(void)
+{
+  unsigned int i;
+
+  enif_mutex_lock(pool.lock);
+  pool.stop = 1;
+  enif_cond_broadcast(pool.cond);
+  enif_mutex_unlock(pool.lock);
+
+  for (i = 0; i < pool.n_threads; i++) {
+    enif_thread_join(pool.tids[i], NULL);
+  }
+  if (pool.tids) {
+    enif_free(pool.tids);
+  }
+  pool.tids = NULL;
+  __atomic_store_n(&pool.n_threads, 0, __ATOMIC_RELAXED);
+
+  enif_mutex_lock(pool.lock);
+  pool.stop = 0;
+  enif_mutex_unlock(pool.lock);
+}
+
+/* Starts `threads` workers, returns 0 when none could be started and new
+ * jobs are rejected until a later start succeeds. Call with `pool.resize`. */
+static int
+start_workers(unsigned int threads)
+{
+  unsigned int n = 0;
+
+  __atomic_store_n(&pool.requested, threads, __ATOMIC_RELAXED);
+  pool.tids = enif_alloc(threads * sizeof(ErlNifTid));
+  while (pool.tids && n < threads &&
+         enif_thread_create("secp256k1_async", &pool.tids[n], async_worker, (void *)(uintptr_t)n, NULL) == 0) {
+    n++;
+  }
+
+  __atomic_store_n(&pool.n_threads, n, __ATOMIC_RELAXED);
+  __atomic_store_n(&pool.failed, n == 0, __ATOMIC_RELAXED);
+  return n > 0;
+}
+
+/* Load info is `{threads, max_queue}` */
+static int
+async_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
+{
+  const ERL_NIF_TERM *info;
+  unsigned int threads, max_queue;
+  int arity;
+
+  if (!enif_get_tuple(env, load_info, &arity, &info) || arity != 2 ||
+      !enif_get_uint(env, info[0], &threads) || !enif_get_uint(env, info[1], &max_queue) ||
+      threads == 0 || threads > MAX_THREADS) {
+    return -1;
+  }
+
+  // Initialize the library context via utils.h's load
+  if (load(env, priv, load_info) != 0) {
+    return -1;
+  }
+
+  memset(&pool, 0, sizeof(pool));
+  pool.max_queue = max_queue;
+  pool.lock = enif_mutex_create("secp256k1_async");
+  pool.cond = enif_cond_create("secp256k1_async");
+  pool.resize = enif_mutex_create("secp256k1_async_resize");
+  if (!pool.lock || !pool.cond || !pool.resize) {
+    return -1;
+  }
+
+  return start_workers(threads) ? 0 : -1;
+}
+
+static void
+async_unload(ErlNifEnv *env, void *priv)
+{
+  async_job *job;
+
+  stop_workers();
+
+  // callers of the jobs still queued never get the result
+  while ((job = pool.head)) {
+    pool.head = job->next;
+    free_job(job);
+  }
+
+  enif_mutex_destroy(pool.resize);
+  enif_cond_destroy(pool.cond);
+  enif_mutex_destroy(pool.lock);
+  unload(env, priv);
+}
+
+/* Checks `{sig, msg, pubkey}` item of the scheme */
+static int
+check_item(ErlNifEnv *env, int scheme, ERL_NIF_TERM item)
+{
+  const ERL_NIF_TERM *tuple;
+  ErlNifBinary sig, msg, pubkey;
+  int arity;
+
+  if (!enif_get_tuple(env, item, &arity, &tuple) || arity != 3 ||
+      !enif_inspect_binary(env, tuple[0], &sig) ||
+      !enif_inspect_binary(env, tuple[1], &msg) ||
+      !enif_inspect_binary(env, tuple[2], &pubkey) ||
+      sig.size != 64) {
+    return 0;
+  }
+
+  if (scheme == SCHEME_ECDSA) {
+    return msg.size == 32 && (pubkey.size == 33 || pubkey.size == 65);
+  }
+
+  return pubkey.size == 32;
+}
+
+// Whether `n_items` more fit into the queue with `queued` items
+static int
+queue_has_room(unsigned int queued, unsigned int n_items)
+{
+  unsigned int max_queue = __atomic_load_n(&pool.max_queue, __ATOMIC_RELAXED);
+
+  return queued <= max_queue && n_items <= max_queue - queued;
+}
+
+/* Queues job of the calling process, argv is `scheme, item(s), ref` */
+static ERL_NIF_TERM
+submit(ErlNifEnv *env, const ERL_NIF_TERM argv[], int many)
+{
+  ERL_NIF_TERM head, tail, list = argv[1];
+  async_job *job;
+  unsigned int scheme, n_items = 1;
+
+  if (!enif_get_uint(env, argv[0], &scheme) || scheme > SCHEME_SCHNORR || !enif_is_ref(env, argv[2])) {
+    return enif_make_badarg(env);
+  }
+
+  if (!many && !check_item(env, scheme, argv[1])) {
+    return enif_make_badarg(env);
+  }
+
+  if (many) {
+    n_items = 0;
+    while (enif_get_list_cell(env, list, &head, &tail)) {
+      if (!check_item(env, scheme, head)) {
+        return enif_make_badarg(env);
+      }
+      n_items++;
+      list = tail;
+    }
+    if (!enif_is_empty_list(env, list)) {
+      return enif_make_badarg(env);
+    }
+  }
+
+  if (__atomic_load_n(&pool.failed, __ATOMIC_RELAXED)) {
+    __atomic_add_fetch(&pool.rejected, 1, __ATOMIC_RELAXED);
+    return error_result(env, "no workers");
+  }
+
+  // cheap early rejection, checked again under the lock
+  if (!queue_has_room(__atomic_load_n(&pool.queued, __ATOMIC_RELAXED), n_items)) {
+    __atomic_add_fetch(&pool.rejected, 1, __ATOMIC_RELAXED);
+    return error_result(env, "queue full");
+  }
+
+  job = enif_alloc(sizeof(async_job));
+  if (!job) {
+    return error_result(env, "enif_alloc failed");
+  }
+  memset(job, 0, sizeof(async_job));
+
+  job->env = enif_alloc_env();
+  if (!job->env) {
+    free_job(job);
+    return error_result(env, "enif_alloc_env failed");
+  }
+
+  enif_self(env, &job->pid);
+  job->ref = enif_make_copy(job->env, argv[2]);
+  job->items = enif_make_copy(job->env, argv[1]);
+  job->n_items = n_items;
+  job->scheme = scheme;
+  job->many = many;
+
+  enif_mutex_lock(pool.lock);
+  if (!queue_has_room(pool.queued, n_items)) {
+    enif_mutex_unlock(pool.lock);
+    free_job(job);
+    __atomic_add_fetch(&pool.rejected, 1, __ATOMIC_RELAXED);
+    return error_result(env, "queue full");
+  }
+
+  if (pool.tail) {
+    pool.tail->next = job;
+  } else {
+    pool.head = job;
+  }
+  pool.tail = job;
+  __atomic_add_fetch(&pool.queued, n_items, __ATOMIC_RELAXED);
+  enif_cond_signal(pool.cond);
+  enif_mutex_unlock(pool.lock);
+
+  return enif_make_atom(env, "ok");
+}
+
+// API
+
+static ERL_NIF_TERM
+verify(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  return submit(env, argv, 0);
+}
+
+static ERL_NIF_TERM
+verify_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  return submit(env, argv, 1);
+}
+
+/* Reads thread count, `nil` keeps the last requested one so a pool that
+ * failed to start is retried with it rather than with the live count */
+static int
+get_threads(ErlNifEnv *env, ERL_NIF_TERM term, unsigned int *threads)
+{
+  if (enif_is_identical(term, enif_make_atom(env, "nil"))) {
+    *threads = __atomic_load_n(&pool.requested, __ATOMIC_RELAXED);
+    return 1;
+  }
+
+  return enif_get_uint(env, term, threads) && *threads > 0 && *threads <= MAX_THREADS;
+}
+
+/* Restarts the pool with `argv[0]` threads, queued jobs are kept. Joining
+ * waits for the running jobs, runs on dirty IO scheduler. */
+static ERL_NIF_TERM
+restart_pool(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  unsigned int threads;
+  int started = 1;
+
+  get_threads(env, argv[0], &threads);
+
+  enif_mutex_lock(pool.resize);
+  if (threads != pool.n_threads || pool.failed) {
+    stop_workers();
+    started = start_workers(threads);
+  }
+  enif_mutex_unlock(pool.resize);
+
+  if (!started) {
+    return error_result(env, "enif_thread_create failed");
+  }
+
+  return enif_make_atom(env, "ok");
+}
+
+static ERL_NIF_TERM
+configure(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  unsigned int threads, max_queue;
+
+  if (!get_threads(env, argv[0], &threads) || !enif_get_uint(env, argv[1], &max_queue)) {
+    return enif_make_badarg(env);
+  }
+
+  __atomic_store_n(&pool.max_queue, max_queue, __ATOMIC_RELAXED);
+
+  if (threads == __atomic_load_n(&pool.n_threads, __ATOMIC_RELAXED) &&
+      !__atomic_load_n(&pool.failed, __ATOMIC_RELAXED)) {
+    return enif_make_atom(env, "ok");
+  }
+
+  return enif_schedule_nif(env, "configure_pool", ERL_NIF_DIRTY_JOB_IO_BOUND, restart_pool, argc, argv);
+}
+
+static ERL_NIF_TERM
+info(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM map = enif_make_new_map(env);
+  unsigned int threads, queued;
+
+  // never waits for a restart in progress
+  threads = __atomic_load_n(&pool.n_threads, __ATOMIC_RELAXED);
+  queued = __atomic_load_n(&pool.queued, __ATOMIC_RELAXED);
+
+  enif_make_map_put(env, map, enif_make_atom(env, "threads"), enif_make_uint(env, threads), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "queued"), enif_make_uint(env, queued), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "max_queue"),
+    enif_make_uint(env, __atomic_load_n(&pool.max_queue, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "completed"),
+    enif_make_uint64(env, __atomic_load_n(&pool.completed, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "rejected"),
+    enif_make_uint64(env, __atomic_load_n(&pool.rejected, __ATOMIC_RELAXED)), &map);
+
+  return map;
+}
+
+static ErlNifFunc nif_funcs[] = {
+  {"submit_verify", 3, verify},
+  {"submit_verify_many", 3, verify_many},
+  {"configure_pool", 2, configure},
+  {"info", 0, info},
+  {"stats", 0, stats}
+};
+
+ERL_NIF_INIT(Elixir.Secp256k1.Async, nif_funcs, &async_load, NULL, &upgrade, &async_unload)
@@ -0,0 +1,392 @@
+#include "utils.h"
+#include "sha2.h"
+
+// Rough cost (us) of a single public child derivation, see utils.h
+#define CKD_COST_US 30
+#define HARDENED 0x80000000u
+
+/* BIP32 hierarchical deterministic keys
+ *
+ * Extended keys are passed around as plain binaries:
+ *   - xprv `chain_code (32) || seckey (32)`
+ *   - xpub `chain_code (32) || compressed pubkey (33)`
+ *
+ * Base58 serialization, depth and fingerprints are left to the Elixir side,
+ * they need no curve operations. */
+
+static const unsigned char bip32_seed_key[] = "Bitcoin seed";
+
+/* Resource type of parsed xpub, the point is parsed and the HMAC keyed with
+ * the chain code only once for any number of derived children */
+static ErlNifResourceType *parent_resource_type;
+
+typedef struct {
+  secp256k1_pubkey pubkey;
+  unsigned char serialized[33];
+  hmac_sha512_ctx hmac;  // keyed with the chain code, copied for every child
+} parent;
+
+static int
+bip32_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
+{
+  // Initialize the library context via utils.h's load
+  if (load(env, priv, load_info) != 0) {
+    return -1;
+  }
+
+  parent_resource_type = enif_open_resource_type(
+    env,
+    NULL,
+    "parent_resource",
+    NULL,
+    ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+    NULL
+  );
+
+  if (!parent_resource_type) {
+    return -1;
+  }
+
+  return 0;
+}
+
+static void
+ser32(unsigned char *out, unsigned int index)
+{
+  out[0] = (unsigned char)(index >> 24);
+  out[1] = (unsigned char)(index >> 16);
+  out[2] = (unsigned char)(index >> 8);
+  out[3] = (unsigned char)index;
+}
+
+/* CKDpriv, `xprv` is replaced by the child, returns 0 for the (astronomically
+ * rare) invalid child */
+static int
+ckd_priv(unsigned char *xprv, unsigned int index)
+{
+  hmac_sha512_ctx hmac;
+  secp256k1_pubkey pubkey;
+  unsigned char data[37], I[64];
+  size_t len = 33;
+  int ok = 1;
+
+  if (index & HARDENED) {
+    data[0] = 0;
+    memcpy(data + 1, xprv + 32, 32);
+  } else {
+    ok = secp256k1_ec_pubkey_create(signing_ctx(), &pubkey, xprv + 32) &&
+         secp256k1_ec_pubkey_serialize(ctx, data, &len, &pubkey, SECP256K1_EC_COMPRESSED);
+  }
+  ser32(data + 33, index);
+
+  if (ok) {
+    hmac_sha512_init(&hmac, xprv, 32);
+    hmac_sha512_write(&hmac, data, sizeof(data));
+    hmac_sha512_finalize(&hmac, I);
+
+    // child seckey = IL + k, chain code = IR
+    ok = secp256k1_ec_seckey_tweak_add(ctx, xprv + 32, I);
+    if (ok) {
+      memcpy(xprv, I + 32, 32);
+    }
+  }
+
+  secure_erase(data, sizeof(data));
+  secure_erase(I, sizeof(I));
+  return ok;
+}
+
+/* CKDpub from the parsed parent into `pubkey` and `chain_code` (may be NULL),
+ * returns 0 for the invalid child */
+static int
+ckd_pub(const parent *p, unsigned int index, secp256k1_pubkey *pubkey, unsigned char *chain_code)
+{
+  hmac_sha512_ctx hmac;
+  unsigned char data[4], I[64];
+  int ok;
+
+  memcpy(&hmac, &p->hmac, sizeof(hmac));
+  ser32(data, index);
+  hmac_sha512_write(&hmac, p->serialized, sizeof(p->serialized));
+  hmac_sha512_write(&hmac, data, sizeof(data));
+  hmac_sha512_finalize(&hmac, I);
+
+  // child pubkey = IL * G + K, chain code = IR
+  memcpy(pubkey, &p->pubkey, sizeof(*pubkey));
+  ok = secp256k1_ec_pubkey_tweak_add(ctx, pubkey, I);
+  if (ok && chain_code) {
+    memcpy(chain_code, I + 32, 32);
+  }
+
+  return ok;
+}
+
+/* Parses xpub binary into the parent, returns 0 when it is not valid */
+static int
+parse_parent(const unsigned char *xpub, parent *p)
+{
+  if (!secp256k1_ec_pubkey_parse(ctx, &p->pubkey, xpub + 32, 33)) {
+    return 0;
+  }
+
+  memcpy(p->serialized, xpub + 32, 33);
+  hmac_sha512_init(&p->hmac, xpub, 32);
+  return 1;
+}
+
+/* Reads xpub binary or parent resource term */
+static int
+get_parent(ErlNifEnv *env, ERL_NIF_TERM term, parent *p)
+{
+  ErlNifBinary xpub;
+  parent *resource;
+
+  if (enif_get_resource(env, term, parent_resource_type, (void **)&resource)) {
+    memcpy(p, resource, sizeof(parent));
+    return 1;
+  }
+
+  return enif_inspect_binary(env, term, &xpub) && xpub.size == 65 && parse_parent(xpub.data, p);
+}
+
+// API
+
+static ERL_NIF_TERM
+master_key(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary seed;
+  hmac_sha512_ctx hmac;
+  unsigned char I[64];
+  unsigned char *finished;
+
+  if (!enif_inspect_binary(env, argv[0], &seed)) {
+    return enif_make_badarg(env);
+  }
+
+  // BIP32 seed is 128 to 512 bits long
+  if (seed.size < 16 || seed.size > 64) {
+    return enif_make_badarg(env);
+  }
+
+  hmac_sha512_init(&hmac, bip32_seed_key, sizeof(bip32_seed_key) - 1);
+  hmac_sha512_write(&hmac, seed.data, seed.size);
+  hmac_sha512_finalize(&hmac, I);
+
+  if (!secp256k1_ec_seckey_verify(ctx, I)) {
+    secure_erase(I, sizeof(I));
+    return error_result(env, "invalid master key");
+  }
+
+  // xprv is chain code (IR) followed by seckey (IL)
+  finished = enif_make_new_binary(env, 64, &result);
+  memcpy(finished, I + 32, 32);
+  memcpy(finished + 32, I, 32);
+  secure_erase(I, sizeof(I));
+
+  return result;
+}
+
+static ERL_NIF_TERM
+derive_xprv(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result, head, tail, list = argv[1];
+  ErlNifBinary xprv;
+  unsigned char child[64];
+  unsigned char *finished;
+  unsigned int index, length;
+  ErlNifTime start;
+  int ok = 1;
+
+  if (!enif_inspect_binary(env, argv[0], &xprv) ||
+      !enif_get_list_length(env, list, &length)) {
+    return enif_make_badarg(env);
+  }
+
+  if (!(xprv.size == 64 && secp256k1_ec_seckey_verify(ctx, xprv.data + 32))) {
+    return enif_make_badarg(env);
+  }
+
+  memcpy(child, xprv.data, 64);
+  start = stats_start();
+  while (ok && enif_get_list_cell(env, list, &head, &tail)) {
+    if (!enif_get_uint(env, head, &index)) {
+      secure_erase(child, sizeof(child));
+      return enif_make_badarg(env);
+    }
+    ok = ckd_priv(child, index);
+    list = tail;
+  }
+  stats_record(STATS_BIP32_DERIVE, start, ok);
+
+  if (!ok) {
+    secure_erase(child, sizeof(child));
+    return error_result(env, "invalid child key");
+  }
+
+  finished = enif_make_new_binary(env, 64, &result);
+  memcpy(finished, child, 64);
+  secure_erase(child, sizeof(child));
+
+  consume_timeslice(env, (size_t)length * CKD_COST_US);
+  return result;
+}
+
+static ERL_NIF_TERM
+derive_xpub(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result, head, tail, list = argv[1];
+  ErlNifBinary xpub;
+  parent p;
+  secp256k1_pubkey pubkey;
+  unsigned char *finished;
+  unsigned char child[65];
+  size_t len = 33;
+  unsigned int index, length;
+  ErlNifTime start;
+  int ok = 1;
+
+  if (!enif_inspect_binary(env, argv[0], &xpub) || xpub.size != 65 ||
+      !enif_get_list_length(env, list, &length)) {
+    return enif_make_badarg(env);
+  }
+
+  if (!parse_parent(xpub.data, &p)) {
+    return enif_make_badarg(env);
+  }
+
+  memcpy(child, xpub.data, 65);
+  start = stats_start();
+  while (ok && enif_get_list_cell(env, list, &head, &tail)) {
+    // hardened children can not be derived from xpub
+    if (!enif_get_uint(env, head, &index) || (index & HARDENED)) {
+      return enif_make_badarg(env);
+    }
+    ok = ckd_pub(&p, index, &pubkey, child) &&
+         secp256k1_ec_pubkey_serialize(ctx, child + 32, &len, &pubkey, SECP256K1_EC_COMPRESSED) &&
+         parse_parent(child, &p);
+    list = tail;
+  }
+  stats_record(STATS_BIP32_DERIVE, start, ok);
+
+  if (!ok) {
+    return error_result(env, "invalid child key");
+  }
+
+  finished = enif_make_new_binary(env, 65, &result);
+  memcpy(finished, child, 65);
+
+  consume_timeslice(env, (size_t)length * CKD_COST_US);
+  return result;
+}
+
+static ERL_NIF_TERM
+xpub(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary xprv;
+  secp256k1_pubkey pubkey;
+  unsigned char *finished;
+  size_t len = 33;
+
+  if (!enif_inspect_binary(env, argv[0], &xprv)) {
+    return enif_make_badarg(env);
+  }
+
+  if (!(xprv.size == 64 && secp256k1_ec_seckey_verify(ctx, xprv.data + 32))) {
+    return enif_make_badarg(env);
+  }
+
+  if (!secp256k1_ec_pubkey_create(signing_ctx(), &pubkey, xprv.data + 32)) {
+    return error_result(env, "secp256k1_ec_pubkey_create failed");
+  }
+
+  finished = enif_make_new_binary(env, 65, &result);
+  memcpy(finished, xprv.data, 32);
+  secp256k1_ec_pubkey_serialize(ctx, finished + 32, &len, &pubkey, SECP256K1_EC_COMPRESSED);
+
+  return result;
+}
+
+static ERL_NIF_TERM
+load_parent(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary xpub;
+  parent *p;
+
+  if (!enif_inspect_binary(env, argv[0], &xpub) || xpub.size != 65) {
+    return enif_make_badarg(env);
+  }
+
+  p = enif_alloc_resource(parent_resource_type, sizeof(parent));
+  if (!p) {
+    return error_result(env, "enif_alloc_resource failed");
+  }
+
+  if (!parse_parent(xpub.data, p)) {
+    enif_release_resource(p);
+    return enif_make_badarg(env);
+  }
+
+  result = enif_make_resource(env, p);
+  enif_release_resource(p);
+  return result;
+}
+
+/* Derives `count` child pubkeys starting with index `first` into one binary of
+ * 33 byte compressed pubkeys, invalid children are left as 33 zero bytes */
+static ERL_NIF_TERM
+range(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  parent p;
+  secp256k1_pubkey pubkey;
+  unsigned char *finished;
+  unsigned int first, count, i;
+  size_t len;
+  ErlNifTime start;
+  int ok;
+
+  if (!get_parent(env, argv[0], &p) ||
+      !enif_get_uint(env, argv[1], &first) ||
+      !enif_get_uint(env, argv[2], &count)) {
+    return enif_make_badarg(env);
+  }
+
+  // only non-hardened children, the last index included
+  if (first >= HARDENED || count > HARDENED - first) {
+    return enif_make_badarg(env);
+  }
+
+  if (needs_dirty_scheduler((size_t)count * CKD_COST_US)) {
+    return enif_schedule_nif(env, "derive_range", ERL_NIF_DIRTY_JOB_CPU_BOUND, range, argc, argv);
+  }
+
+  finished = enif_make_new_binary(env, (size_t)count * 33, &result);
+  for (i = 0; i < count; i++) {
+    start = stats_start();
+    ok = ckd_pub(&p, first + i, &pubkey, NULL);
+    stats_record(STATS_BIP32_DERIVE, start, ok);
+
+    len = 33;
+    if (!ok || !secp256k1_ec_pubkey_serialize(ctx, finished + (size_t)i * 33, &len, &pubkey, SECP256K1_EC_COMPRESSED)) {
+      memset(finished + (size_t)i * 33, 0, 33);
+    }
+  }
+
+  consume_timeslice(env, (size_t)count * CKD_COST_US);
+  return result;
+}
+
+static ErlNifFunc nif_funcs[] = {
+  {"master_key", 1, master_key},
+  {"derive_xprv", 2, derive_xprv},
+  {"derive_xpub", 2, derive_xpub},
+  {"xpub", 1, xpub},
+  {"parent", 1, load_parent},
+  {"derive_range", 3, range},
+  {"stats", 0, stats}
+};
+
+ERL_NIF_INIT(Elixir.Secp256k1.BIP32, nif_funcs, &bip32_load, NULL, &upgrade, &unload)
@@ -0,0 +1,47 @@
+#include <pthread.h>
+
+#include "context.h"
+#include "../random.h"
+
+static secp256k1_context *shared_ctx = NULL;
+static pthread_once_t shared_ctx_once = PTHREAD_ONCE_INIT;
+
+static void
+create_shared_context(void)
+{
+  secp256k1_context *new_ctx;
+  unsigned char randomize[32];
+
+  if (!fill_random(randomize, sizeof(randomize)))
+  {
+    return;
+  }
+
+  new_ctx = secp256k1_context_create(SECP256K1_CONTEXT_NONE);
+  if (new_ctx && !secp256k1_context_randomize(new_ctx, randomize))
+  {
+    secp256k1_context_destroy(new_ctx);
+    new_ctx = NULL;
+  }
+  secure_erase(randomize, sizeof(randomize));
+
+  shared_ctx = new_ctx;
+}
+
+secp256k1_context *
+secp256k1_nif_shared_context(void)
+{
+  pthread_once(&shared_ctx_once, create_shared_context);
+  return shared_ctx;
+}
+
+/* Runs when the last NIF using the core library is unloaded */
+__attribute__((destructor)) static void
+destroy_shared_context(void)
+{
+  if (shared_ctx)
+  {
+    secp256k1_context_destroy(shared_ctx);
+    shared_ctx = NULL;
+  }
+}
@@ -0,0 +1,16 @@
+#ifndef SECP256K1_NIF_CONTEXT_H
+#define SECP256K1_NIF_CONTEXT_H
+
+#include <secp256k1.h>
+
+/* Shared core library (build with SHARED_CORE=1)
+ *
+ * All NIFs link against one shared library containing libsecp256k1 and a
+ * single randomized context, so the precomputed tables and the context exist
+ * only once per VM no matter how many NIF modules are loaded. */
+
+/* Returns the process wide context, creating and randomizing it on first
+ * call. Returns NULL when the context could not be randomized. */
+secp256k1_context *secp256k1_nif_shared_context(void);
+
+#endif
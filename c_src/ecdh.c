@@ -2,29 +2,188 @@
 
 #include <secp256k1_ecdh.h>
 
+#define ECDH_COST_US 40
+
+/* Output modes of the shared secret */
+#define ECDH_SHA256 0 // SHA-256 of compressed point (library default)
+#define ECDH_X 1      // raw X coordinate
+#define ECDH_POINT 2  // compressed point
+
+// Resource type for verified seckeys reused against many pubkeys
+static ErlNifResourceType *seckey_resource_type;
+
+typedef struct {
+  unsigned char seckey[32];
+} seckey_wrapper;
+
+static void
+destruct_seckey(ErlNifEnv *env, void *obj)
+{
+  secure_erase(obj, sizeof(seckey_wrapper));
+}
+
+static int
+ecdh_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
+{
+  // Initialize the library context via utils.h's load
+  if (load(env, priv, load_info) != 0)
+  {
+    return -1;
+  }
+
+  seckey_resource_type = enif_open_resource_type(
+      env,
+      NULL,
+      "seckey_resource",
+      destruct_seckey,
+      ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+      NULL);
+
+  if (!seckey_resource_type)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Returns seckey stored in the keypair resource (already verified) or seckey
+ * binary after verifying it, NULL for invalid argument */
+static const unsigned char *
+get_seckey(ErlNifEnv *env, ERL_NIF_TERM term)
+{
+  seckey_wrapper *wrapper;
+  ErlNifBinary seckey;
+
+  if (enif_get_resource(env, term, seckey_resource_type, (void **)&wrapper))
+  {
+    return wrapper->seckey;
+  }
+
+  if (!enif_inspect_binary(env, term, &seckey) ||
+      !(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  {
+    return NULL;
+  }
+
+  return seckey.data;
+}
+
+static int
+hash_x(unsigned char *output, const unsigned char *x32, const unsigned char *y32, void *data)
+{
+  memcpy(output, x32, 32);
+  return 1;
+}
+
+static int
+hash_point(unsigned char *output, const unsigned char *x32, const unsigned char *y32, void *data)
+{
+  output[0] = 0x02 | (y32[31] & 1);
+  memcpy(output + 1, x32, 32);
+  return 1;
+}
+
+/* Returns hash function of the output mode (NULL is the library default) and
+ * sets the output size, 0 for unknown mode */
+static int
+get_mode(ErlNifEnv *env, ERL_NIF_TERM term, secp256k1_ecdh_hash_function *hashfp, size_t *outlen)
+{
+  unsigned int mode;
+
+  if (!enif_get_uint(env, term, &mode))
+  {
+    return 0;
+  }
+
+  switch (mode)
+  {
+  case ECDH_SHA256:
+    *hashfp = NULL;
+    *outlen = 32;
+    return 1;
+  case ECDH_X:
+    *hashfp = hash_x;
+    *outlen = 32;
+    return 1;
+  case ECDH_POINT:
+    *hashfp = hash_point;
+    *outlen = 33;
+    return 1;
+  }
+
+  return 0;
+}
+
+/* Computes shared secret with serialized pubkey, returns 0 for invalid pubkey */
+static int
+shared_secret(unsigned char *output, const unsigned char *seckey, const unsigned char *pubkey, size_t pubkey_len, secp256k1_ecdh_hash_function hashfp)
+{
+  secp256k1_pubkey pubkey_parsed;
+
+  return secp256k1_ec_pubkey_parse(ctx, &pubkey_parsed, pubkey, pubkey_len) &&
+         secp256k1_ecdh(ctx, output, &pubkey_parsed, seckey, hashfp, NULL);
+}
+
 // API
 
 static ERL_NIF_TERM
-ecdh(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+keypair(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
   ERL_NIF_TERM result;
   ErlNifBinary seckey;
+  seckey_wrapper *wrapper;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &seckey))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  {
+    return enif_make_badarg(env);
+  }
+
+  wrapper = enif_alloc_resource(seckey_resource_type, sizeof(seckey_wrapper));
+  if (!wrapper)
+  {
+    return error_result(env, "enif_alloc_resource failed");
+  }
+  memcpy(wrapper->seckey, seckey.data, sizeof(wrapper->seckey));
+
+  result = enif_make_resource(env, wrapper);
+  enif_release_resource(wrapper);
+  return result;
+}
+
+static ERL_NIF_TERM
+ecdh(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
   ErlNifBinary pubkey;
 
   secp256k1_pubkey pubkey_parsed;
+  secp256k1_ecdh_hash_function hashfp = NULL;
 
-  unsigned char shared_secret[32];
+  const unsigned char *seckey;
+  unsigned char output[33];
   unsigned char *finished;
+  size_t outlen = 32;
+  ErlNifTime start;
+  int ok;
 
-  // load arguments
-  if (!enif_inspect_binary(env, argv[0], &seckey) ||
-      !enif_inspect_binary(env, argv[1], &pubkey))
+  // load arguments, optional 3rd argument is the output mode
+  if (!(seckey = get_seckey(env, argv[0])) ||
+      !enif_inspect_binary(env, argv[1], &pubkey) ||
+      (argc == 3 && !get_mode(env, argv[2], &hashfp, &outlen)))
   {
     return enif_make_badarg(env);
   }
 
   // check arguments size
-  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data) && (pubkey.size == 33 || pubkey.size == 65)))
+  if (pubkey.size != 33 && pubkey.size != 65)
   {
     return enif_make_badarg(env);
   }
@@ -34,20 +193,149 @@ ecdh(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     return error_result(env, "secp256k1_ec_pubkey_parse failed");
   }
 
-  if (!secp256k1_ecdh(ctx, shared_secret, &pubkey_parsed, seckey.data, NULL, NULL))
+  start = stats_start();
+  ok = secp256k1_ecdh(ctx, output, &pubkey_parsed, seckey, hashfp, NULL);
+  stats_record(STATS_ECDH, start, ok);
+  if (!ok)
   {
     return error_result(env, "secp256k1_ecdh failed");
   }
 
-  /* Convert serialized pubkey to Erlang binary */
-  finished = enif_make_new_binary(env, sizeof(shared_secret), &result);
-  memcpy(finished, shared_secret, sizeof(shared_secret));
-  secure_erase(shared_secret, sizeof(shared_secret));
+  /* Convert shared secret to Erlang binary */
+  finished = enif_make_new_binary(env, outlen, &result);
+  memcpy(finished, output, outlen);
+  secure_erase(output, sizeof(output));
+  return result;
+}
+
+/* Computes shared secrets with list of pubkeys (`nil` for invalid ones) or
+ * binary of packed compressed pubkeys (zeroes for invalid ones) */
+static ERL_NIF_TERM
+ecdh_many_secrets(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, result, list = argv[1];
+  ERL_NIF_TERM *results;
+  ErlNifBinary pubkey, packed;
+
+  secp256k1_ecdh_hash_function hashfp;
+
+  const unsigned char *seckey;
+  unsigned char output[33];
+  unsigned char *finished;
+  unsigned int length, index = 0, valid = 0;
+  size_t outlen, i, count;
+  ErlNifTime start;
+
+  if (!(seckey = get_seckey(env, argv[0])) || !get_mode(env, argv[2], &hashfp, &outlen))
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (enif_inspect_binary(env, argv[1], &packed))
+  {
+    if (packed.size % 33 != 0)
+    {
+      return enif_make_badarg(env);
+    }
+
+    count = packed.size / 33;
+    finished = enif_make_new_binary(env, count * outlen, &result);
+    start = stats_start();
+
+    for (i = 0; i < count; i++)
+    {
+      if (shared_secret(finished + i * outlen, seckey, packed.data + i * 33, 33, hashfp))
+      {
+        valid++;
+      }
+      else
+      {
+        memset(finished + i * outlen, 0, outlen);
+      }
+    }
+
+    stats_record(STATS_ECDH, start, valid == count);
+    return result;
+  }
+
+  if (!enif_get_list_length(env, list, &length))
+  {
+    return enif_make_badarg(env);
+  }
+
+  results = enif_alloc(sizeof(ERL_NIF_TERM) * (length > 0 ? length : 1));
+  if (!results)
+  {
+    return error_result(env, "enif_alloc failed");
+  }
+  start = stats_start();
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    if (!enif_inspect_binary(env, head, &pubkey) || (pubkey.size != 33 && pubkey.size != 65))
+    {
+      enif_free(results);
+      secure_erase(output, sizeof(output));
+      return enif_make_badarg(env);
+    }
+
+    if (shared_secret(output, seckey, pubkey.data, pubkey.size, hashfp))
+    {
+      finished = enif_make_new_binary(env, outlen, &results[index]);
+      memcpy(finished, output, outlen);
+      valid++;
+    }
+    else
+    {
+      results[index] = enif_make_atom(env, "nil");
+    }
+
+    index++;
+    list = tail;
+  }
+
+  stats_record(STATS_ECDH, start, valid == length);
+  secure_erase(output, sizeof(output));
+
+  result = enif_make_list_from_array(env, results, length);
+  enif_free(results);
+  return result;
+}
+
+static ERL_NIF_TERM
+ecdh_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary packed;
+  unsigned int length;
+  size_t cost;
+
+  if (enif_inspect_binary(env, argv[1], &packed))
+  {
+    length = packed.size / 33;
+  }
+  else if (!enif_get_list_length(env, argv[1], &length))
+  {
+    return enif_make_badarg(env);
+  }
+
+  cost = (size_t)length * ECDH_COST_US;
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "ecdh_batch", ERL_NIF_DIRTY_JOB_CPU_BOUND, ecdh_many_secrets, argc, argv);
+  }
+
+  result = ecdh_many_secrets(env, argc, argv);
+  consume_timeslice(env, cost);
   return result;
 }
 
 static ErlNifFunc nif_funcs[] = {
+    {"keypair", 1, keypair},
     {"ecdh", 2, ecdh},
+    {"ecdh_mode", 3, ecdh},
+    {"ecdh_batch", 3, ecdh_many},
+    {"stats", 0, stats},
 };
 
-ERL_NIF_INIT(Elixir.Secp256k1.ECDH, nif_funcs, &load, NULL, &upgrade, &unload)
+ERL_NIF_INIT(Elixir.Secp256k1.ECDH, nif_funcs, &ecdh_load, NULL, &upgrade, &unload)
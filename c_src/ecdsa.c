@@ -1,4 +1,236 @@
 #include "utils.h"
+#include "iodata.h"
+#include "sigcache.h"
+
+// Resource type for verified seckeys reused across many signatures
+static ErlNifResourceType *seckey_resource_type;
+
+typedef struct {
+  unsigned char seckey[32];
+} seckey_wrapper;
+
+static void
+destruct_seckey(ErlNifEnv *env, void *obj)
+{
+  secure_erase(obj, sizeof(seckey_wrapper));
+}
+
+static int
+ecdsa_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
+{
+  // Initialize the library context via utils.h's load
+  if (load(env, priv, load_info) != 0)
+  {
+    return -1;
+  }
+
+  seckey_resource_type = enif_open_resource_type(
+      env,
+      NULL,
+      "seckey_resource",
+      destruct_seckey,
+      ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+      NULL);
+
+  if (!seckey_resource_type || !open_hash_state_type(env) || !sigcache_open())
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+static void
+ecdsa_unload(ErlNifEnv *env, void *priv)
+{
+  sigcache_close();
+  unload(env, priv);
+}
+
+/* Returns seckey stored in the keypair resource (already verified) or seckey
+ * binary after verifying it, NULL for invalid argument */
+static const unsigned char *
+get_seckey(ErlNifEnv *env, ERL_NIF_TERM term)
+{
+  seckey_wrapper *wrapper;
+  ErlNifBinary seckey;
+
+  if (enif_get_resource(env, term, seckey_resource_type, (void **)&wrapper))
+  {
+    return wrapper->seckey;
+  }
+
+  if (!enif_inspect_binary(env, term, &seckey) ||
+      !(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  {
+    return NULL;
+  }
+
+  return seckey.data;
+}
+
+/* Signature parsing flags */
+#define SIG_DER 1       // DER even when 64 bytes long
+#define SIG_LAX_DER 2   // lax DER (BIP66 non-compliant encodings)
+#define SIG_NORMALIZE 4 // convert high-S signature to low-S before verifying
+
+/* Reads integer of lax DER signature at `*pos` into `*start` and `*len`,
+ * returns 0 on malformed input */
+static int
+lax_der_integer(const unsigned char *input, size_t inputlen, size_t *pos, size_t *start, size_t *len)
+{
+  size_t lenbyte;
+
+  /* Integer tag byte */
+  if (*pos == inputlen || input[*pos] != 0x02)
+  {
+    return 0;
+  }
+  (*pos)++;
+
+  /* Integer length */
+  if (*pos == inputlen)
+  {
+    return 0;
+  }
+  lenbyte = input[(*pos)++];
+  if (lenbyte & 0x80)
+  {
+    lenbyte -= 0x80;
+    if (lenbyte > inputlen - *pos)
+    {
+      return 0;
+    }
+    while (lenbyte > 0 && input[*pos] == 0)
+    {
+      (*pos)++;
+      lenbyte--;
+    }
+    if (lenbyte >= 4)
+    {
+      return 0;
+    }
+    *len = 0;
+    while (lenbyte > 0)
+    {
+      *len = (*len << 8) + input[(*pos)++];
+      lenbyte--;
+    }
+  }
+  else
+  {
+    *len = lenbyte;
+  }
+
+  if (*len > inputlen - *pos)
+  {
+    return 0;
+  }
+  *start = *pos;
+  *pos += *len;
+
+  /* Ignore leading zeroes */
+  while (*len > 0 && input[*start] == 0)
+  {
+    (*len)--;
+    (*start)++;
+  }
+
+  return 1;
+}
+
+/* Lax DER parser, port of upstream contrib/lax_der_parsing.c
+ *
+ * Accepts the encodings which were valid before BIP66 (wrong lengths, excess
+ * padding, trailing garbage). Values which do not fit into 32 bytes are
+ * parsed as an invalid signature (all zeroes) which never verifies, so only
+ * structurally broken input returns 0. */
+static int
+parse_der_lax(secp256k1_ecdsa_signature *sig, const unsigned char *input, size_t inputlen)
+{
+  size_t rpos, rlen, spos, slen, lenbyte, pos = 0;
+  unsigned char tmpsig[64] = {0};
+  int overflow = 0;
+
+  /* Sequence tag byte */
+  if (pos == inputlen || input[pos] != 0x30)
+  {
+    return 0;
+  }
+  pos++;
+
+  /* Sequence length bytes, the length itself is ignored */
+  if (pos == inputlen)
+  {
+    return 0;
+  }
+  lenbyte = input[pos++];
+  if (lenbyte & 0x80)
+  {
+    lenbyte -= 0x80;
+    if (lenbyte > inputlen - pos)
+    {
+      return 0;
+    }
+    pos += lenbyte;
+  }
+
+  if (!lax_der_integer(input, inputlen, &pos, &rpos, &rlen) ||
+      !lax_der_integer(input, inputlen, &pos, &spos, &slen))
+  {
+    return 0;
+  }
+
+  /* Copy R and S values */
+  if (rlen > 32 || slen > 32)
+  {
+    overflow = 1;
+  }
+  else
+  {
+    memcpy(tmpsig + 32 - rlen, input + rpos, rlen);
+    memcpy(tmpsig + 64 - slen, input + spos, slen);
+  }
+
+  if (!overflow)
+  {
+    overflow = !secp256k1_ecdsa_signature_parse_compact(ctx, sig, tmpsig);
+  }
+  if (overflow)
+  {
+    memset(tmpsig, 0, sizeof(tmpsig));
+    secp256k1_ecdsa_signature_parse_compact(ctx, sig, tmpsig);
+  }
+
+  return 1;
+}
+
+/* Parses 64 byte compact or DER signature according to the flags */
+static int
+parse_signature(const ErlNifBinary *bin, unsigned int flags, secp256k1_ecdsa_signature *sig)
+{
+  int ok;
+
+  if (bin->size == 64 && !(flags & (SIG_DER | SIG_LAX_DER)))
+  {
+    ok = secp256k1_ecdsa_signature_parse_compact(ctx, sig, bin->data);
+  }
+  else if (flags & SIG_LAX_DER)
+  {
+    ok = parse_der_lax(sig, bin->data, bin->size);
+  }
+  else
+  {
+    ok = secp256k1_ecdsa_signature_parse_der(ctx, sig, bin->data, bin->size);
+  }
+
+  if (ok && (flags & SIG_NORMALIZE))
+  {
+    secp256k1_ecdsa_signature_normalize(ctx, sig, sig);
+  }
+
+  return ok;
+}
 
 // API
 
@@ -13,6 +245,8 @@ compressed_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   unsigned char serialized_pubkey[33];
   unsigned char *finished;
   size_t len;
+  ErlNifTime start;
+  int ok;
 
   // load arguments
   if (!enif_inspect_binary(env, argv[0], &seckey))
@@ -26,7 +260,10 @@ compressed_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     return enif_make_badarg(env);
   }
 
-  if (!secp256k1_ec_pubkey_create(ctx, &pubkey, seckey.data))
+  start = stats_start();
+  ok = secp256k1_ec_pubkey_create(signing_ctx(), &pubkey, seckey.data);
+  stats_record(STATS_PUBKEY, start, ok);
+  if (!ok)
   {
     return error_result(env, "secp256k1_ec_pubkey_create failed");
   }
@@ -54,6 +291,8 @@ uncompressed_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   unsigned char serialized_pubkey[65];
   unsigned char *finished;
   size_t len;
+  ErlNifTime start;
+  int ok;
 
   // load arguments
   if (!enif_inspect_binary(env, argv[0], &seckey))
@@ -67,7 +306,10 @@ uncompressed_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     return enif_make_badarg(env);
   }
 
-  if (!secp256k1_ec_pubkey_create(ctx, &pubkey, seckey.data))
+  start = stats_start();
+  ok = secp256k1_ec_pubkey_create(signing_ctx(), &pubkey, seckey.data);
+  stats_record(STATS_PUBKEY, start, ok);
+  if (!ok)
   {
     return error_result(env, "secp256k1_ec_pubkey_create failed");
   }
@@ -167,42 +409,183 @@ decompress_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 }
 
 static ERL_NIF_TERM
-sign(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+keypair(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
   ERL_NIF_TERM result;
-  ErlNifBinary msg_hash, seckey, auxiliary_rand;
-
-  secp256k1_ecdsa_signature sig;
-
-  unsigned char serialized_signature[64];
-  unsigned char *finished;
+  ErlNifBinary seckey;
+  seckey_wrapper *wrapper;
 
-  /* load arguments given by Elixir */
-  if (!enif_inspect_binary(env, argv[0], &msg_hash) ||
-      !enif_inspect_binary(env, argv[1], &seckey) ||
-      !enif_inspect_binary(env, argv[2], &auxiliary_rand))
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &seckey))
   {
     return enif_make_badarg(env);
   }
 
-  /* check expected arguments size */
+  // check arguments size
   if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
   {
     return enif_make_badarg(env);
   }
 
-  if (msg_hash.size != 32)
+  wrapper = enif_alloc_resource(seckey_resource_type, sizeof(seckey_wrapper));
+  if (!wrapper)
   {
-    return enif_make_badarg(env);
+    return error_result(env, "enif_alloc_resource failed");
   }
+  memcpy(wrapper->seckey, seckey.data, sizeof(wrapper->seckey));
 
-  if (auxiliary_rand.size != 32)
+  result = enif_make_resource(env, wrapper);
+  enif_release_resource(wrapper);
+  return result;
+}
+
+/* Random keypair generation
+ *
+ * Entropy is drawn from the OS in blocks of up to KEYGEN_ENTROPY_KEYS
+ * candidate seckeys instead of one call per key, candidates out of range are
+ * skipped. getentropy (macOS, OpenBSD) refuses more than 256 bytes per call,
+ * blocks are read in chunks of KEYGEN_ENTROPY_CHUNK bytes. */
+#define KEYGEN_ENTROPY_KEYS 64
+#define KEYGEN_ENTROPY_CHUNK 256
+#define KEYGEN_COST_US 25
+#define KEYGEN_MAX_COUNT (1 << 20)
+
+/* Pubkey formats of `random_keypairs` */
+#define KEYGEN_COMPRESSED 0
+#define KEYGEN_UNCOMPRESSED 1
+#define KEYGEN_XONLY 2
+
+static int
+fill_entropy(unsigned char *data, size_t size)
+{
+  size_t chunk;
+
+  while (size > 0)
+  {
+    chunk = size < KEYGEN_ENTROPY_CHUNK ? size : KEYGEN_ENTROPY_CHUNK;
+    if (!fill_random(data, chunk))
+    {
+      return 0;
+    }
+    data += chunk;
+    size -= chunk;
+  }
+
+  return 1;
+}
+
+static ERL_NIF_TERM
+generate_keypairs(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary packed;
+  secp256k1_pubkey pubkey;
+  unsigned char entropy[32 * KEYGEN_ENTROPY_KEYS];
+  unsigned char serialized[65], *out;
+  unsigned int count, type, i, pubkey_len, block, used;
+  size_t len;
+  ErlNifTime start;
+  int ok = 1;
+
+  enif_get_uint(env, argv[0], &count);
+  enif_get_uint(env, argv[1], &type);
+  pubkey_len = type == KEYGEN_UNCOMPRESSED ? 65 : type == KEYGEN_XONLY ? 32 : 33;
+
+  // a single keypair draws a single candidate
+  block = count < KEYGEN_ENTROPY_KEYS ? count : KEYGEN_ENTROPY_KEYS;
+  used = block;
+
+  if (!enif_alloc_binary((size_t)count * (32 + pubkey_len), &packed))
+  {
+    return error_result(env, "enif_alloc_binary failed");
+  }
+
+  out = packed.data;
+  for (i = 0; ok && i < count; i++)
+  {
+    // draw candidates until one is a valid seckey
+    do
+    {
+      if (used == block)
+      {
+        if (!(ok = fill_entropy(entropy, 32 * (size_t)block)))
+        {
+          break;
+        }
+        used = 0;
+      }
+      memcpy(out, entropy + 32 * used, 32);
+      used++;
+    } while (!secp256k1_ec_seckey_verify(ctx, out));
+
+    if (!ok)
+    {
+      break;
+    }
+
+    start = stats_start();
+    ok = secp256k1_ec_pubkey_create(signing_ctx(), &pubkey, out);
+    stats_record(STATS_PUBKEY, start, ok);
+
+    len = type == KEYGEN_UNCOMPRESSED ? 65 : 33;
+    ok = ok && secp256k1_ec_pubkey_serialize(ctx, serialized, &len, &pubkey,
+                 type == KEYGEN_UNCOMPRESSED ? SECP256K1_EC_UNCOMPRESSED : SECP256K1_EC_COMPRESSED);
+    memcpy(out + 32, type == KEYGEN_XONLY ? serialized + 1 : serialized, pubkey_len);
+    out += 32 + pubkey_len;
+  }
+
+  secure_erase(entropy, sizeof(entropy));
+  if (!ok)
+  {
+    secure_erase(packed.data, packed.size);
+    enif_release_binary(&packed);
+    return error_result(env, "keypair generation failed");
+  }
+
+  return enif_make_binary(env, &packed);
+}
+
+static ERL_NIF_TERM
+random_keypairs(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  unsigned int count, type;
+  size_t cost;
+
+  if (!enif_get_uint(env, argv[0], &count) || count > KEYGEN_MAX_COUNT ||
+      !enif_get_uint(env, argv[1], &type) || type > KEYGEN_XONLY)
   {
     return enif_make_badarg(env);
   }
 
+  cost = (size_t)count * KEYGEN_COST_US;
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "random_keypairs", ERL_NIF_DIRTY_JOB_CPU_BOUND, generate_keypairs, argc, argv);
+  }
+
+  result = generate_keypairs(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+/* Signs 32 byte hash with already loaded arguments */
+static ERL_NIF_TERM
+sign_hash(ErlNifEnv *env, const unsigned char *msg_hash, const unsigned char *seckey, const unsigned char *auxiliary_rand)
+{
+  ERL_NIF_TERM result;
+
+  secp256k1_ecdsa_signature sig;
+
+  unsigned char serialized_signature[64];
+  unsigned char *finished;
+  ErlNifTime start;
+  int ok;
+
   /* Generate a ECDSA signature */
-  if (!secp256k1_ecdsa_sign(ctx, &sig, msg_hash.data, seckey.data, NULL, auxiliary_rand.data))
+  start = stats_start();
+  ok = secp256k1_ecdsa_sign(signing_ctx(), &sig, msg_hash, seckey, NULL, auxiliary_rand);
+  stats_record(STATS_SIGN, start, ok);
+  if (!ok)
   {
     return error_result(env, "secp256k1_ecdsa_sign failed");
   }
@@ -219,44 +602,526 @@ sign(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   return result;
 }
 
+/* Verifies parsed signature with serialized pubkey, successful verifications
+ * are remembered in the verification cache when it is enabled. Returns -1 for
+ * invalid pubkey. */
+static int
+verify_cached(const secp256k1_ecdsa_signature *sig, const unsigned char *msg_hash, const ErlNifBinary *serialized_pubkey)
+{
+  secp256k1_pubkey pubkey;
+  unsigned char compact[64], entry[32];
+  int cached = sigcache_enabled();
+  int valid;
+
+  if (cached)
+  {
+    // the compact form already has the normalization and DER parsing applied
+    secp256k1_ecdsa_signature_serialize_compact(ctx, compact, sig);
+    sigcache_entry(entry, compact, sizeof(compact), serialized_pubkey->data, serialized_pubkey->size, msg_hash, 32);
+    if (sigcache_contains(entry))
+    {
+      return 1;
+    }
+  }
+
+  if (!secp256k1_ec_pubkey_parse(ctx, &pubkey, serialized_pubkey->data, serialized_pubkey->size))
+  {
+    return -1;
+  }
+
+  valid = secp256k1_ecdsa_verify(ctx, sig, msg_hash, &pubkey);
+  if (valid && cached)
+  {
+    sigcache_insert(entry);
+  }
+
+  return valid;
+}
+
+/* Verifies signature of 32 byte hash with already loaded arguments */
+static ERL_NIF_TERM
+verify_hash(ErlNifEnv *env, const ErlNifBinary *serialized_sig, unsigned int flags, const unsigned char *msg_hash, const ErlNifBinary *serialized_pubkey)
+{
+  secp256k1_ecdsa_signature sig;
+  ErlNifTime start;
+  int valid;
+
+  // parsing is part of the verification latency
+  start = stats_start();
+
+  if (!parse_signature(serialized_sig, flags, &sig))
+  {
+    stats_record(STATS_VERIFY, start, 0);
+    if (serialized_sig->size == 64 && !(flags & (SIG_DER | SIG_LAX_DER)))
+    {
+      return error_result(env, "secp256k1_ecdsa_signature_parse_compact failed");
+    }
+    return error_result(env, "secp256k1_ecdsa_signature_parse_der failed");
+  }
+
+  valid = verify_cached(&sig, msg_hash, serialized_pubkey);
+  if (valid < 0)
+  {
+    stats_record(STATS_VERIFY, start, 0);
+    return error_result(env, "secp256k1_ec_pubkey_parse failed");
+  }
+
+  stats_record(STATS_VERIFY, start, valid);
+  return enif_make_atom(env, valid ? "true" : "false");
+}
+
+static ERL_NIF_TERM
+sign(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary msg_hash, auxiliary_rand;
+  const unsigned char *seckey;
+
+  /* load arguments given by Elixir */
+  if (!enif_inspect_binary(env, argv[0], &msg_hash) ||
+      !enif_inspect_binary(env, argv[2], &auxiliary_rand))
+  {
+    return enif_make_badarg(env);
+  }
+
+  /* keypair resource or seckey binary */
+  if (!(seckey = get_seckey(env, argv[1])))
+  {
+    return enif_make_badarg(env);
+  }
+
+  /* check expected arguments size */
+  if (msg_hash.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (auxiliary_rand.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  return sign_hash(env, msg_hash.data, seckey, auxiliary_rand.data);
+}
+
 static ERL_NIF_TERM
 verify(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
   ErlNifBinary serialized_sig, msg_hash, serialized_pubkey;
+  unsigned int flags = 0;
 
-  secp256k1_ecdsa_signature sig;
-  secp256k1_pubkey pubkey;
-
-  // load arguments
+  // load arguments, optional 4th argument are the parsing flags
   if (!enif_inspect_binary(env, argv[0], &serialized_sig) ||
       !enif_inspect_binary(env, argv[1], &msg_hash) ||
-      !enif_inspect_binary(env, argv[2], &serialized_pubkey))
+      !enif_inspect_binary(env, argv[2], &serialized_pubkey) ||
+      (argc == 4 && !enif_get_uint(env, argv[3], &flags)))
   {
     return enif_make_badarg(env);
   }
 
   // check arguments size
-  if (serialized_sig.size != 64 || msg_hash.size != 32 || serialized_pubkey.size != 33)
+  if (msg_hash.size != 32 || serialized_pubkey.size != 33)
   {
     return enif_make_badarg(env);
   }
 
-  if (!secp256k1_ecdsa_signature_parse_compact(ctx, &sig, serialized_sig.data))
+  return verify_hash(env, &serialized_sig, flags, msg_hash.data, &serialized_pubkey);
+}
+
+/* Continues hashing of iodata message, argv is `{hash_state, rest_of_message,
+ * seckey, aux}` */
+static ERL_NIF_TERM
+sign_iodata_continue(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM next[4];
+  hash_state *state;
+  ErlNifBinary auxiliary_rand;
+  const unsigned char *seckey;
+  unsigned char msg_hash[32];
+
+  if (!enif_get_resource(env, argv[0], hash_state_resource_type, (void **)&state))
   {
-    return error_result(env, "secp256k1_ecdsa_signature_parse_compact failed");
+    return enif_make_badarg(env);
   }
 
-  if (!secp256k1_ec_pubkey_parse(ctx, &pubkey, serialized_pubkey.data, serialized_pubkey.size))
+  memcpy(next, argv, sizeof(next));
+  switch (hash_iodata(env, &state->hash, &next[1]))
   {
-    return error_result(env, "secp256k1_ec_pubkey_parse failed");
+  case IODATA_BADARG:
+    return enif_make_badarg(env);
+  case IODATA_YIELD:
+    return enif_schedule_nif(env, "sign_iodata", 0, sign_iodata_continue, 4, next);
+  case IODATA_DONE:
+    break;
+  }
+
+  sha256_finalize(&state->hash, msg_hash);
+
+  /* arguments were checked before hashing started */
+  seckey = get_seckey(env, argv[2]);
+  enif_inspect_binary(env, argv[3], &auxiliary_rand);
+
+  return sign_hash(env, msg_hash, seckey, auxiliary_rand.data);
+}
+
+static ERL_NIF_TERM
+sign_iodata(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM args[4];
+  ErlNifBinary auxiliary_rand;
+
+  /* iodata, seckey, aux and hash tag (nil for plain SHA-256) */
+  if (!get_seckey(env, argv[1]) ||
+      !enif_inspect_binary(env, argv[2], &auxiliary_rand) || auxiliary_rand.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!new_hash_state(env, argv[3], &args[0]))
+  {
+    return enif_make_badarg(env);
+  }
+
+  args[1] = argv[0];
+  args[2] = argv[1];
+  args[3] = argv[2];
+  return sign_iodata_continue(env, 4, args);
+}
+
+/* Continues hashing of iodata message, argv is `{hash_state, rest_of_message,
+ * signature, pubkey}` */
+static ERL_NIF_TERM
+verify_iodata_continue(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM next[4];
+  hash_state *state;
+  ErlNifBinary serialized_sig, serialized_pubkey;
+  unsigned char msg_hash[32];
+
+  if (!enif_get_resource(env, argv[0], hash_state_resource_type, (void **)&state))
+  {
+    return enif_make_badarg(env);
+  }
+
+  memcpy(next, argv, sizeof(next));
+  switch (hash_iodata(env, &state->hash, &next[1]))
+  {
+  case IODATA_BADARG:
+    return enif_make_badarg(env);
+  case IODATA_YIELD:
+    return enif_schedule_nif(env, "verify_iodata", 0, verify_iodata_continue, 4, next);
+  case IODATA_DONE:
+    break;
+  }
+
+  sha256_finalize(&state->hash, msg_hash);
+
+  /* arguments were checked before hashing started */
+  enif_inspect_binary(env, argv[2], &serialized_sig);
+  enif_inspect_binary(env, argv[3], &serialized_pubkey);
+
+  return verify_hash(env, &serialized_sig, 0, msg_hash, &serialized_pubkey);
+}
+
+static ERL_NIF_TERM
+verify_iodata(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM args[4];
+  ErlNifBinary serialized_sig, serialized_pubkey;
+
+  /* signature, iodata, pubkey and hash tag (nil for plain SHA-256) */
+  if (!enif_inspect_binary(env, argv[0], &serialized_sig) ||
+      !enif_inspect_binary(env, argv[2], &serialized_pubkey) || serialized_pubkey.size != 33)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!new_hash_state(env, argv[3], &args[0]))
+  {
+    return enif_make_badarg(env);
+  }
+
+  args[1] = argv[1];
+  args[2] = argv[0];
+  args[3] = argv[2];
+  return verify_iodata_continue(env, 4, args);
+}
+
+/* Verifies every `{signature, msg_hash, pubkey}` entry and sets bit i
+ * (most significant bit first) of the result when entry i is valid */
+static ERL_NIF_TERM
+verify_many_bits(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, result, list = argv[0];
+  ErlNifBinary serialized_sig, msg_hash, serialized_pubkey;
+  const ERL_NIF_TERM *tuple;
+  unsigned int length, flags, index = 0, valid = 0;
+  unsigned char *bits;
+  ErlNifTime start;
+  int arity;
+
+  secp256k1_ecdsa_signature sig;
+
+  if (!enif_get_list_length(env, list, &length) || !enif_get_uint(env, argv[1], &flags))
+  {
+    return enif_make_badarg(env);
+  }
+
+  bits = enif_make_new_binary(env, (length + 7) / 8, &result);
+  memset(bits, 0, (length + 7) / 8);
+  start = stats_start();
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    if (!enif_get_tuple(env, head, &arity, &tuple) || arity != 3 ||
+        !enif_inspect_binary(env, tuple[0], &serialized_sig) ||
+        !enif_inspect_binary(env, tuple[1], &msg_hash) ||
+        !enif_inspect_binary(env, tuple[2], &serialized_pubkey))
+    {
+      return enif_make_badarg(env);
+    }
+
+    if (msg_hash.size != 32 || (serialized_pubkey.size != 33 && serialized_pubkey.size != 65))
+    {
+      return enif_make_badarg(env);
+    }
+
+    if (parse_signature(&serialized_sig, flags, &sig) &&
+        verify_cached(&sig, msg_hash.data, &serialized_pubkey) > 0)
+    {
+      bits[index / 8] |= 0x80 >> (index % 8);
+      valid++;
+    }
+
+    index++;
+    list = tail;
+  }
+
+  if (!enif_is_empty_list(env, list))
+  {
+    return enif_make_badarg(env);
+  }
+
+  stats_record(STATS_VERIFY_BATCH, start, valid == length);
+  return result;
+}
+
+static ERL_NIF_TERM
+verify_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  unsigned int length;
+  size_t cost;
+
+  if (!enif_get_list_length(env, argv[0], &length))
+  {
+    return enif_make_badarg(env);
+  }
+
+  cost = (size_t)length * VERIFY_COST_US;
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "verify_many", ERL_NIF_DIRTY_JOB_CPU_BOUND, verify_many_bits, argc, argv);
+  }
+
+  result = verify_many_bits(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+/* Signature conversions of `convert_many` */
+typedef enum
+{
+  CONVERT_PARSE_DER,
+  CONVERT_PARSE_DER_LAX,
+  CONVERT_SERIALIZE_DER,
+  CONVERT_NORMALIZE
+} convert_op;
+
+/* Converts single signature, `out` has to fit 72 bytes (DER maximum) and
+ * `outlen` is set to the result size, returns 0 for invalid signature */
+static int
+convert_signature(convert_op op, const ErlNifBinary *input, unsigned char *out, size_t *outlen)
+{
+  secp256k1_ecdsa_signature sig;
+
+  switch (op)
+  {
+  case CONVERT_PARSE_DER:
+    if (!secp256k1_ecdsa_signature_parse_der(ctx, &sig, input->data, input->size))
+    {
+      return 0;
+    }
+    break;
+  case CONVERT_PARSE_DER_LAX:
+    if (!parse_der_lax(&sig, input->data, input->size))
+    {
+      return 0;
+    }
+    break;
+  case CONVERT_SERIALIZE_DER:
+  case CONVERT_NORMALIZE:
+    if (input->size != 64 || !secp256k1_ecdsa_signature_parse_compact(ctx, &sig, input->data))
+    {
+      return 0;
+    }
+    break;
+  }
+
+  if (op == CONVERT_SERIALIZE_DER)
+  {
+    *outlen = 72;
+    return secp256k1_ecdsa_signature_serialize_der(ctx, out, outlen, &sig);
+  }
+
+  if (op == CONVERT_NORMALIZE)
+  {
+    secp256k1_ecdsa_signature_normalize(ctx, &sig, &sig);
+  }
+
+  *outlen = 64;
+  return secp256k1_ecdsa_signature_serialize_compact(ctx, out, &sig);
+}
+
+/* Converts the signature or returns error result with `failed` message */
+static ERL_NIF_TERM
+convert_one(ErlNifEnv *env, convert_op op, ERL_NIF_TERM term, char *failed)
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary input;
+  unsigned char output[72];
+  unsigned char *finished;
+  size_t outlen;
+
+  if (!enif_inspect_binary(env, term, &input))
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!convert_signature(op, &input, output, &outlen))
+  {
+    return error_result(env, failed);
+  }
+
+  finished = enif_make_new_binary(env, outlen, &result);
+  memcpy(finished, output, outlen);
+  return result;
+}
+
+static ERL_NIF_TERM
+parse_der_sig(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  if (enif_is_identical(argv[1], enif_make_atom(env, "true")))
+  {
+    return convert_one(env, CONVERT_PARSE_DER_LAX, argv[0], "lax DER parsing failed");
   }
 
-  if (secp256k1_ecdsa_verify(ctx, &sig, msg_hash.data, &pubkey))
+  return convert_one(env, CONVERT_PARSE_DER, argv[0], "secp256k1_ecdsa_signature_parse_der failed");
+}
+
+static ERL_NIF_TERM
+serialize_der(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  return convert_one(env, CONVERT_SERIALIZE_DER, argv[0], "secp256k1_ecdsa_signature_serialize_der failed");
+}
+
+static ERL_NIF_TERM
+normalize(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  return convert_one(env, CONVERT_NORMALIZE, argv[0], "secp256k1_ecdsa_signature_parse_compact failed");
+}
+
+static int
+get_convert_op(ErlNifEnv *env, ERL_NIF_TERM term, convert_op *op)
+{
+  static const char *names[] = {"parse_der", "parse_der_lax", "serialize_der", "normalize"};
+  int i;
+
+  for (i = 0; i < 4; i++)
   {
-    return enif_make_atom(env, "true");
+    if (enif_is_identical(term, enif_make_atom(env, names[i])))
+    {
+      *op = (convert_op)i;
+      return 1;
+    }
   }
 
-  return enif_make_atom(env, "false");
+  return 0;
+}
+
+/* Converts every signature of the list, invalid ones are returned as `nil` */
+static ERL_NIF_TERM
+convert_many_list(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, list = argv[0];
+  ERL_NIF_TERM *results;
+  ERL_NIF_TERM result, nil;
+  ErlNifBinary input;
+  unsigned int length, index = 0;
+  unsigned char output[72];
+  unsigned char *finished;
+  size_t outlen;
+  convert_op op;
+
+  if (!enif_get_list_length(env, list, &length) || !get_convert_op(env, argv[1], &op))
+  {
+    return enif_make_badarg(env);
+  }
+
+  results = enif_alloc(sizeof(ERL_NIF_TERM) * (length > 0 ? length : 1));
+  if (!results)
+  {
+    return error_result(env, "enif_alloc failed");
+  }
+  nil = enif_make_atom(env, "nil");
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    if (!enif_inspect_binary(env, head, &input))
+    {
+      enif_free(results);
+      return enif_make_badarg(env);
+    }
+
+    if (convert_signature(op, &input, output, &outlen))
+    {
+      finished = enif_make_new_binary(env, outlen, &results[index]);
+      memcpy(finished, output, outlen);
+    }
+    else
+    {
+      results[index] = nil;
+    }
+
+    index++;
+    list = tail;
+  }
+
+  result = enif_make_list_from_array(env, results, length);
+  enif_free(results);
+  return result;
+}
+
+static ERL_NIF_TERM
+convert_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  unsigned int length;
+  size_t cost;
+
+  if (!enif_get_list_length(env, argv[0], &length))
+  {
+    return enif_make_badarg(env);
+  }
+
+  cost = (size_t)length * PARSE_COST_US;
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "convert_many", ERL_NIF_DIRTY_JOB_CPU_BOUND, convert_many_list, argc, argv);
+  }
+
+  result = convert_many_list(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
 }
 
 static ErlNifFunc nif_funcs[] = {
@@ -264,8 +1129,21 @@ static ErlNifFunc nif_funcs[] = {
     {"uncompressed_pubkey", 1, uncompressed_pubkey},
     {"compress_pubkey", 1, compress_pubkey},
     {"decompress_pubkey", 1, decompress_pubkey},
+    {"keypair", 1, keypair},
+    {"random_keypairs", 2, random_keypairs},
     {"sign", 3, sign},
     {"valid?", 3, verify},
+    {"verify_flags", 4, verify},
+    {"verify_many", 2, verify_many},
+    {"parse_der_sig", 2, parse_der_sig},
+    {"serialize_der", 1, serialize_der},
+    {"normalize", 1, normalize},
+    {"convert_many", 2, convert_many},
+    {"sign_iodata", 4, sign_iodata},
+    {"verify_iodata", 4, verify_iodata},
+    {"sigcache_configure", 1, configure_sigcache},
+    {"sigcache_stats", 0, sigcache_stats},
+    {"stats", 0, stats},
 };
 
-ERL_NIF_INIT(Elixir.Secp256k1.ECDSA, nif_funcs, &load, NULL, &upgrade, &unload)
+ERL_NIF_INIT(Elixir.Secp256k1.ECDSA, nif_funcs, &ecdsa_load, NULL, &upgrade, &ecdsa_unload)
@@ -0,0 +1,190 @@
+#include "utils.h"
+
+#include <secp256k1_ellswift.h>
+
+// API
+
+static ERL_NIF_TERM
+encode(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary pubkey;
+
+  secp256k1_pubkey pubkey_parsed;
+
+  unsigned char ell64[64];
+  unsigned char rnd32[32];
+  unsigned char *finished;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &pubkey))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (pubkey.size != 33 && pubkey.size != 65)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!secp256k1_ec_pubkey_parse(ctx, &pubkey_parsed, pubkey.data, pubkey.size))
+  {
+    return error_result(env, "secp256k1_ec_pubkey_parse failed");
+  }
+
+  if (!fill_random(rnd32, sizeof(rnd32)))
+  {
+    return error_result(env, "RNG failed");
+  }
+
+  if (!secp256k1_ellswift_encode(ctx, ell64, &pubkey_parsed, rnd32))
+  {
+    return error_result(env, "secp256k1_ellswift_encode failed");
+  }
+
+  /* Convert encoding to Erlang binary */
+  finished = enif_make_new_binary(env, sizeof(ell64), &result);
+  memcpy(finished, ell64, sizeof(ell64));
+  return result;
+}
+
+static ERL_NIF_TERM
+decode(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary ell64;
+
+  secp256k1_pubkey pubkey;
+
+  unsigned char serialized_pubkey[33];
+  unsigned char *finished;
+  size_t len;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &ell64))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (ell64.size != 64)
+  {
+    return enif_make_badarg(env);
+  }
+
+  /* Every 64 byte string decodes to a valid pubkey */
+  if (!secp256k1_ellswift_decode(ctx, &pubkey, ell64.data))
+  {
+    return error_result(env, "secp256k1_ellswift_decode failed");
+  }
+
+  len = sizeof(serialized_pubkey);
+  if (!secp256k1_ec_pubkey_serialize(ctx, serialized_pubkey, &len, &pubkey, SECP256K1_EC_COMPRESSED))
+  {
+    return error_result(env, "secp256k1_ec_pubkey_serialize failed");
+  }
+
+  /* Convert serialized pubkey to Erlang binary */
+  finished = enif_make_new_binary(env, sizeof(serialized_pubkey), &result);
+  memcpy(finished, serialized_pubkey, sizeof(serialized_pubkey));
+  return result;
+}
+
+static ERL_NIF_TERM
+create(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary seckey;
+
+  unsigned char ell64[64];
+  unsigned char auxrnd32[32];
+  unsigned char *finished;
+  ErlNifTime start;
+  int ok;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &seckey))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!fill_random(auxrnd32, sizeof(auxrnd32)))
+  {
+    return error_result(env, "RNG failed");
+  }
+
+  start = stats_start();
+  ok = secp256k1_ellswift_create(signing_ctx(), ell64, seckey.data, auxrnd32);
+  stats_record(STATS_PUBKEY, start, ok);
+  secure_erase(auxrnd32, sizeof(auxrnd32));
+  if (!ok)
+  {
+    return error_result(env, "secp256k1_ellswift_create failed");
+  }
+
+  /* Convert encoding to Erlang binary */
+  finished = enif_make_new_binary(env, sizeof(ell64), &result);
+  memcpy(finished, ell64, sizeof(ell64));
+  return result;
+}
+
+static ERL_NIF_TERM
+xdh(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary ell_a64, ell_b64, seckey;
+
+  unsigned char shared_secret[32];
+  unsigned char *finished;
+  unsigned int party;
+  ErlNifTime start;
+  int ok;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &ell_a64) ||
+      !enif_inspect_binary(env, argv[1], &ell_b64) ||
+      !enif_inspect_binary(env, argv[2], &seckey) ||
+      !enif_get_uint(env, argv[3], &party))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (ell_a64.size != 64 || ell_b64.size != 64 || party > 1 ||
+      !(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  {
+    return enif_make_badarg(env);
+  }
+
+  start = stats_start();
+  ok = secp256k1_ellswift_xdh(ctx, shared_secret, ell_a64.data, ell_b64.data, seckey.data, party,
+                              secp256k1_ellswift_xdh_hash_function_bip324, NULL);
+  stats_record(STATS_ECDH, start, ok);
+  if (!ok)
+  {
+    return error_result(env, "secp256k1_ellswift_xdh failed");
+  }
+
+  /* Convert shared secret to Erlang binary */
+  finished = enif_make_new_binary(env, sizeof(shared_secret), &result);
+  memcpy(finished, shared_secret, sizeof(shared_secret));
+  secure_erase(shared_secret, sizeof(shared_secret));
+  return result;
+}
+
+static ErlNifFunc nif_funcs[] = {
+    {"encode", 1, encode},
+    {"decode", 1, decode},
+    {"create", 1, create},
+    {"bip324_xdh", 4, xdh},
+    {"stats", 0, stats},
+};
+
+ERL_NIF_INIT(Elixir.Secp256k1.ElligatorSwift, nif_funcs, &load, NULL, &upgrade, &unload)
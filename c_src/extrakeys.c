@@ -1,8 +1,73 @@
 #include "utils.h"
+#include "sha2.h"
 
 #include <secp256k1.h>
 #include <secp256k1_extrakeys.h>
 
+#define TWEAK_COST_US 20
+
+/* BIP341 TapTweak of internal key and optional (NULL) merkle root */
+static void
+taptweak(unsigned char *tweak32, const unsigned char *internal32, const unsigned char *merkle_root32)
+{
+  sha256_ctx hash;
+
+  sha256_init_tagged(&hash, (const unsigned char *)"TapTweak", 8);
+  sha256_write(&hash, internal32, 32);
+  if (merkle_root32)
+  {
+    sha256_write(&hash, merkle_root32, 32);
+  }
+  sha256_finalize(&hash, tweak32);
+}
+
+/* Loads merkle root argument, `nil` or 32 bytes binary, returns 0 for invalid
+ * argument */
+static int
+get_merkle_root(ErlNifEnv *env, ERL_NIF_TERM term, const unsigned char **merkle_root32)
+{
+  ErlNifBinary merkle_root;
+
+  if (enif_is_identical(term, enif_make_atom(env, "nil")))
+  {
+    *merkle_root32 = NULL;
+    return 1;
+  }
+
+  if (!enif_inspect_binary(env, term, &merkle_root) || merkle_root.size != 32)
+  {
+    return 0;
+  }
+
+  *merkle_root32 = merkle_root.data;
+  return 1;
+}
+
+/* Adds tweak to internal xonly pubkey, writes serialized output key and its
+ * parity, returns 0 for invalid internal key or tweak */
+static int
+output_key(unsigned char *output32, int *parity, const unsigned char *internal32, const unsigned char *tweak32)
+{
+  secp256k1_xonly_pubkey internal, output;
+  secp256k1_pubkey tweaked;
+
+  return secp256k1_xonly_pubkey_parse(ctx, &internal, internal32) &&
+         secp256k1_xonly_pubkey_tweak_add(ctx, &tweaked, &internal, tweak32) &&
+         secp256k1_xonly_pubkey_from_pubkey(ctx, &output, parity, &tweaked) &&
+         secp256k1_xonly_pubkey_serialize(ctx, output32, &output);
+}
+
+static ERL_NIF_TERM
+make_output_key(ErlNifEnv *env, const unsigned char *output32, int parity)
+{
+  ERL_NIF_TERM key;
+  unsigned char *finished;
+
+  finished = enif_make_new_binary(env, 32, &key);
+  memcpy(finished, output32, 32);
+  return enif_make_tuple2(env, key, enif_make_int(env, parity));
+}
+
 // API
 
 static ERL_NIF_TERM
@@ -16,6 +81,8 @@ xonly_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 
   unsigned char serialized_pubkey[32];
   unsigned char *finished;
+  ErlNifTime start;
+  int ok;
 
   // load arguments
   if (!enif_inspect_binary(env, argv[0], &seckey))
@@ -29,7 +96,10 @@ xonly_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     return enif_make_badarg(env);
   }
 
-  if (!secp256k1_keypair_create(ctx, &keypair, seckey.data))
+  start = stats_start();
+  ok = secp256k1_keypair_create(signing_ctx(), &keypair, seckey.data);
+  stats_record(STATS_PUBKEY, start, ok);
+  if (!ok)
   {
     return error_result(env, "secp256k1_keypair_create failed");
   }
@@ -51,8 +121,324 @@ xonly_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   return result;
 }
 
+static ERL_NIF_TERM
+xonly_from_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary pubkey;
+
+  secp256k1_pubkey pubkey_parsed;
+  secp256k1_xonly_pubkey xonly;
+
+  unsigned char serialized_pubkey[32];
+  int parity;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &pubkey))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (pubkey.size != 33 && pubkey.size != 65)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!secp256k1_ec_pubkey_parse(ctx, &pubkey_parsed, pubkey.data, pubkey.size))
+  {
+    return error_result(env, "secp256k1_ec_pubkey_parse failed");
+  }
+
+  if (!secp256k1_xonly_pubkey_from_pubkey(ctx, &xonly, &parity, &pubkey_parsed))
+  {
+    return error_result(env, "secp256k1_xonly_pubkey_from_pubkey failed");
+  }
+
+  if (!secp256k1_xonly_pubkey_serialize(ctx, serialized_pubkey, &xonly))
+  {
+    return error_result(env, "secp256k1_xonly_pubkey_serialize failed");
+  }
+
+  return make_output_key(env, serialized_pubkey, parity);
+}
+
+static ERL_NIF_TERM
+tweak_add(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary internal, tweak;
+
+  unsigned char serialized_pubkey[32];
+  int parity;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &internal) ||
+      !enif_inspect_binary(env, argv[1], &tweak))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (internal.size != 32 || tweak.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!output_key(serialized_pubkey, &parity, internal.data, tweak.data))
+  {
+    return error_result(env, "secp256k1_xonly_pubkey_tweak_add failed");
+  }
+
+  return make_output_key(env, serialized_pubkey, parity);
+}
+
+static ERL_NIF_TERM
+tweak_add_check(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary output, internal, tweak;
+
+  secp256k1_xonly_pubkey internal_parsed;
+
+  int parity;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &output) ||
+      !enif_get_int(env, argv[1], &parity) ||
+      !enif_inspect_binary(env, argv[2], &internal) ||
+      !enif_inspect_binary(env, argv[3], &tweak))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (output.size != 32 || (parity != 0 && parity != 1) || internal.size != 32 || tweak.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!secp256k1_xonly_pubkey_parse(ctx, &internal_parsed, internal.data))
+  {
+    return error_result(env, "secp256k1_xonly_pubkey_parse failed");
+  }
+
+  return enif_make_atom(env, secp256k1_xonly_pubkey_tweak_add_check(ctx, output.data, parity, &internal_parsed, tweak.data) ? "true" : "false");
+}
+
+/* Tweaks seckey like `tweak_add` tweaks its xonly pubkey, with `nil` tweak
+ * the BIP341 TapTweak is used with merkle root in argv[2] */
+static ERL_NIF_TERM
+seckey_tweak_add(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary seckey, tweak;
+
+  secp256k1_keypair keypair;
+  secp256k1_xonly_pubkey internal;
+
+  const unsigned char *merkle_root32;
+  unsigned char internal32[32];
+  unsigned char tweak32[32];
+  unsigned char tweaked_seckey[32];
+  unsigned char *finished;
+  ErlNifTime start;
+  int ok;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &seckey) || !get_merkle_root(env, argv[2], &merkle_root32))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (enif_inspect_binary(env, argv[1], &tweak))
+  {
+    if (tweak.size != 32)
+    {
+      return enif_make_badarg(env);
+    }
+    memcpy(tweak32, tweak.data, sizeof(tweak32));
+  }
+  else if (!enif_is_identical(argv[1], enif_make_atom(env, "nil")))
+  {
+    return enif_make_badarg(env);
+  }
+
+  start = stats_start();
+  ok = secp256k1_keypair_create(signing_ctx(), &keypair, seckey.data);
+  stats_record(STATS_PUBKEY, start, ok);
+  if (!ok)
+  {
+    return error_result(env, "secp256k1_keypair_create failed");
+  }
+
+  if (!enif_is_binary(env, argv[1]))
+  {
+    secp256k1_keypair_xonly_pub(ctx, &internal, NULL, &keypair);
+    secp256k1_xonly_pubkey_serialize(ctx, internal32, &internal);
+    taptweak(tweak32, internal32, merkle_root32);
+  }
+
+  if (!secp256k1_keypair_xonly_tweak_add(ctx, &keypair, tweak32) ||
+      !secp256k1_keypair_sec(ctx, tweaked_seckey, &keypair))
+  {
+    secure_erase(&keypair, sizeof(keypair));
+    return error_result(env, "secp256k1_keypair_xonly_tweak_add failed");
+  }
+
+  /* Convert seckey to Erlang binary */
+  finished = enif_make_new_binary(env, sizeof(tweaked_seckey), &result);
+  memcpy(finished, tweaked_seckey, sizeof(tweaked_seckey));
+  secure_erase(tweaked_seckey, sizeof(tweaked_seckey));
+  secure_erase(&keypair, sizeof(keypair));
+  return result;
+}
+
+static ERL_NIF_TERM
+taproot_output(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary internal;
+
+  const unsigned char *merkle_root32;
+  unsigned char serialized_pubkey[32];
+  unsigned char tweak32[32];
+  int parity;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &internal) || !get_merkle_root(env, argv[1], &merkle_root32))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (internal.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  taptweak(tweak32, internal.data, merkle_root32);
+  if (!output_key(serialized_pubkey, &parity, internal.data, tweak32))
+  {
+    return error_result(env, "secp256k1_xonly_pubkey_tweak_add failed");
+  }
+
+  return make_output_key(env, serialized_pubkey, parity);
+}
+
+/* Computes output key of every list entry, `{internal_key, tweak}` tuples
+ * when argv[1] is `false` and internal keys or `{internal_key, merkle_root}`
+ * tuples for BIP341 TapTweak when it is `true`, `nil` for invalid entries */
+static ERL_NIF_TERM
+output_keys(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, result, list = argv[0];
+  ERL_NIF_TERM *results;
+  ErlNifBinary internal, tweak;
+  const ERL_NIF_TERM *tuple;
+  const unsigned char *merkle_root32;
+  unsigned char serialized_pubkey[32];
+  unsigned char tweak32[32];
+  unsigned int length, index = 0;
+  int arity, parity, taproot;
+
+  if (!enif_get_list_length(env, list, &length))
+  {
+    return enif_make_badarg(env);
+  }
+  taproot = enif_is_identical(argv[1], enif_make_atom(env, "true"));
+
+  results = enif_alloc(sizeof(ERL_NIF_TERM) * (length > 0 ? length : 1));
+  if (!results)
+  {
+    return error_result(env, "enif_alloc failed");
+  }
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    merkle_root32 = NULL;
+
+    if (taproot && enif_is_binary(env, head))
+    {
+      // internal key without script path
+      enif_inspect_binary(env, head, &internal);
+    }
+    else if (!enif_get_tuple(env, head, &arity, &tuple) || arity != 2 ||
+             !enif_inspect_binary(env, tuple[0], &internal) ||
+             (taproot && !get_merkle_root(env, tuple[1], &merkle_root32)) ||
+             (!taproot && !(enif_inspect_binary(env, tuple[1], &tweak) && tweak.size == 32)))
+    {
+      enif_free(results);
+      return enif_make_badarg(env);
+    }
+
+    if (internal.size != 32)
+    {
+      enif_free(results);
+      return enif_make_badarg(env);
+    }
+
+    if (taproot)
+    {
+      taptweak(tweak32, internal.data, merkle_root32);
+    }
+    else
+    {
+      memcpy(tweak32, tweak.data, sizeof(tweak32));
+    }
+
+    if (output_key(serialized_pubkey, &parity, internal.data, tweak32))
+    {
+      results[index] = make_output_key(env, serialized_pubkey, parity);
+    }
+    else
+    {
+      results[index] = enif_make_atom(env, "nil");
+    }
+
+    index++;
+    list = tail;
+  }
+
+  result = enif_make_list_from_array(env, results, length);
+  enif_free(results);
+  return result;
+}
+
+static ERL_NIF_TERM
+output_keys_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  unsigned int length;
+  size_t cost;
+
+  if (!enif_get_list_length(env, argv[0], &length))
+  {
+    return enif_make_badarg(env);
+  }
+
+  cost = (size_t)length * TWEAK_COST_US;
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "output_keys", ERL_NIF_DIRTY_JOB_CPU_BOUND, output_keys, argc, argv);
+  }
+
+  result = output_keys(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
 static ErlNifFunc nif_funcs[] = {
     {"xonly_pubkey", 1, xonly_pubkey},
+    {"xonly_from_pubkey", 1, xonly_from_pubkey},
+    {"tweak_add", 2, tweak_add},
+    {"tweak_add_check", 4, tweak_add_check},
+    {"seckey_tweak", 3, seckey_tweak_add},
+    {"taproot_output", 2, taproot_output},
+    {"output_keys", 2, output_keys_many},
+    {"stats", 0, stats},
 };
 
 ERL_NIF_INIT(Elixir.Secp256k1.Extrakeys, nif_funcs, &load, NULL, &upgrade, &unload)
@@ -0,0 +1,166 @@
+#include "sha2.h"
+
+/* Hashing of iodata messages inside the NIFs
+ *
+ * The message is walked without flattening it, binaries are hashed in place.
+ * Pending work is kept as a small stack of iodata terms. When the timeslice is
+ * used up the stack is folded back into a single iodata term and the NIF
+ * reschedules itself with it and the hash state resource, continuing where it
+ * stopped. Include after utils.h. */
+
+#define IODATA_CHUNK 16384  // bytes hashed between timeslice checks
+#define IODATA_DEPTH 64     // nesting kept on the C stack before folding
+
+// Resource type of partial hash carried over between rescheduled calls
+static ErlNifResourceType *hash_state_resource_type;
+
+typedef struct {
+  sha256_ctx hash;
+} hash_state;
+
+typedef enum {
+  IODATA_DONE,
+  IODATA_YIELD,
+  IODATA_BADARG
+} iodata_status;
+
+static int
+open_hash_state_type(ErlNifEnv *env)
+{
+  hash_state_resource_type = enif_open_resource_type(
+    env,
+    NULL,
+    "hash_state_resource",
+    NULL,
+    ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+    NULL
+  );
+
+  return hash_state_resource_type != NULL;
+}
+
+/* Creates hash state of plain SHA-256 (`nil` tag) or BIP340 tagged hash and
+ * stores its term in `term`, NULL for invalid tag */
+static hash_state *
+new_hash_state(ErlNifEnv *env, ERL_NIF_TERM tag, ERL_NIF_TERM *term)
+{
+  ErlNifBinary tag_bin;
+  hash_state *state;
+  int tagged;
+
+  tagged = enif_inspect_binary(env, tag, &tag_bin);
+  if (!tagged && !enif_is_identical(tag, enif_make_atom(env, "nil"))) {
+    return NULL;
+  }
+
+  state = enif_alloc_resource(hash_state_resource_type, sizeof(hash_state));
+  if (!state) {
+    return NULL;
+  }
+
+  if (tagged) {
+    sha256_init_tagged(&state->hash, tag_bin.data, tag_bin.size);
+  } else {
+    sha256_init(&state->hash);
+  }
+
+  *term = enif_make_resource(env, state);
+  enif_release_resource(state);
+  return state;
+}
+
+/* Folds the stack into one iodata term, innermost (next to hash) first */
+static ERL_NIF_TERM
+fold_iodata(ErlNifEnv *env, const ERL_NIF_TERM *frames, int depth)
+{
+  ERL_NIF_TERM acc = frames[0];
+  int i;
+
+  for (i = 1; i < depth; i++) {
+    acc = enif_make_list_cell(env, frames[i], acc);
+  }
+
+  return acc;
+}
+
+/* Hashes binary from `offset`, at most `budget` bytes of it, returns the
+ * number of bytes hashed */
+static size_t
+hash_binary(sha256_ctx *hash, const ErlNifBinary *bin, size_t offset, size_t budget)
+{
+  size_t take = bin->size - offset < budget ? bin->size - offset : budget;
+
+  sha256_write(hash, bin->data + offset, take);
+  return take;
+}
+
+/* Hashes `iodata` until done or until the timeslice is used up, in which case
+ * `iodata` is replaced by the rest of the work */
+static iodata_status
+hash_iodata(ErlNifEnv *env, sha256_ctx *hash, ERL_NIF_TERM *iodata)
+{
+  ERL_NIF_TERM frames[IODATA_DEPTH], head, tail;
+  ErlNifBinary bin;
+  size_t taken, budget = IODATA_CHUNK, offset = 0;
+  unsigned int byte;
+  unsigned char c;
+  int depth = 1;
+
+  frames[0] = *iodata;
+
+  while (depth > 0) {
+    if (budget == 0) {
+      budget = IODATA_CHUNK;
+      if (enif_thread_type() == ERL_NIF_THR_NORMAL_SCHEDULER &&
+          enif_consume_timeslice(env, IODATA_CHUNK / HASH_BYTES_PER_US * 100 / TIMESLICE_US + 1)) {
+        // rest of partially hashed binary
+        if (offset > 0 && enif_inspect_binary(env, frames[depth - 1], &bin)) {
+          frames[depth - 1] = enif_make_sub_binary(env, frames[depth - 1], offset, bin.size - offset);
+        }
+        *iodata = fold_iodata(env, frames, depth);
+        return IODATA_YIELD;
+      }
+    }
+
+    // binary (also as improper list tail), `offset` bytes of it already hashed
+    if (enif_inspect_binary(env, frames[depth - 1], &bin)) {
+      taken = hash_binary(hash, &bin, offset, budget);
+      budget -= taken;
+      offset += taken;
+      if (offset == bin.size) {
+        offset = 0;
+        depth--;
+      }
+      continue;
+    }
+
+    if (enif_is_empty_list(env, frames[depth - 1])) {
+      depth--;
+      continue;
+    }
+
+    if (!enif_get_list_cell(env, frames[depth - 1], &head, &tail)) {
+      return IODATA_BADARG;
+    }
+    frames[depth - 1] = tail;
+
+    if (enif_get_uint(env, head, &byte)) {
+      if (byte > 255) {
+        return IODATA_BADARG;
+      }
+      c = (unsigned char)byte;
+      sha256_write(hash, &c, 1);
+      budget--;
+      continue;
+    }
+
+    // nested binary or list, fold the stack when it is too deep
+    if (depth == IODATA_DEPTH) {
+      frames[0] = fold_iodata(env, frames, depth);
+      depth = 1;
+    }
+    frames[depth++] = head;
+  }
+
+  return IODATA_DONE;
+}
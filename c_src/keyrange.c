@@ -0,0 +1,405 @@
+#include "utils.h"
+
+// Rough cost (us) of moving to the next key of the range (one point addition
+// and one field inversion), see utils.h
+#define STEP_COST_US 3
+#define MAX_THREADS 1024
+
+/* Key range walking
+ *
+ * Pubkey of `seckey + i + 1` is derived from pubkey of `seckey + i` by adding
+ * the generator with secp256k1_ec_pubkey_combine, which is several times
+ * cheaper than secp256k1_ec_pubkey_create for every key. Matching seckeys are
+ * computed only when reported. */
+
+// Resource type of a running grind, destroying it stops the threads
+static ErlNifResourceType *grinder_resource_type;
+
+struct grinder;
+
+typedef struct {
+  struct grinder *grinder;
+  unsigned int index;
+  ErlNifTid tid;
+} grind_thread;
+
+typedef struct grinder {
+  ErlNifPid pid;
+  ErlNifBinary ref;                // caller's reference in external term format
+  unsigned char seckey[32];
+  secp256k1_pubkey step;           // threads * G
+  unsigned char prefix[33];
+  unsigned int prefix_bits;
+  int xonly;
+  ErlNifUInt64 count;              // keys to try
+  ErlNifUInt64 limit;              // matches to report, 0 for unlimited
+  ErlNifUInt64 matches;            // atomic
+  ErlNifUInt64 tried;              // atomic
+  int stop;                        // atomic
+  int running;                     // atomic
+  int joined;                      // atomic
+  unsigned int stride;             // number of threads walking the range
+  unsigned int n_threads;          // threads successfully started
+  grind_thread *threads;
+} grinder;
+
+static void
+stop_grinder(grinder *g)
+{
+  unsigned int i;
+
+  __atomic_store_n(&g->stop, 1, __ATOMIC_RELAXED);
+  if (__atomic_exchange_n(&g->joined, 1, __ATOMIC_ACQ_REL)) {
+    return;
+  }
+  for (i = 0; i < g->n_threads; i++) {
+    enif_thread_join(g->threads[i].tid, NULL);
+  }
+}
+
+static void
+destruct_grinder(ErlNifEnv *env, void *obj)
+{
+  grinder *g = (grinder *)obj;
+
+  stop_grinder(g);
+  if (g->threads) {
+    enif_free(g->threads);
+  }
+  if (g->ref.data) {
+    enif_release_binary(&g->ref);
+  }
+  secure_erase(g->seckey, sizeof(g->seckey));
+}
+
+static int
+keyrange_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
+{
+  // Initialize the library context via utils.h's load
+  if (load(env, priv, load_info) != 0) {
+    return -1;
+  }
+
+  grinder_resource_type = enif_open_resource_type(
+    env,
+    NULL,
+    "grinder_resource",
+    destruct_grinder,
+    ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+    NULL
+  );
+
+  if (!grinder_resource_type) {
+    return -1;
+  }
+
+  return 0;
+}
+
+// Big endian 32 byte scalar of the offset
+static void
+offset_tweak(ErlNifUInt64 offset, unsigned char tweak[32])
+{
+  int i;
+
+  memset(tweak, 0, 32);
+  for (i = 31; i >= 24; i--) {
+    tweak[i] = offset & 0xff;
+    offset >>= 8;
+  }
+}
+
+// Computes `seckey + offset`, returns 0 when the result is not a valid seckey
+static int
+offset_seckey(const unsigned char *seckey, ErlNifUInt64 offset, unsigned char result[32])
+{
+  unsigned char tweak[32];
+
+  memcpy(result, seckey, 32);
+  offset_tweak(offset, tweak);
+  return secp256k1_ec_seckey_tweak_add(ctx, result, tweak);
+}
+
+/* Pubkey of `seckey + offset`, called from the grind threads which are not
+ * schedulers so the base context is used instead of `signing_ctx()` */
+static int
+offset_pubkey(const unsigned char *seckey, ErlNifUInt64 offset, secp256k1_pubkey *pubkey)
+{
+  unsigned char tmp[32];
+  int ok;
+
+  ok = offset_seckey(seckey, offset, tmp) && secp256k1_ec_pubkey_create(ctx, pubkey, tmp);
+  secure_erase(tmp, sizeof(tmp));
+  return ok;
+}
+
+// Moves pubkey by `step`, returns 0 on point at infinity
+static int
+next_pubkey(secp256k1_pubkey *pubkey, const secp256k1_pubkey *step)
+{
+  secp256k1_pubkey next;
+  const secp256k1_pubkey *pair[2] = {pubkey, step};
+
+  if (!secp256k1_ec_pubkey_combine(ctx, &next, pair, 2)) {
+    return 0;
+  }
+  memcpy(pubkey, &next, sizeof(next));
+  return 1;
+}
+
+static int
+prefix_matches(const grinder *g, const unsigned char *key)
+{
+  unsigned int bytes = g->prefix_bits / 8, bits = g->prefix_bits % 8;
+
+  if (memcmp(key, g->prefix, bytes) != 0) {
+    return 0;
+  }
+
+  return bits == 0 || ((key[bytes] ^ g->prefix[bytes]) & (0xff00 >> bits) & 0xff) == 0;
+}
+
+// Sends `{ref, {:match, seckey, pubkey}}` to the caller
+static void
+send_match(grinder *g, ErlNifEnv *env, ErlNifUInt64 offset, const unsigned char *key, size_t key_len)
+{
+  ERL_NIF_TERM ref, seckey_term, pubkey_term;
+  unsigned char *seckey;
+
+  if (!enif_binary_to_term(env, g->ref.data, g->ref.size, &ref, 0)) {
+    return;
+  }
+
+  seckey = enif_make_new_binary(env, 32, &seckey_term);
+  if (!offset_seckey(g->seckey, offset, seckey)) {
+    return;
+  }
+  memcpy(enif_make_new_binary(env, key_len, &pubkey_term), key, key_len);
+
+  enif_send(NULL, &g->pid, env,
+    enif_make_tuple2(env, ref, enif_make_tuple3(env, enif_make_atom(env, "match"), seckey_term, pubkey_term)));
+}
+
+// Sends `{ref, {:done, tried}}` to the caller
+static void
+send_done(grinder *g, ErlNifEnv *env)
+{
+  ERL_NIF_TERM ref;
+
+  if (!enif_binary_to_term(env, g->ref.data, g->ref.size, &ref, 0)) {
+    return;
+  }
+
+  enif_send(NULL, &g->pid, env,
+    enif_make_tuple2(env, ref, enif_make_tuple2(env, enif_make_atom(env, "done"),
+      enif_make_uint64(env, __atomic_load_n(&g->tried, __ATOMIC_ACQUIRE)))));
+}
+
+/* Thread `index` of `n` walks offsets index, index + n, index + 2n, ... */
+static void *
+grind_worker(void *arg)
+{
+  grind_thread *t = (grind_thread *)arg;
+  grinder *g = t->grinder;
+  ErlNifEnv *env;
+  secp256k1_pubkey pubkey;
+  unsigned char serialized[33];
+  unsigned int stride = g->stride;
+  ErlNifUInt64 offset = t->index, tried = 0, found;
+  size_t len;
+
+  env = enif_alloc_env();
+
+  if (env && offset < g->count && offset_pubkey(g->seckey, offset, &pubkey)) {
+    while (!__atomic_load_n(&g->stop, __ATOMIC_RELAXED)) {
+      len = sizeof(serialized);
+      secp256k1_ec_pubkey_serialize(ctx, serialized, &len, &pubkey, SECP256K1_EC_COMPRESSED);
+      tried++;
+
+      // x-only pubkey is the compressed one without the parity byte
+      if (prefix_matches(g, g->xonly ? serialized + 1 : serialized)) {
+        found = __atomic_add_fetch(&g->matches, 1, __ATOMIC_RELAXED);
+        if (!g->limit || found <= g->limit) {
+          send_match(g, env, offset, g->xonly ? serialized + 1 : serialized, g->xonly ? 32 : 33);
+          enif_clear_env(env);
+        }
+        if (g->limit && found >= g->limit) {
+          __atomic_store_n(&g->stop, 1, __ATOMIC_RELAXED);
+        }
+      }
+
+      if (g->count - offset <= stride || !next_pubkey(&pubkey, &g->step)) {
+        break;
+      }
+      offset += stride;
+    }
+  }
+
+  __atomic_add_fetch(&g->tried, tried, __ATOMIC_RELEASE);
+  if (__atomic_sub_fetch(&g->running, 1, __ATOMIC_ACQ_REL) == 0 && env) {
+    send_done(g, env);
+  }
+
+  if (env) {
+    enif_free_env(env);
+  }
+  return NULL;
+}
+
+// API
+
+static ERL_NIF_TERM
+pubkeys(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result, *keys;
+  ErlNifBinary seckey;
+  secp256k1_pubkey pubkey, generator;
+  unsigned char one[32] = {0};
+  unsigned char serialized[33];
+  unsigned int count, i;
+  size_t len;
+  int xonly;
+
+  if (!enif_inspect_binary(env, argv[0], &seckey) ||
+      !enif_get_uint(env, argv[1], &count) ||
+      !enif_is_atom(env, argv[2])) {
+    return enif_make_badarg(env);
+  }
+
+  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data))) {
+    return enif_make_badarg(env);
+  }
+  xonly = enif_is_identical(argv[2], enif_make_atom(env, "true"));
+
+  // whole range is produced in one go, large ones on dirty scheduler
+  if (needs_dirty_scheduler((size_t)count * STEP_COST_US)) {
+    return enif_schedule_nif(env, "range_pubkeys", ERL_NIF_DIRTY_JOB_CPU_BOUND, pubkeys, argc, argv);
+  }
+
+  keys = enif_alloc((count ? count : 1) * sizeof(ERL_NIF_TERM));
+  if (!keys) {
+    return error_result(env, "enif_alloc failed");
+  }
+
+  one[31] = 1;
+  if (count && (!secp256k1_ec_pubkey_create(ctx, &generator, one) ||
+                !secp256k1_ec_pubkey_create(signing_ctx(), &pubkey, seckey.data))) {
+    enif_free(keys);
+    return error_result(env, "secp256k1_ec_pubkey_create failed");
+  }
+
+  for (i = 0; i < count; i++) {
+    if (i > 0 && !next_pubkey(&pubkey, &generator)) {
+      enif_free(keys);
+      return error_result(env, "secp256k1_ec_pubkey_combine failed");
+    }
+
+    len = sizeof(serialized);
+    secp256k1_ec_pubkey_serialize(ctx, serialized, &len, &pubkey, SECP256K1_EC_COMPRESSED);
+    memcpy(enif_make_new_binary(env, xonly ? 32 : 33, &keys[i]), xonly ? serialized + 1 : serialized, xonly ? 32 : 33);
+  }
+
+  result = enif_make_list_from_array(env, keys, count);
+  enif_free(keys);
+  consume_timeslice(env, (size_t)count * STEP_COST_US);
+  return result;
+}
+
+static ERL_NIF_TERM
+grind(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary seckey, prefix;
+  grinder *g;
+  unsigned char stride[32];
+  unsigned int prefix_bits, threads, i;
+  ErlNifUInt64 count, limit;
+
+  if (!enif_inspect_binary(env, argv[0], &seckey) ||
+      !enif_inspect_binary(env, argv[1], &prefix) ||
+      !enif_get_uint(env, argv[2], &prefix_bits) ||
+      !enif_is_atom(env, argv[3]) ||
+      !enif_get_uint(env, argv[4], &threads) ||
+      !enif_get_uint64(env, argv[5], &count) ||
+      !enif_get_uint64(env, argv[6], &limit) ||
+      !enif_is_ref(env, argv[7])) {
+    return enif_make_badarg(env);
+  }
+
+  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)) ||
+      prefix.size > sizeof(g->prefix) || prefix_bits > prefix.size * 8 ||
+      threads == 0 || threads > MAX_THREADS) {
+    return enif_make_badarg(env);
+  }
+
+  // x-only pubkeys are one byte shorter
+  if (enif_is_identical(argv[3], enif_make_atom(env, "true")) && prefix_bits > 256) {
+    return enif_make_badarg(env);
+  }
+
+  g = enif_alloc_resource(grinder_resource_type, sizeof(grinder));
+  if (!g) {
+    return error_result(env, "enif_alloc_resource failed");
+  }
+  memset(g, 0, sizeof(grinder));
+
+  enif_self(env, &g->pid);
+  memcpy(g->seckey, seckey.data, 32);
+  memcpy(g->prefix, prefix.data, prefix.size);
+  g->prefix_bits = prefix_bits;
+  g->xonly = enif_is_identical(argv[3], enif_make_atom(env, "true"));
+  g->count = count;
+  g->limit = limit;
+
+  offset_tweak(threads, stride);
+  if (!enif_term_to_binary(env, argv[7], &g->ref) ||
+      !secp256k1_ec_pubkey_create(ctx, &g->step, stride)) {
+    enif_release_resource(g);
+    return error_result(env, "grind setup failed");
+  }
+
+  g->threads = enif_alloc(threads * sizeof(grind_thread));
+  if (!g->threads) {
+    enif_release_resource(g);
+    return error_result(env, "enif_alloc failed");
+  }
+
+  // stride is fixed before the first thread starts
+  g->running = threads;
+  g->stride = threads;
+  for (i = 0; i < threads; i++) {
+    g->threads[i].grinder = g;
+    g->threads[i].index = i;
+    if (enif_thread_create("secp256k1_grind", &g->threads[i].tid, grind_worker, &g->threads[i], NULL) != 0) {
+      // destructor stops and joins the threads which are already running
+      enif_release_resource(g);
+      return error_result(env, "enif_thread_create failed");
+    }
+    g->n_threads++;
+  }
+
+  result = enif_make_resource(env, g);
+  enif_release_resource(g);
+  return result;
+}
+
+static ERL_NIF_TERM
+stop(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  grinder *g;
+
+  if (!enif_get_resource(env, argv[0], grinder_resource_type, (void **)&g)) {
+    return enif_make_badarg(env);
+  }
+
+  stop_grinder(g);
+  return enif_make_atom(env, "ok");
+}
+
+static ErlNifFunc nif_funcs[] = {
+  {"range_pubkeys", 3, pubkeys},
+  {"start_grind", 8, grind},
+  {"stop", 1, stop}
+};
+
+ERL_NIF_INIT(Elixir.Secp256k1.KeyRange, nif_funcs, &keyrange_load, NULL, &upgrade, &unload)
@@ -0,0 +1,299 @@
+#include "utils.h"
+
+#include <limits.h>
+#include <secp256k1_ecdh.h>
+#include <secp256k1_extrakeys.h>
+#include <secp256k1_schnorrsig.h>
+
+// Resource type holding parsed pubkeys so verification can skip parsing
+static ErlNifResourceType *keyring_resource_type;
+
+typedef struct {
+  ErlNifRWLock *lock;
+  secp256k1_pubkey *pubkeys;
+  size_t size;
+  size_t capacity;
+} keyring;
+
+#define KEYRING_INITIAL_CAPACITY 64
+
+static void
+destruct_keyring(ErlNifEnv *env, void *obj)
+{
+  keyring *kr = (keyring *)obj;
+
+  if (kr->pubkeys) {
+    enif_free(kr->pubkeys);
+  }
+  if (kr->lock) {
+    enif_rwlock_destroy(kr->lock);
+  }
+}
+
+static int
+keyring_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
+{
+  // Initialize the library context via utils.h's load
+  if (load(env, priv, load_info) != 0) {
+    return -1;
+  }
+
+  keyring_resource_type = enif_open_resource_type(
+    env,
+    NULL,
+    "keyring_resource",
+    destruct_keyring,
+    ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+    NULL
+  );
+
+  if (!keyring_resource_type) {
+    return -1;
+  }
+
+  return 0;
+}
+
+// Copies pubkey stored under index out of the keyring, returns 0 for unknown index
+static int
+keyring_get(keyring *kr, unsigned int index, secp256k1_pubkey *pubkey)
+{
+  int found = 0;
+
+  enif_rwlock_rlock(kr->lock);
+  if (index < kr->size) {
+    memcpy(pubkey, &kr->pubkeys[index], sizeof(secp256k1_pubkey));
+    found = 1;
+  }
+  enif_rwlock_runlock(kr->lock);
+
+  return found;
+}
+
+// Loads keyring resource and pubkey index arguments
+static int
+get_keyring_pubkey(ErlNifEnv *env, ERL_NIF_TERM kr_term, ERL_NIF_TERM index_term, secp256k1_pubkey *pubkey)
+{
+  keyring *kr;
+  unsigned int index;
+
+  if (!enif_get_resource(env, kr_term, keyring_resource_type, (void **)&kr) ||
+      !enif_get_uint(env, index_term, &index)) {
+    return 0;
+  }
+
+  return keyring_get(kr, index, pubkey);
+}
+
+// API
+
+static ERL_NIF_TERM
+new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  keyring *kr;
+
+  kr = enif_alloc_resource(keyring_resource_type, sizeof(keyring));
+  if (!kr) {
+    return error_result(env, "enif_alloc_resource failed");
+  }
+  kr->size = 0;
+  kr->capacity = 0;
+  kr->pubkeys = NULL;
+  kr->lock = enif_rwlock_create("secp256k1_keyring");
+  if (!kr->lock) {
+    enif_release_resource(kr);
+    return error_result(env, "enif_rwlock_create failed");
+  }
+
+  result = enif_make_resource(env, kr);
+  enif_release_resource(kr);
+  return result;
+}
+
+static ERL_NIF_TERM
+add(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  keyring *kr;
+  ErlNifBinary bin_pubkey;
+  secp256k1_pubkey pubkey;
+  secp256k1_pubkey *pubkeys;
+  unsigned char even_pubkey[33];
+  size_t capacity;
+  unsigned int index;
+
+  if (!enif_get_resource(env, argv[0], keyring_resource_type, (void **)&kr) ||
+      !enif_inspect_binary(env, argv[1], &bin_pubkey)) {
+    return enif_make_badarg(env);
+  }
+
+  // x-only pubkeys are stored as the full point with even Y
+  if (bin_pubkey.size == 32) {
+    even_pubkey[0] = 0x02;
+    memcpy(even_pubkey + 1, bin_pubkey.data, 32);
+    if (!secp256k1_ec_pubkey_parse(ctx, &pubkey, even_pubkey, sizeof(even_pubkey))) {
+      return error_result(env, "secp256k1_ec_pubkey_parse failed");
+    }
+  } else if (bin_pubkey.size == 33 || bin_pubkey.size == 65) {
+    if (!secp256k1_ec_pubkey_parse(ctx, &pubkey, bin_pubkey.data, bin_pubkey.size)) {
+      return error_result(env, "secp256k1_ec_pubkey_parse failed");
+    }
+  } else {
+    return enif_make_badarg(env);
+  }
+
+  enif_rwlock_rwlock(kr->lock);
+  if (kr->size == kr->capacity) {
+    capacity = kr->capacity ? kr->capacity * 2 : KEYRING_INITIAL_CAPACITY;
+    if (capacity > UINT_MAX) {
+      enif_rwlock_rwunlock(kr->lock);
+      return error_result(env, "keyring is full");
+    }
+    pubkeys = enif_realloc(kr->pubkeys, capacity * sizeof(secp256k1_pubkey));
+    if (!pubkeys) {
+      enif_rwlock_rwunlock(kr->lock);
+      return error_result(env, "enif_realloc failed");
+    }
+    kr->pubkeys = pubkeys;
+    kr->capacity = capacity;
+  }
+  index = (unsigned int)kr->size;
+  memcpy(&kr->pubkeys[index], &pubkey, sizeof(pubkey));
+  kr->size++;
+  enif_rwlock_rwunlock(kr->lock);
+
+  return enif_make_uint(env, index);
+}
+
+static ERL_NIF_TERM
+size(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  keyring *kr;
+  size_t result;
+
+  if (!enif_get_resource(env, argv[0], keyring_resource_type, (void **)&kr)) {
+    return enif_make_badarg(env);
+  }
+
+  enif_rwlock_rlock(kr->lock);
+  result = kr->size;
+  enif_rwlock_runlock(kr->lock);
+
+  return enif_make_uint(env, (unsigned int)result);
+}
+
+static ERL_NIF_TERM
+ecdsa_verify(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary serialized_sig, msg_hash;
+  secp256k1_ecdsa_signature sig;
+  secp256k1_pubkey pubkey;
+  ErlNifTime start;
+  int valid;
+
+  if (!get_keyring_pubkey(env, argv[0], argv[1], &pubkey) ||
+      !enif_inspect_binary(env, argv[2], &serialized_sig) ||
+      !enif_inspect_binary(env, argv[3], &msg_hash)) {
+    return enif_make_badarg(env);
+  }
+
+  if (serialized_sig.size != 64 || msg_hash.size != 32) {
+    return enif_make_badarg(env);
+  }
+
+  start = stats_start();
+  if (!secp256k1_ecdsa_signature_parse_compact(ctx, &sig, serialized_sig.data)) {
+    stats_record(STATS_VERIFY, start, 0);
+    return error_result(env, "secp256k1_ecdsa_signature_parse_compact failed");
+  }
+
+  valid = secp256k1_ecdsa_verify(ctx, &sig, msg_hash.data, &pubkey);
+  stats_record(STATS_VERIFY, start, valid);
+
+  return enif_make_atom(env, valid ? "true" : "false");
+}
+
+static ERL_NIF_TERM
+schnorr_verify(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary signature, message;
+  secp256k1_pubkey pubkey;
+  secp256k1_xonly_pubkey xonly_pubkey;
+  ErlNifTime start;
+  size_t cost;
+  int valid;
+
+  if (!get_keyring_pubkey(env, argv[0], argv[1], &pubkey) ||
+      !enif_inspect_binary(env, argv[2], &signature) ||
+      !enif_inspect_binary(env, argv[3], &message)) {
+    return enif_make_badarg(env);
+  }
+
+  if (signature.size != 64) {
+    return enif_make_badarg(env);
+  }
+
+  // long messages are hashed on dirty scheduler
+  cost = VERIFY_COST_US + message.size / HASH_BYTES_PER_US;
+  if (needs_dirty_scheduler(cost)) {
+    return enif_schedule_nif(env, "schnorr_valid?", ERL_NIF_DIRTY_JOB_CPU_BOUND, schnorr_verify, argc, argv);
+  }
+
+  // no square root needed, the point is already parsed
+  start = stats_start();
+  if (!secp256k1_xonly_pubkey_from_pubkey(ctx, &xonly_pubkey, NULL, &pubkey)) {
+    stats_record(STATS_VERIFY, start, 0);
+    return error_result(env, "secp256k1_xonly_pubkey_from_pubkey failed");
+  }
+
+  valid = secp256k1_schnorrsig_verify(ctx, signature.data, message.data, message.size, &xonly_pubkey);
+  stats_record(STATS_VERIFY, start, valid);
+  consume_timeslice(env, cost);
+
+  return enif_make_atom(env, valid ? "true" : "false");
+}
+
+static ERL_NIF_TERM
+ecdh(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary seckey;
+  secp256k1_pubkey pubkey;
+  unsigned char shared_secret[32];
+  unsigned char *finished;
+  ErlNifTime start;
+  int ok;
+
+  if (!get_keyring_pubkey(env, argv[0], argv[1], &pubkey) ||
+      !enif_inspect_binary(env, argv[2], &seckey)) {
+    return enif_make_badarg(env);
+  }
+
+  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data))) {
+    return enif_make_badarg(env);
+  }
+
+  start = stats_start();
+  ok = secp256k1_ecdh(ctx, shared_secret, &pubkey, seckey.data, NULL, NULL);
+  stats_record(STATS_ECDH, start, ok);
+  if (!ok) {
+    return error_result(env, "secp256k1_ecdh failed");
+  }
+
+  finished = enif_make_new_binary(env, sizeof(shared_secret), &result);
+  memcpy(finished, shared_secret, sizeof(shared_secret));
+  secure_erase(shared_secret, sizeof(shared_secret));
+  return result;
+}
+
+static ErlNifFunc nif_funcs[] = {
+  {"new", 0, new},
+  {"add", 2, add},
+  {"size", 1, size},
+  {"ecdsa_valid?", 4, ecdsa_verify},
+  {"schnorr_valid?", 4, schnorr_verify},
+  {"ecdh", 3, ecdh},
+  {"stats", 0, stats}
+};
+
+ERL_NIF_INIT(Elixir.Secp256k1.Keyring, nif_funcs, &keyring_load, NULL, &upgrade, &unload)
@@ -1,7 +1,24 @@
 #include "utils.h"
+#include "sha2.h"
 
+#include <stdlib.h>
 #include <secp256k1_musig.h>
 
+// Rough per-item cost (us) of the list based functions, see utils.h
+#define KEYAGG_COST_US 15
+#define NONCE_AGG_COST_US (2 * PARSE_COST_US)
+#define PARTIAL_SIG_AGG_COST_US 1
+#define PARTIAL_VERIFY_COST_US 100
+
+#define KEYAGG_MEMO_DEFAULT_SIZE 256
+
+#define NONCE_POOL_MAX_DEPTH 65536
+// Longest uninterrupted sleep of the refill thread, bounds how long destroying a pool waits
+#define NONCE_POOL_PAUSE_SLICE_US 1000
+
+// Packed `partial_sig <> pubnonce <> compressed pubkey` entry
+#define PACKED_ENTRY_SIZE (32 + 66 + 33)
+
 // Resource type for secret nonces to prevent copying and allow secure erasure
 static ErlNifResourceType *secnonce_resource_type;
 
@@ -10,12 +27,120 @@ typedef struct {
   int used;
 } secnonce_wrapper;
 
+/* Key aggregation caches and sessions are immutable once created, so
+ * concurrent signing calls read them straight from the resource. They hold
+ * only public data and need no destructor. */
+static ErlNifResourceType *keyagg_cache_resource_type;
+static ErlNifResourceType *session_resource_type;
+
+typedef struct {
+  secp256k1_musig_keyagg_cache cache;
+} keyagg_cache_wrapper;
+
+typedef struct {
+  secp256k1_musig_session session;
+} session_wrapper;
+
+/* Memo of key aggregations
+ *
+ * Direct mapped table from SHA-256 of the compressed pubkeys (in aggregation
+ * order) to the keepalive reference of the resulting cache, so aggregating a
+ * known key set again is a hash of the serialized keys instead of parsing and
+ * point additions. A new entry replaces whatever occupied its slot. */
+typedef struct {
+  unsigned char digest[32];
+  unsigned char agg_pk[32];
+  keyagg_cache_wrapper *cache;  // kept reference, NULL for an empty slot
+} keyagg_memo_entry;
+
+static struct {
+  ErlNifMutex *lock;
+  keyagg_memo_entry *entries;
+  unsigned int size;
+  unsigned long hits, misses;  // atomic
+} keyagg_memo;
+
+/* Pool of pre-generated nonces
+ *
+ * A background thread keeps a ring of secnonce/pubnonce pairs of one signer
+ * filled up to `depth`, generating at most `rate` pairs per second (0 for no
+ * limit). Taking a pair moves it out of the ring into a regular secnonce
+ * resource under the lock and erases the slot, so every pair is handed out
+ * once. Pairs left in the ring are erased with the pool. The thread uses its
+ * own randomized context. */
+static ErlNifResourceType *nonce_pool_resource_type;
+
+typedef struct {
+  ErlNifMutex *lock;
+  ErlNifCond *cond;
+  ErlNifTid tid;
+  int started;
+  int stop;                              // guarded by lock
+  secp256k1_context *ctx;                // refill thread only
+  unsigned char seckey[32];
+  int has_seckey;
+  secp256k1_pubkey pubkey;
+  secp256k1_musig_secnonce *secnonces;   // ring of depth pairs, guarded by lock
+  secp256k1_musig_pubnonce *pubnonces;
+  unsigned int depth, head, count;       // guarded by lock
+  unsigned int rate;                     // atomic
+  ErlNifUInt64 generated, taken, misses; // atomic
+} nonce_pool;
+
+// Secnonces currently alive and those destroyed without ever being used, see `musig_stats`
+static unsigned long secnonces_live = 0;
+static unsigned long secnonces_unused = 0;
+
 static void
 destruct_secnonce(ErlNifEnv *env, void *obj)
 {
+  secnonce_wrapper *wrapper = (secnonce_wrapper *)obj;
+
+  __atomic_fetch_sub(&secnonces_live, 1, __ATOMIC_RELAXED);
+  if (!wrapper->used) {
+    __atomic_fetch_add(&secnonces_unused, 1, __ATOMIC_RELAXED);
+  }
   secure_erase(obj, sizeof(secnonce_wrapper));
 }
 
+// Erases and frees ring of `depth` pairs
+static void
+free_nonce_ring(secp256k1_musig_secnonce *secnonces, secp256k1_musig_pubnonce *pubnonces,
+                unsigned int depth)
+{
+  if (secnonces) {
+    secure_erase(secnonces, depth * sizeof(secp256k1_musig_secnonce));
+    enif_free(secnonces);
+  }
+  if (pubnonces) {
+    enif_free(pubnonces);
+  }
+}
+
+/* Runs on the scheduler collecting the last reference and joins the refill
+ * thread. The thread wakes up from the condition at once and checks `stop`
+ * between pairs and every NONCE_POOL_PAUSE_SLICE_US of its pause, so the
+ * join waits at most about one nonce generation or one pause slice. */
+static void
+destruct_nonce_pool(ErlNifEnv *env, void *obj)
+{
+  nonce_pool *pool = (nonce_pool *)obj;
+
+  if (pool->started) {
+    enif_mutex_lock(pool->lock);
+    pool->stop = 1;
+    enif_cond_broadcast(pool->cond);
+    enif_mutex_unlock(pool->lock);
+    enif_thread_join(pool->tid, NULL);
+  }
+
+  free_nonce_ring(pool->secnonces, pool->pubnonces, pool->depth);
+  if (pool->ctx) secp256k1_context_destroy(pool->ctx);
+  if (pool->cond) enif_cond_destroy(pool->cond);
+  if (pool->lock) enif_mutex_destroy(pool->lock);
+  secure_erase(pool->seckey, sizeof(pool->seckey));
+}
+
 static int
 musig_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 {
@@ -33,100 +158,430 @@ musig_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
     NULL
   );
 
-  if (!secnonce_resource_type) {
+  keyagg_cache_resource_type = enif_open_resource_type(
+    env,
+    NULL,
+    "keyagg_cache_resource",
+    NULL,
+    ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+    NULL
+  );
+
+  session_resource_type = enif_open_resource_type(
+    env,
+    NULL,
+    "session_resource",
+    NULL,
+    ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+    NULL
+  );
+
+  nonce_pool_resource_type = enif_open_resource_type(
+    env,
+    NULL,
+    "nonce_pool_resource",
+    destruct_nonce_pool,
+    ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+    NULL
+  );
+
+  if (!secnonce_resource_type || !keyagg_cache_resource_type || !session_resource_type ||
+      !nonce_pool_resource_type) {
+    return -1;
+  }
+
+  memset(&keyagg_memo, 0, sizeof(keyagg_memo));
+  keyagg_memo.lock = enif_mutex_create("secp256k1_keyagg_memo");
+  keyagg_memo.entries = enif_alloc(KEYAGG_MEMO_DEFAULT_SIZE * sizeof(keyagg_memo_entry));
+  if (!keyagg_memo.lock || !keyagg_memo.entries) {
     return -1;
   }
+  memset(keyagg_memo.entries, 0, KEYAGG_MEMO_DEFAULT_SIZE * sizeof(keyagg_memo_entry));
+  keyagg_memo.size = KEYAGG_MEMO_DEFAULT_SIZE;
 
   return 0;
 }
 
+// Releases the caches kept by the memo entries and frees them
+static void
+free_memo_entries(keyagg_memo_entry *entries, unsigned int size)
+{
+  unsigned int i;
+
+  for (i = 0; i < size; i++) {
+    if (entries[i].cache) {
+      enif_release_resource(entries[i].cache);
+    }
+  }
+  enif_free(entries);
+}
+
+static void
+musig_unload(ErlNifEnv *env, void *priv)
+{
+  if (keyagg_memo.entries) {
+    free_memo_entries(keyagg_memo.entries, keyagg_memo.size);
+  }
+  enif_mutex_destroy(keyagg_memo.lock);
+  unload(env, priv);
+}
+
+// Returns key aggregation cache of the resource, NULL for invalid argument
+static const secp256k1_musig_keyagg_cache *
+get_cache(ErlNifEnv *env, ERL_NIF_TERM term)
+{
+  keyagg_cache_wrapper *wrapper;
+
+  if (!enif_get_resource(env, term, keyagg_cache_resource_type, (void **)&wrapper)) {
+    return NULL;
+  }
+
+  return &wrapper->cache;
+}
+
+// Returns session of the resource, NULL for invalid argument
+static const secp256k1_musig_session *
+get_session(ErlNifEnv *env, ERL_NIF_TERM term)
+{
+  session_wrapper *wrapper;
+
+  if (!enif_get_resource(env, term, session_resource_type, (void **)&wrapper)) {
+    return NULL;
+  }
+
+  return &wrapper->session;
+}
+
+// Allocates cache resource, returns NULL on failure
+static keyagg_cache_wrapper *
+new_cache(void)
+{
+  return enif_alloc_resource(keyagg_cache_resource_type, sizeof(keyagg_cache_wrapper));
+}
+
+// Makes term of the new resource and hands its ownership to the term
 static ERL_NIF_TERM
-pubkey_agg(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+make_resource_term(ErlNifEnv *env, void *wrapper)
+{
+  ERL_NIF_TERM term = enif_make_resource(env, wrapper);
+
+  enif_release_resource(wrapper);
+  return term;
+}
+
+/* Input key of an aggregation, compressed keys are parsed only when the
+ * aggregation is not memoized and every key is parsed at most once */
+typedef struct {
+  unsigned char serialized[33];  // compressed, records are sorted by it
+  int parsed;
+  secp256k1_pubkey pubkey;
+} agg_key;
+
+static int
+compare_agg_keys(const void *a, const void *b)
+{
+  return memcmp(((const agg_key *)a)->serialized, ((const agg_key *)b)->serialized, 33);
+}
+
+/* Reads list of pubkeys, with `sort` the keys are put in the order of
+ * secp256k1_ec_pubkey_sort (by compressed serialization). Returns 0 for
+ * invalid argument. */
+static int
+read_agg_keys(ErlNifEnv *env, ERL_NIF_TERM list, unsigned int n_pubkeys, int sort, agg_key *keys)
+{
+  ERL_NIF_TERM head, tail;
+  ErlNifBinary bin;
+  size_t len;
+  unsigned int i;
+
+  for (i = 0; i < n_pubkeys; i++) {
+    if (!enif_get_list_cell(env, list, &head, &tail) || !enif_inspect_binary(env, head, &bin)) {
+      return 0;
+    }
+    if (bin.size == 33) {
+      memcpy(keys[i].serialized, bin.data, 33);
+      keys[i].parsed = 0;
+    } else {
+      len = 33;
+      if (!secp256k1_ec_pubkey_parse(ctx, &keys[i].pubkey, bin.data, bin.size) ||
+          !secp256k1_ec_pubkey_serialize(ctx, keys[i].serialized, &len, &keys[i].pubkey,
+                                         SECP256K1_EC_COMPRESSED)) {
+        return 0;
+      }
+      keys[i].parsed = 1;
+    }
+    list = tail;
+  }
+
+  if (sort) {
+    qsort(keys, n_pubkeys, sizeof(agg_key), compare_agg_keys);
+  }
+
+  return 1;
+}
+
+static void
+agg_keys_digest(const agg_key *keys, unsigned int n_pubkeys, unsigned char digest[32])
+{
+  sha256_ctx hash;
+  unsigned int i;
+
+  sha256_init(&hash);
+  for (i = 0; i < n_pubkeys; i++) {
+    sha256_write(&hash, keys[i].serialized, 33);
+  }
+  sha256_finalize(&hash, digest);
+}
+
+static keyagg_memo_entry *
+memo_slot(const unsigned char digest[32])
+{
+  unsigned int index = (unsigned int)digest[0] << 24 | digest[1] << 16 | digest[2] << 8 | digest[3];
+
+  return &keyagg_memo.entries[index % keyagg_memo.size];
+}
+
+/* Looks up aggregation of the key set, on hit sets the aggregated key and
+ * returns kept cache reference the caller has to release */
+static keyagg_cache_wrapper *
+memo_lookup(const unsigned char digest[32], unsigned char agg_pk[32])
+{
+  keyagg_memo_entry *entry;
+  keyagg_cache_wrapper *cache = NULL;
+
+  enif_mutex_lock(keyagg_memo.lock);
+  if (keyagg_memo.size > 0) {
+    entry = memo_slot(digest);
+    if (entry->cache && memcmp(entry->digest, digest, 32) == 0) {
+      cache = entry->cache;
+      enif_keep_resource(cache);
+      memcpy(agg_pk, entry->agg_pk, 32);
+    }
+  }
+  enif_mutex_unlock(keyagg_memo.lock);
+
+  __atomic_add_fetch(cache ? &keyagg_memo.hits : &keyagg_memo.misses, 1, __ATOMIC_RELAXED);
+  return cache;
+}
+
+static void
+memo_insert(const unsigned char digest[32], const unsigned char agg_pk[32],
+            keyagg_cache_wrapper *cache)
+{
+  keyagg_memo_entry *entry;
+
+  enif_mutex_lock(keyagg_memo.lock);
+  if (keyagg_memo.size > 0) {
+    entry = memo_slot(digest);
+    if (entry->cache) {
+      enif_release_resource(entry->cache);
+    }
+    memcpy(entry->digest, digest, 32);
+    memcpy(entry->agg_pk, agg_pk, 32);
+    entry->cache = cache;
+    enif_keep_resource(cache);
+  }
+  enif_mutex_unlock(keyagg_memo.lock);
+}
+
+static ERL_NIF_TERM
+make_agg_result(ErlNifEnv *env, const unsigned char agg_pk[32], keyagg_cache_wrapper *cache)
+{
+  ERL_NIF_TERM agg_pk_term;
+
+  memcpy(enif_make_new_binary(env, 32, &agg_pk_term), agg_pk, 32);
+  return enif_make_tuple3(env, enif_make_atom(env, "ok"), agg_pk_term, make_resource_term(env, cache));
+}
+
+/* Aggregates list of pubkeys, argv is `pubkeys, sort, memo`. Sets `cost` to
+ * the work actually done, a memo hit costs only reading and hashing the keys. */
+static ERL_NIF_TERM
+aggregate_keys(ErlNifEnv *env, const ERL_NIF_TERM argv[], size_t *cost)
 {
-  ERL_NIF_TERM head, tail, list = argv[0];
   unsigned int n_pubkeys;
-  secp256k1_pubkey *pubkeys;
-  const secp256k1_pubkey **pubkeys_ptrs;
+  agg_key *keys = NULL;
+  const secp256k1_pubkey **pubkeys_ptrs = NULL;
   secp256k1_xonly_pubkey agg_pk;
-  secp256k1_musig_keyagg_cache cache;
-  unsigned char serialized_agg_pk[32];
-  ErlNifBinary bin_cache, bin_agg_pk;
+  keyagg_cache_wrapper *cache = NULL;
+  unsigned char serialized_agg_pk[32], digest[32];
   unsigned int i;
+  ErlNifTime start;
+  int sort, memo, ok;
+
+  enif_get_list_length(env, argv[0], &n_pubkeys);
+  sort = enif_is_identical(argv[1], enif_make_atom(env, "true"));
+  memo = enif_is_identical(argv[2], enif_make_atom(env, "true"));
+  *cost = (size_t)n_pubkeys * PARSE_COST_US;
 
-  if (!enif_get_list_length(env, list, &n_pubkeys) || n_pubkeys == 0) {
+  keys = enif_alloc(n_pubkeys * sizeof(agg_key));
+  if (!keys) {
+    return error_result(env, "enif_alloc failed");
+  }
+  if (!read_agg_keys(env, argv[0], n_pubkeys, sort, keys)) {
+    enif_free(keys);
     return enif_make_badarg(env);
   }
 
-  // Allocate memory for pubkeys and pointers
-  pubkeys = enif_alloc(n_pubkeys * sizeof(secp256k1_pubkey));
+  if (memo) {
+    agg_keys_digest(keys, n_pubkeys, digest);
+    if ((cache = memo_lookup(digest, serialized_agg_pk))) {
+      enif_free(keys);
+      return make_agg_result(env, serialized_agg_pk, cache);
+    }
+  }
+
+  *cost = (size_t)n_pubkeys * KEYAGG_COST_US;
   pubkeys_ptrs = enif_alloc(n_pubkeys * sizeof(secp256k1_pubkey *));
-  if (!pubkeys || !pubkeys_ptrs) {
-    if (pubkeys) enif_free(pubkeys);
-    if (pubkeys_ptrs) enif_free(pubkeys_ptrs);
-    return error_result(env, "enif_alloc failed");
+  cache = new_cache();
+  if (!pubkeys_ptrs || !cache) {
+    ok = -1;
+    goto cleanup;
   }
 
-  // Parse pubkeys from list
-  for (i = 0; i < n_pubkeys; i++) {
-    ErlNifBinary bin;
-    if (!enif_get_list_cell(env, list, &head, &tail)) {
-      goto bad_arg;
+  // parse the compressed keys in aggregation order, uncompressed ones already are
+  for (ok = 1, i = 0; ok && i < n_pubkeys; i++) {
+    if (!keys[i].parsed) {
+      ok = secp256k1_ec_pubkey_parse(ctx, &keys[i].pubkey, keys[i].serialized, 33);
     }
-    if (!enif_inspect_binary(env, head, &bin) ||
-        !secp256k1_ec_pubkey_parse(ctx, &pubkeys[i], bin.data, bin.size)) {
-      goto bad_arg;
-    }
-    pubkeys_ptrs[i] = &pubkeys[i];
-    list = tail;
+    pubkeys_ptrs[i] = &keys[i].pubkey;
+  }
+  if (!ok) {
+    goto cleanup;
   }
 
-  if (!secp256k1_musig_pubkey_agg(ctx, &agg_pk, &cache, pubkeys_ptrs, n_pubkeys)) {
-    enif_free(pubkeys);
-    enif_free(pubkeys_ptrs);
+  start = stats_start();
+  ok = secp256k1_musig_pubkey_agg(ctx, &agg_pk, &cache->cache, pubkeys_ptrs, n_pubkeys) &&
+       secp256k1_xonly_pubkey_serialize(ctx, serialized_agg_pk, &agg_pk);
+  stats_record(STATS_MUSIG_AGG, start, ok);
+  if (!ok) {
+    ok = -2;
+    goto cleanup;
+  }
+
+  if (memo) {
+    memo_insert(digest, serialized_agg_pk, cache);
+  }
+
+cleanup:
+  enif_free(keys);
+  if (pubkeys_ptrs) enif_free(pubkeys_ptrs);
+
+  if (ok > 0) {
+    return make_agg_result(env, serialized_agg_pk, cache);
+  }
+
+  if (cache) enif_release_resource(cache);
+  if (ok == -1) {
+    return error_result(env, "enif_alloc failed");
+  }
+  if (ok == -2) {
     return error_result(env, "secp256k1_musig_pubkey_agg failed");
   }
+  return enif_make_badarg(env);
+}
+
+static ERL_NIF_TERM
+aggregate_pubkeys(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  size_t cost;
+
+  return aggregate_keys(env, argv, &cost);
+}
 
-  enif_free(pubkeys);
-  enif_free(pubkeys_ptrs);
+/* Key sets which would not fit a timeslice without the memo are handled
+ * entirely on dirty scheduler, including the memo lookup, so the keys are
+ * read once; smaller ones report the cost of the work actually done */
+static ERL_NIF_TERM
+pubkey_agg(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  unsigned int n_pubkeys;
+  size_t cost;
+
+  if (!enif_get_list_length(env, argv[0], &n_pubkeys) || n_pubkeys == 0 ||
+      !enif_is_atom(env, argv[1]) || !enif_is_atom(env, argv[2])) {
+    return enif_make_badarg(env);
+  }
 
-  if (!secp256k1_xonly_pubkey_serialize(ctx, serialized_agg_pk, &agg_pk)) {
-    return error_result(env, "secp256k1_xonly_pubkey_serialize failed");
+  if (needs_dirty_scheduler((size_t)n_pubkeys * KEYAGG_COST_US)) {
+    return enif_schedule_nif(env, "pubkey_agg_keys", ERL_NIF_DIRTY_JOB_CPU_BOUND, aggregate_pubkeys, argc, argv);
   }
 
-  enif_alloc_binary(sizeof(cache), &bin_cache);
-  memcpy(bin_cache.data, &cache, sizeof(cache));
+  result = aggregate_keys(env, argv, &cost);
+  consume_timeslice(env, cost);
+  return result;
+}
 
-  enif_alloc_binary(sizeof(serialized_agg_pk), &bin_agg_pk);
-  memcpy(bin_agg_pk.data, serialized_agg_pk, sizeof(serialized_agg_pk));
+/* Resizes the memo dropping all entries, 0 disables it */
+static ERL_NIF_TERM
+keyagg_memo_configure(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  keyagg_memo_entry *entries = NULL, *old;
+  unsigned int size, old_size;
 
-  return enif_make_tuple3(env,
-    enif_make_atom(env, "ok"),
-    enif_make_binary(env, &bin_agg_pk),
-    enif_make_binary(env, &bin_cache)
-  );
+  if (!enif_get_uint(env, argv[0], &size) || size > (1u << 24)) {
+    return enif_make_badarg(env);
+  }
 
-bad_arg:
-  enif_free(pubkeys);
-  enif_free(pubkeys_ptrs);
-  return enif_make_badarg(env);
+  if (size > 0) {
+    entries = enif_alloc(size * sizeof(keyagg_memo_entry));
+    if (!entries) {
+      return error_result(env, "enif_alloc failed");
+    }
+    memset(entries, 0, size * sizeof(keyagg_memo_entry));
+  }
+
+  enif_mutex_lock(keyagg_memo.lock);
+  old = keyagg_memo.entries;
+  old_size = keyagg_memo.size;
+  keyagg_memo.entries = entries;
+  keyagg_memo.size = size;
+  enif_mutex_unlock(keyagg_memo.lock);
+
+  if (old) {
+    free_memo_entries(old, old_size);
+  }
+
+  return enif_make_atom(env, "ok");
+}
+
+static ERL_NIF_TERM
+keyagg_memo_info(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM map = enif_make_new_map(env);
+  unsigned int size, entries = 0, i;
+
+  enif_mutex_lock(keyagg_memo.lock);
+  size = keyagg_memo.size;
+  for (i = 0; i < size; i++) {
+    entries += keyagg_memo.entries[i].cache != NULL;
+  }
+  enif_mutex_unlock(keyagg_memo.lock);
+
+  enif_make_map_put(env, map, enif_make_atom(env, "size"), enif_make_uint(env, size), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "entries"), enif_make_uint(env, entries), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "hits"),
+    enif_make_uint64(env, __atomic_load_n(&keyagg_memo.hits, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "misses"),
+    enif_make_uint64(env, __atomic_load_n(&keyagg_memo.misses, __ATOMIC_RELAXED)), &map);
+
+  return map;
 }
 
 static ERL_NIF_TERM
 pubkey_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
-  ErlNifBinary bin_cache;
-  secp256k1_musig_keyagg_cache cache;
+  const secp256k1_musig_keyagg_cache *cache;
   secp256k1_pubkey agg_pk;
   unsigned char serialized_pk[33];
   size_t len = sizeof(serialized_pk);
   ErlNifBinary bin_pk;
 
-  if (!enif_inspect_binary(env, argv[0], &bin_cache) || bin_cache.size != sizeof(cache)) {
+  if (!(cache = get_cache(env, argv[0]))) {
     return enif_make_badarg(env);
   }
-  memcpy(&cache, bin_cache.data, sizeof(cache));
 
-  if (!secp256k1_musig_pubkey_get(ctx, &agg_pk, &cache)) {
+  if (!secp256k1_musig_pubkey_get(ctx, &agg_pk, cache)) {
     return error_result(env, "secp256k1_musig_pubkey_get failed");
   }
 
@@ -140,98 +595,114 @@ pubkey_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   return enif_make_binary(env, &bin_pk);
 }
 
+/* Tweaks copy of the cache, the original cache stays valid for sessions
+ * already using it. Returns `{:ok, new_cache, tweaked_pubkey}`. */
 static ERL_NIF_TERM
-pubkey_ec_tweak_add(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+pubkey_tweak_add(ErlNifEnv *env, const ERL_NIF_TERM argv[], int xonly)
 {
-  ErlNifBinary bin_cache, bin_tweak;
-  secp256k1_musig_keyagg_cache cache;
+  const secp256k1_musig_keyagg_cache *cache;
+  keyagg_cache_wrapper *tweaked;
+  ErlNifBinary bin_tweak, bin_pk;
   secp256k1_pubkey output_pk;
   unsigned char serialized_pk[33];
   size_t len = sizeof(serialized_pk);
-  ErlNifBinary bin_new_cache, bin_pk;
+  int ok;
 
-  if (!enif_inspect_binary(env, argv[0], &bin_cache) || bin_cache.size != sizeof(cache) ||
+  if (!(cache = get_cache(env, argv[0])) ||
       !enif_inspect_binary(env, argv[1], &bin_tweak) || bin_tweak.size != 32) {
     return enif_make_badarg(env);
   }
-  memcpy(&cache, bin_cache.data, sizeof(cache));
 
-  if (!secp256k1_musig_pubkey_ec_tweak_add(ctx, &output_pk, &cache, bin_tweak.data)) {
-    return error_result(env, "secp256k1_musig_pubkey_ec_tweak_add failed");
+  if (!(tweaked = new_cache())) {
+    return error_result(env, "enif_alloc_resource failed");
+  }
+  memcpy(&tweaked->cache, cache, sizeof(*cache));
+
+  ok = xonly ? secp256k1_musig_pubkey_xonly_tweak_add(ctx, &output_pk, &tweaked->cache, bin_tweak.data)
+             : secp256k1_musig_pubkey_ec_tweak_add(ctx, &output_pk, &tweaked->cache, bin_tweak.data);
+  if (!ok) {
+    enif_release_resource(tweaked);
+    return error_result(env, xonly ? "secp256k1_musig_pubkey_xonly_tweak_add failed" : "secp256k1_musig_pubkey_ec_tweak_add failed");
   }
 
   if (!secp256k1_ec_pubkey_serialize(ctx, serialized_pk, &len, &output_pk, SECP256K1_EC_COMPRESSED)) {
+    enif_release_resource(tweaked);
     return error_result(env, "secp256k1_ec_pubkey_serialize failed");
   }
 
-  enif_alloc_binary(sizeof(cache), &bin_new_cache);
-  memcpy(bin_new_cache.data, &cache, sizeof(cache));
-
   enif_alloc_binary(len, &bin_pk);
   memcpy(bin_pk.data, serialized_pk, len);
 
   return enif_make_tuple3(env,
     enif_make_atom(env, "ok"),
-    enif_make_binary(env, &bin_new_cache),
+    make_resource_term(env, tweaked),
     enif_make_binary(env, &bin_pk)
   );
 }
 
 static ERL_NIF_TERM
-pubkey_xonly_tweak_add(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+pubkey_ec_tweak_add(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
-  ErlNifBinary bin_cache, bin_tweak;
-  secp256k1_musig_keyagg_cache cache;
-  secp256k1_pubkey output_pk;
-  unsigned char serialized_pk[33];
-  size_t len = sizeof(serialized_pk);
-  ErlNifBinary bin_new_cache, bin_pk;
+  return pubkey_tweak_add(env, argv, 0);
+}
 
-  if (!enif_inspect_binary(env, argv[0], &bin_cache) || bin_cache.size != sizeof(cache) ||
-      !enif_inspect_binary(env, argv[1], &bin_tweak) || bin_tweak.size != 32) {
-    return enif_make_badarg(env);
-  }
-  memcpy(&cache, bin_cache.data, sizeof(cache));
+static ERL_NIF_TERM
+pubkey_xonly_tweak_add(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  return pubkey_tweak_add(env, argv, 1);
+}
 
-  if (!secp256k1_musig_pubkey_xonly_tweak_add(ctx, &output_pk, &cache, bin_tweak.data)) {
-    return error_result(env, "secp256k1_musig_pubkey_xonly_tweak_add failed");
-  }
+/* Moves secnonce into a new resource (erasing the given copy) and returns
+ * `{:ok, secnonce, pubnonce}` */
+static ERL_NIF_TERM
+make_nonce_result(ErlNifEnv *env, secp256k1_musig_secnonce *secnonce, const secp256k1_musig_pubnonce *pubnonce)
+{
+  ErlNifBinary bin_pubnonce;
+  secnonce_wrapper *wrapper;
+  ERL_NIF_TERM resource_term;
 
-  if (!secp256k1_ec_pubkey_serialize(ctx, serialized_pk, &len, &output_pk, SECP256K1_EC_COMPRESSED)) {
-    return error_result(env, "secp256k1_ec_pubkey_serialize failed");
+  // Allocate resource
+  wrapper = enif_alloc_resource(secnonce_resource_type, sizeof(secnonce_wrapper));
+  if (!wrapper) {
+    secure_erase(secnonce, sizeof(*secnonce));
+    return error_result(env, "enif_alloc_resource failed");
   }
+  memcpy(&wrapper->nonce, secnonce, sizeof(*secnonce));
+  wrapper->used = 0;
+  __atomic_fetch_add(&secnonces_live, 1, __ATOMIC_RELAXED);
+  secure_erase(secnonce, sizeof(*secnonce)); // Clear the copy
 
-  enif_alloc_binary(sizeof(cache), &bin_new_cache);
-  memcpy(bin_new_cache.data, &cache, sizeof(cache));
+  resource_term = enif_make_resource(env, wrapper);
+  enif_release_resource(wrapper);
 
-  enif_alloc_binary(len, &bin_pk);
-  memcpy(bin_pk.data, serialized_pk, len);
+  enif_alloc_binary(sizeof(*pubnonce), &bin_pubnonce);
+  if (!secp256k1_musig_pubnonce_serialize(ctx, bin_pubnonce.data, pubnonce)) {
+     return error_result(env, "secp256k1_musig_pubnonce_serialize failed");
+  }
 
   return enif_make_tuple3(env,
     enif_make_atom(env, "ok"),
-    enif_make_binary(env, &bin_new_cache),
-    enif_make_binary(env, &bin_pk)
+    resource_term,
+    enif_make_binary(env, &bin_pubnonce)
   );
 }
 
 static ERL_NIF_TERM
 nonce_gen(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
-  ErlNifBinary bin_seckey, bin_pubkey, bin_msg, bin_cache, bin_extra;
+  ErlNifBinary bin_seckey, bin_pubkey, bin_msg, bin_extra;
   secp256k1_musig_secnonce secnonce;
   secp256k1_musig_pubnonce pubnonce;
   unsigned char session_secrand[32];
-  ErlNifBinary bin_pubnonce;
-  secnonce_wrapper *wrapper;
-  ERL_NIF_TERM resource_term;
 
   const unsigned char *seckey = NULL;
   secp256k1_pubkey pubkey_struct;
   const secp256k1_pubkey *pubkey = NULL;
   const unsigned char *msg = NULL;
-  secp256k1_musig_keyagg_cache cache_struct;
   const secp256k1_musig_keyagg_cache *cache = NULL;
   const unsigned char *extra = NULL;
+  ErlNifTime start;
+  int ok;
 
   // Optional arguments
   if (enif_inspect_binary(env, argv[0], &bin_seckey)) {
@@ -248,10 +719,8 @@ nonce_gen(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     if (bin_msg.size != 32) return enif_make_badarg(env);
     msg = bin_msg.data;
   }
-  if (enif_inspect_binary(env, argv[3], &bin_cache)) {
-    if (bin_cache.size != sizeof(cache_struct)) return enif_make_badarg(env);
-    memcpy(&cache_struct, bin_cache.data, sizeof(cache_struct));
-    cache = &cache_struct;
+  if (!enif_is_identical(argv[3], enif_make_atom(env, "nil"))) {
+    if (!(cache = get_cache(env, argv[3]))) return enif_make_badarg(env);
   }
   if (enif_inspect_binary(env, argv[4], &bin_extra)) {
     if (bin_extra.size != 32) return enif_make_badarg(env);
@@ -263,35 +732,294 @@ nonce_gen(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     return error_result(env, "RNG failed");
   }
 
-  if (!secp256k1_musig_nonce_gen(ctx, &secnonce, &pubnonce, session_secrand, seckey, pubkey, msg, cache, extra)) {
+  start = stats_start();
+  ok = secp256k1_musig_nonce_gen(signing_ctx(), &secnonce, &pubnonce, session_secrand, seckey, pubkey, msg, cache, extra);
+  stats_record(STATS_MUSIG_NONCE_GEN, start, ok);
+  if (!ok) {
     secure_erase(session_secrand, sizeof(session_secrand));
     return error_result(env, "secp256k1_musig_nonce_gen failed");
   }
   secure_erase(session_secrand, sizeof(session_secrand));
 
-  // Allocate resource
-  wrapper = enif_alloc_resource(secnonce_resource_type, sizeof(secnonce_wrapper));
-  if (!wrapper) {
+  return make_nonce_result(env, &secnonce, &pubnonce);
+}
+
+/* Generates one pair of the pool's signer, message, keyagg cache and extra
+ * input are not known in advance so the nonce relies on fresh randomness only */
+static int
+nonce_pool_gen(const secp256k1_context *gen_ctx, const nonce_pool *pool,
+               secp256k1_musig_secnonce *secnonce, secp256k1_musig_pubnonce *pubnonce)
+{
+  unsigned char session_secrand[32];
+  int ok;
+
+  ok = fill_random(session_secrand, sizeof(session_secrand)) &&
+       secp256k1_musig_nonce_gen(gen_ctx, secnonce, pubnonce, session_secrand,
+         pool->has_seckey ? pool->seckey : NULL, &pool->pubkey, NULL, NULL, NULL);
+  secure_erase(session_secrand, sizeof(session_secrand));
+
+  return ok;
+}
+
+// Sleeps in short slices so that destroying the pool doesn't wait for long
+static int
+nonce_pool_pause(nonce_pool *pool, unsigned long pause_us)
+{
+  unsigned long slice;
+  int stop;
+
+  while (pause_us > 0) {
+    slice = pause_us < NONCE_POOL_PAUSE_SLICE_US ? pause_us : NONCE_POOL_PAUSE_SLICE_US;
+    sleep_us(slice);
+    pause_us -= slice;
+
+    enif_mutex_lock(pool->lock);
+    stop = pool->stop;
+    enif_mutex_unlock(pool->lock);
+    if (stop) return 0;
+  }
+
+  return 1;
+}
+
+static void *
+nonce_pool_refill(void *arg)
+{
+  nonce_pool *pool = (nonce_pool *)arg;
+  secp256k1_musig_secnonce secnonce;
+  secp256k1_musig_pubnonce pubnonce;
+  unsigned int rate, slot;
+  int ok;
+
+  for (;;) {
+    enif_mutex_lock(pool->lock);
+    while (!pool->stop && pool->count >= pool->depth) {
+      enif_cond_wait(pool->cond, pool->lock);
+    }
+    if (pool->stop) {
+      enif_mutex_unlock(pool->lock);
+      break;
+    }
+    enif_mutex_unlock(pool->lock);
+
+    // pairs are generated outside of the lock, takers are never blocked by it
+    ok = nonce_pool_gen(pool->ctx, pool, &secnonce, &pubnonce);
+
+    enif_mutex_lock(pool->lock);
+    if (ok && pool->count < pool->depth) {
+      slot = (pool->head + pool->count) % pool->depth;
+      memcpy(&pool->secnonces[slot], &secnonce, sizeof(secnonce));
+      memcpy(&pool->pubnonces[slot], &pubnonce, sizeof(pubnonce));
+      pool->count++;
+      __atomic_add_fetch(&pool->generated, 1, __ATOMIC_RELAXED);
+    }
+    enif_mutex_unlock(pool->lock);
     secure_erase(&secnonce, sizeof(secnonce));
+
+    rate = __atomic_load_n(&pool->rate, __ATOMIC_RELAXED);
+    if (!nonce_pool_pause(pool, rate ? 1000000 / rate : 0)) {
+      break;
+    }
+  }
+
+  return NULL;
+}
+
+/* Allocates ring of `depth` pairs, returns 0 when out of memory and leaves
+ * the output pointers untouched */
+static int
+alloc_nonce_ring(unsigned int depth, secp256k1_musig_secnonce **secnonces,
+                 secp256k1_musig_pubnonce **pubnonces)
+{
+  secp256k1_musig_secnonce *new_secnonces;
+  secp256k1_musig_pubnonce *new_pubnonces;
+
+  new_secnonces = enif_alloc(depth * sizeof(secp256k1_musig_secnonce));
+  new_pubnonces = enif_alloc(depth * sizeof(secp256k1_musig_pubnonce));
+  if (!new_secnonces || !new_pubnonces) {
+    free_nonce_ring(new_secnonces, new_pubnonces, depth);
+    return 0;
+  }
+
+  *secnonces = new_secnonces;
+  *pubnonces = new_pubnonces;
+  return 1;
+}
+
+/* Starts pool of the signer, argv is `seckey | nil, pubkey, depth, rate` */
+static ERL_NIF_TERM
+nonce_pool_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary bin_seckey, bin_pubkey;
+  secp256k1_pubkey pubkey;
+  unsigned int depth, rate;
+  nonce_pool *pool;
+  ERL_NIF_TERM result;
+  int has_seckey;
+
+  has_seckey = !enif_is_identical(argv[0], enif_make_atom(env, "nil"));
+  if (has_seckey && (!enif_inspect_binary(env, argv[0], &bin_seckey) || bin_seckey.size != 32 ||
+                     !secp256k1_ec_seckey_verify(ctx, bin_seckey.data))) {
+    return enif_make_badarg(env);
+  }
+  if (!enif_inspect_binary(env, argv[1], &bin_pubkey) ||
+      !secp256k1_ec_pubkey_parse(ctx, &pubkey, bin_pubkey.data, bin_pubkey.size) ||
+      !enif_get_uint(env, argv[2], &depth) || depth == 0 || depth > NONCE_POOL_MAX_DEPTH ||
+      !enif_get_uint(env, argv[3], &rate)) {
+    return enif_make_badarg(env);
+  }
+
+  pool = enif_alloc_resource(nonce_pool_resource_type, sizeof(nonce_pool));
+  if (!pool) {
     return error_result(env, "enif_alloc_resource failed");
   }
-  memcpy(&wrapper->nonce, &secnonce, sizeof(secnonce));
-  wrapper->used = 0;
-  secure_erase(&secnonce, sizeof(secnonce)); // Clear stack copy
+  memset(pool, 0, sizeof(nonce_pool));
 
-  resource_term = enif_make_resource(env, wrapper);
-  enif_release_resource(wrapper);
+  if (has_seckey) {
+    memcpy(pool->seckey, bin_seckey.data, 32);
+    pool->has_seckey = 1;
+  }
+  memcpy(&pool->pubkey, &pubkey, sizeof(pubkey));
+  pool->rate = rate;
+
+  pool->lock = enif_mutex_create("secp256k1_nonce_pool");
+  pool->cond = enif_cond_create("secp256k1_nonce_pool");
+  pool->ctx = randomized_clone();
+  if (!pool->lock || !pool->cond || !pool->ctx ||
+      !alloc_nonce_ring(depth, &pool->secnonces, &pool->pubnonces)) {
+    enif_release_resource(pool);
+    return error_result(env, "nonce pool setup failed");
+  }
+  pool->depth = depth;
 
-  enif_alloc_binary(sizeof(pubnonce), &bin_pubnonce);
-  if (!secp256k1_musig_pubnonce_serialize(ctx, bin_pubnonce.data, &pubnonce)) {
-     return error_result(env, "secp256k1_musig_pubnonce_serialize failed");
+  // destructor joins the thread, it never outlives the pool
+  if (enif_thread_create("secp256k1_nonce_pool", &pool->tid, nonce_pool_refill, pool, NULL) != 0) {
+    enif_release_resource(pool);
+    return error_result(env, "enif_thread_create failed");
   }
+  pool->started = 1;
 
-  return enif_make_tuple3(env,
-    enif_make_atom(env, "ok"),
-    resource_term,
-    enif_make_binary(env, &bin_pubnonce)
-  );
+  result = enif_make_resource(env, pool);
+  enif_release_resource(pool);
+  return result;
+}
+
+/* Hands out the oldest pair of the pool, an empty pool generates the pair on
+ * the spot (counted as a miss) */
+static ERL_NIF_TERM
+nonce_pool_take(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  nonce_pool *pool;
+  secp256k1_musig_secnonce secnonce;
+  secp256k1_musig_pubnonce pubnonce;
+  ErlNifTime start;
+  int taken = 0, ok;
+
+  if (!enif_get_resource(env, argv[0], nonce_pool_resource_type, (void **)&pool)) {
+    return enif_make_badarg(env);
+  }
+
+  enif_mutex_lock(pool->lock);
+  if (pool->count > 0) {
+    memcpy(&secnonce, &pool->secnonces[pool->head], sizeof(secnonce));
+    memcpy(&pubnonce, &pool->pubnonces[pool->head], sizeof(pubnonce));
+    secure_erase(&pool->secnonces[pool->head], sizeof(secnonce));
+    pool->head = (pool->head + 1) % pool->depth;
+    pool->count--;
+    taken = 1;
+    enif_cond_signal(pool->cond);
+  }
+  enif_mutex_unlock(pool->lock);
+
+  if (taken) {
+    __atomic_add_fetch(&pool->taken, 1, __ATOMIC_RELAXED);
+    return make_nonce_result(env, &secnonce, &pubnonce);
+  }
+
+  __atomic_add_fetch(&pool->misses, 1, __ATOMIC_RELAXED);
+  start = stats_start();
+  ok = nonce_pool_gen(signing_ctx(), pool, &secnonce, &pubnonce);
+  stats_record(STATS_MUSIG_NONCE_GEN, start, ok);
+  if (!ok) {
+    secure_erase(&secnonce, sizeof(secnonce));
+    return error_result(env, "secp256k1_musig_nonce_gen failed");
+  }
+
+  return make_nonce_result(env, &secnonce, &pubnonce);
+}
+
+/* Changes depth and rate of the pool, pairs which don't fit the new depth are
+ * erased */
+static ERL_NIF_TERM
+nonce_pool_configure(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  nonce_pool *pool;
+  secp256k1_musig_secnonce *secnonces, *old_secnonces;
+  secp256k1_musig_pubnonce *pubnonces, *old_pubnonces;
+  unsigned int depth, rate, old_depth, i, slot;
+
+  if (!enif_get_resource(env, argv[0], nonce_pool_resource_type, (void **)&pool) ||
+      !enif_get_uint(env, argv[1], &depth) || depth == 0 || depth > NONCE_POOL_MAX_DEPTH ||
+      !enif_get_uint(env, argv[2], &rate)) {
+    return enif_make_badarg(env);
+  }
+
+  if (!alloc_nonce_ring(depth, &secnonces, &pubnonces)) {
+    return error_result(env, "enif_alloc failed");
+  }
+
+  enif_mutex_lock(pool->lock);
+  if (pool->count > depth) {
+    pool->count = depth;
+  }
+  for (i = 0; i < pool->count; i++) {
+    slot = (pool->head + i) % pool->depth;
+    memcpy(&secnonces[i], &pool->secnonces[slot], sizeof(secp256k1_musig_secnonce));
+    memcpy(&pubnonces[i], &pool->pubnonces[slot], sizeof(secp256k1_musig_pubnonce));
+  }
+  old_secnonces = pool->secnonces;
+  old_pubnonces = pool->pubnonces;
+  old_depth = pool->depth;
+  pool->secnonces = secnonces;
+  pool->pubnonces = pubnonces;
+  pool->depth = depth;
+  pool->head = 0;
+  __atomic_store_n(&pool->rate, rate, __ATOMIC_RELAXED);
+  enif_cond_signal(pool->cond);
+  enif_mutex_unlock(pool->lock);
+
+  free_nonce_ring(old_secnonces, old_pubnonces, old_depth);
+  return enif_make_atom(env, "ok");
+}
+
+static ERL_NIF_TERM
+nonce_pool_info(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM map = enif_make_new_map(env);
+  nonce_pool *pool;
+  unsigned int depth, count;
+
+  if (!enif_get_resource(env, argv[0], nonce_pool_resource_type, (void **)&pool)) {
+    return enif_make_badarg(env);
+  }
+
+  enif_mutex_lock(pool->lock);
+  depth = pool->depth;
+  count = pool->count;
+  enif_mutex_unlock(pool->lock);
+
+  enif_make_map_put(env, map, enif_make_atom(env, "depth"), enif_make_uint(env, depth), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "available"), enif_make_uint(env, count), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "rate"),
+    enif_make_uint(env, __atomic_load_n(&pool->rate, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "generated"),
+    enif_make_uint64(env, __atomic_load_n(&pool->generated, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "taken"),
+    enif_make_uint64(env, __atomic_load_n(&pool->taken, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "misses"),
+    enif_make_uint64(env, __atomic_load_n(&pool->misses, __ATOMIC_RELAXED)), &map);
+
+  return map;
 }
 
 static ERL_NIF_TERM
@@ -304,11 +1032,19 @@ nonce_agg(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   secp256k1_musig_aggnonce aggnonce;
   ErlNifBinary bin_aggnonce;
   unsigned int i;
+  ErlNifTime start;
+  size_t cost;
+  int ok;
 
   if (!enif_get_list_length(env, list, &n_nonces) || n_nonces == 0) {
     return enif_make_badarg(env);
   }
 
+  cost = (size_t)n_nonces * NONCE_AGG_COST_US;
+  if (needs_dirty_scheduler(cost)) {
+    return enif_schedule_nif(env, "nonce_agg", ERL_NIF_DIRTY_JOB_CPU_BOUND, nonce_agg, argc, argv);
+  }
+
   nonces = enif_alloc(n_nonces * sizeof(secp256k1_musig_pubnonce));
   nonces_ptrs = enif_alloc(n_nonces * sizeof(secp256k1_musig_pubnonce *));
   if (!nonces || !nonces_ptrs) {
@@ -328,7 +1064,10 @@ nonce_agg(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     list = tail;
   }
 
-  if (!secp256k1_musig_nonce_agg(ctx, &aggnonce, nonces_ptrs, n_nonces)) {
+  start = stats_start();
+  ok = secp256k1_musig_nonce_agg(ctx, &aggnonce, nonces_ptrs, n_nonces);
+  stats_record(STATS_MUSIG_AGG, start, ok);
+  if (!ok) {
     enif_free(nonces);
     enif_free(nonces_ptrs);
     return error_result(env, "secp256k1_musig_nonce_agg failed");
@@ -342,6 +1081,7 @@ nonce_agg(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     return error_result(env, "secp256k1_musig_aggnonce_serialize failed");
   }
 
+  consume_timeslice(env, cost);
   return enif_make_binary(env, &bin_aggnonce);
 
 bad_arg:
@@ -353,11 +1093,10 @@ bad_arg:
 static ERL_NIF_TERM
 nonce_process(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
-  ErlNifBinary bin_aggnonce, bin_msg, bin_cache;
+  ErlNifBinary bin_aggnonce, bin_msg;
   secp256k1_musig_aggnonce aggnonce;
-  secp256k1_musig_keyagg_cache cache;
-  secp256k1_musig_session session;
-  ErlNifBinary bin_session;
+  const secp256k1_musig_keyagg_cache *cache;
+  session_wrapper *session;
 
   if (!enif_inspect_binary(env, argv[0], &bin_aggnonce) ||
       !secp256k1_musig_aggnonce_parse(ctx, &aggnonce, bin_aggnonce.data)) {
@@ -366,31 +1105,35 @@ nonce_process(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   if (!enif_inspect_binary(env, argv[1], &bin_msg) || bin_msg.size != 32) {
     return enif_make_badarg(env);
   }
-  if (!enif_inspect_binary(env, argv[2], &bin_cache) || bin_cache.size != sizeof(cache)) {
+  if (!(cache = get_cache(env, argv[2]))) {
     return enif_make_badarg(env);
   }
-  memcpy(&cache, bin_cache.data, sizeof(cache));
 
-  if (!secp256k1_musig_nonce_process(ctx, &session, &aggnonce, bin_msg.data, &cache)) {
-    return error_result(env, "secp256k1_musig_nonce_process failed");
+  session = enif_alloc_resource(session_resource_type, sizeof(session_wrapper));
+  if (!session) {
+    return error_result(env, "enif_alloc_resource failed");
   }
 
-  enif_alloc_binary(sizeof(session), &bin_session);
-  memcpy(bin_session.data, &session, sizeof(session));
+  if (!secp256k1_musig_nonce_process(ctx, &session->session, &aggnonce, bin_msg.data, cache)) {
+    enif_release_resource(session);
+    return error_result(env, "secp256k1_musig_nonce_process failed");
+  }
 
-  return enif_make_binary(env, &bin_session);
+  return make_resource_term(env, session);
 }
 
 static ERL_NIF_TERM
 partial_sign(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
   secnonce_wrapper *wrapper;
-  ErlNifBinary bin_seckey, bin_cache, bin_session;
+  ErlNifBinary bin_seckey;
   secp256k1_keypair keypair;
-  secp256k1_musig_keyagg_cache cache;
-  secp256k1_musig_session session;
+  const secp256k1_musig_keyagg_cache *cache;
+  const secp256k1_musig_session *session;
   secp256k1_musig_partial_sig partial_sig;
   ErlNifBinary bin_partial_sig;
+  ErlNifTime start;
+  int ok;
 
   if (!enif_get_resource(env, argv[0], secnonce_resource_type, (void **)&wrapper)) {
     return enif_make_badarg(env);
@@ -401,21 +1144,19 @@ partial_sign(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 
   if (!enif_inspect_binary(env, argv[1], &bin_seckey) ||
       bin_seckey.size != 32 ||
-      !secp256k1_keypair_create(ctx, &keypair, bin_seckey.data)) {
+      !secp256k1_keypair_create(signing_ctx(), &keypair, bin_seckey.data)) {
     return enif_make_badarg(env);
   }
 
-  if (!enif_inspect_binary(env, argv[2], &bin_cache) || bin_cache.size != sizeof(cache)) {
-    return enif_make_badarg(env);
-  }
-  memcpy(&cache, bin_cache.data, sizeof(cache));
-
-  if (!enif_inspect_binary(env, argv[3], &bin_session) || bin_session.size != sizeof(session)) {
+  if (!(cache = get_cache(env, argv[2])) || !(session = get_session(env, argv[3]))) {
+    secure_erase(&keypair, sizeof(keypair));
     return enif_make_badarg(env);
   }
-  memcpy(&session, bin_session.data, sizeof(session));
 
-  if (!secp256k1_musig_partial_sign(ctx, &partial_sig, &wrapper->nonce, &keypair, &cache, &session)) {
+  start = stats_start();
+  ok = secp256k1_musig_partial_sign(ctx, &partial_sig, &wrapper->nonce, &keypair, cache, session);
+  stats_record(STATS_MUSIG_PARTIAL_SIGN, start, ok);
+  if (!ok) {
     secure_erase(&keypair, sizeof(keypair));
     return error_result(env, "secp256k1_musig_partial_sign failed");
   }
@@ -435,12 +1176,14 @@ partial_sign(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 static ERL_NIF_TERM
 partial_sig_verify(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
-  ErlNifBinary bin_psig, bin_pubnonce, bin_pubkey, bin_cache, bin_session;
+  ErlNifBinary bin_psig, bin_pubnonce, bin_pubkey;
   secp256k1_musig_partial_sig partial_sig;
   secp256k1_musig_pubnonce pubnonce;
   secp256k1_pubkey pubkey;
-  secp256k1_musig_keyagg_cache cache;
-  secp256k1_musig_session session;
+  const secp256k1_musig_keyagg_cache *cache;
+  const secp256k1_musig_session *session;
+  ErlNifTime start;
+  int valid;
 
   if (!enif_inspect_binary(env, argv[0], &bin_psig) ||
       !secp256k1_musig_partial_sig_parse(ctx, &partial_sig, bin_psig.data)) {
@@ -454,44 +1197,45 @@ partial_sig_verify(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
       !secp256k1_ec_pubkey_parse(ctx, &pubkey, bin_pubkey.data, bin_pubkey.size)) {
     return enif_make_badarg(env);
   }
-  if (!enif_inspect_binary(env, argv[3], &bin_cache) || bin_cache.size != sizeof(cache)) {
-    return enif_make_badarg(env);
-  }
-  memcpy(&cache, bin_cache.data, sizeof(cache));
-  if (!enif_inspect_binary(env, argv[4], &bin_session) || bin_session.size != sizeof(session)) {
+  if (!(cache = get_cache(env, argv[3])) || !(session = get_session(env, argv[4]))) {
     return enif_make_badarg(env);
   }
-  memcpy(&session, bin_session.data, sizeof(session));
 
-  if (secp256k1_musig_partial_sig_verify(ctx, &partial_sig, &pubnonce, &pubkey, &cache, &session)) {
-    return enif_make_atom(env, "true");
-  }
+  start = stats_start();
+  valid = secp256k1_musig_partial_sig_verify(ctx, &partial_sig, &pubnonce, &pubkey, cache, session);
+  stats_record(STATS_MUSIG_PARTIAL_VERIFY, start, valid);
 
-  return enif_make_atom(env, "false");
+  return enif_make_atom(env, valid ? "true" : "false");
 }
 
 static ERL_NIF_TERM
 partial_sig_agg(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
   ERL_NIF_TERM head, tail, list = argv[1];
-  ErlNifBinary bin_session;
-  secp256k1_musig_session session;
+  const secp256k1_musig_session *session;
   unsigned int n_sigs;
   secp256k1_musig_partial_sig *sigs;
   const secp256k1_musig_partial_sig **sigs_ptrs;
   unsigned char sig64[64];
   ErlNifBinary bin_sig64;
   unsigned int i;
+  ErlNifTime start;
+  size_t cost;
+  int ok;
 
-  if (!enif_inspect_binary(env, argv[0], &bin_session) || bin_session.size != sizeof(session)) {
+  if (!(session = get_session(env, argv[0]))) {
     return enif_make_badarg(env);
   }
-  memcpy(&session, bin_session.data, sizeof(session));
 
   if (!enif_get_list_length(env, list, &n_sigs) || n_sigs == 0) {
     return enif_make_badarg(env);
   }
 
+  cost = (size_t)n_sigs * PARTIAL_SIG_AGG_COST_US;
+  if (needs_dirty_scheduler(cost)) {
+    return enif_schedule_nif(env, "partial_sig_agg", ERL_NIF_DIRTY_JOB_CPU_BOUND, partial_sig_agg, argc, argv);
+  }
+
   sigs = enif_alloc(n_sigs * sizeof(secp256k1_musig_partial_sig));
   sigs_ptrs = enif_alloc(n_sigs * sizeof(secp256k1_musig_partial_sig *));
   if (!sigs || !sigs_ptrs) {
@@ -511,7 +1255,10 @@ partial_sig_agg(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     list = tail;
   }
 
-  if (!secp256k1_musig_partial_sig_agg(ctx, sig64, &session, sigs_ptrs, n_sigs)) {
+  start = stats_start();
+  ok = secp256k1_musig_partial_sig_agg(ctx, sig64, session, sigs_ptrs, n_sigs);
+  stats_record(STATS_MUSIG_AGG, start, ok);
+  if (!ok) {
     enif_free(sigs);
     enif_free(sigs_ptrs);
     return error_result(env, "secp256k1_musig_partial_sig_agg failed");
@@ -523,6 +1270,7 @@ partial_sig_agg(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   enif_alloc_binary(sizeof(sig64), &bin_sig64);
   memcpy(bin_sig64.data, sig64, sizeof(sig64));
 
+  consume_timeslice(env, cost);
   return enif_make_binary(env, &bin_sig64);
 
 bad_arg:
@@ -531,18 +1279,182 @@ bad_arg:
   return enif_make_badarg(env);
 }
 
+/* Parses and verifies one signer's entry, returns 0 when any part doesn't
+ * parse or the partial signature is invalid */
+static int
+verify_partial_entry(const unsigned char *psig32, const unsigned char *pubnonce66, const unsigned char *pubkey, size_t pubkey_len, const secp256k1_musig_keyagg_cache *cache, const secp256k1_musig_session *session, secp256k1_musig_partial_sig *partial_sig)
+{
+  secp256k1_musig_pubnonce pubnonce;
+  secp256k1_pubkey parsed_pubkey;
+
+  return secp256k1_musig_partial_sig_parse(ctx, partial_sig, psig32) &&
+         secp256k1_musig_pubnonce_parse(ctx, &pubnonce, pubnonce66) &&
+         secp256k1_ec_pubkey_parse(ctx, &parsed_pubkey, pubkey, pubkey_len) &&
+         secp256k1_musig_partial_sig_verify(ctx, partial_sig, &pubnonce, &parsed_pubkey, cache, session);
+}
+
+/* Verifies partial signatures of all signers given as list of
+ * `{partial_sig, pubnonce, pubkey}` or packed binary of the entries. Returns
+ * `{:error, indices}` of the misbehaving signers, otherwise `:ok` or
+ * `{:ok, signature}` when aggregation was requested. */
+static ERL_NIF_TERM
+verify_partial_sigs(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, invalid, result, list = argv[2];
+  const ERL_NIF_TERM *tuple;
+  const secp256k1_musig_session *session;
+  const secp256k1_musig_keyagg_cache *cache;
+  secp256k1_musig_partial_sig *sigs;
+  const secp256k1_musig_partial_sig **sigs_ptrs;
+  ErlNifBinary packed, bin_psig, bin_pubnonce, bin_pubkey;
+  const unsigned char *entry;
+  unsigned char *sig64;
+  unsigned int n_sigs, i;
+  ErlNifTime start;
+  int arity, is_packed, ok;
+
+  if (!(session = get_session(env, argv[0])) || !(cache = get_cache(env, argv[1]))) {
+    return enif_make_badarg(env);
+  }
+
+  is_packed = enif_inspect_binary(env, argv[2], &packed);
+  if (is_packed) {
+    if (packed.size % PACKED_ENTRY_SIZE != 0) {
+      return enif_make_badarg(env);
+    }
+    n_sigs = packed.size / PACKED_ENTRY_SIZE;
+  } else if (!enif_get_list_length(env, list, &n_sigs)) {
+    return enif_make_badarg(env);
+  }
+  if (n_sigs == 0) {
+    return enif_make_badarg(env);
+  }
+
+  sigs = enif_alloc(n_sigs * sizeof(secp256k1_musig_partial_sig));
+  sigs_ptrs = enif_alloc(n_sigs * sizeof(secp256k1_musig_partial_sig *));
+  if (!sigs || !sigs_ptrs) {
+    if (sigs) enif_free(sigs);
+    if (sigs_ptrs) enif_free(sigs_ptrs);
+    return error_result(env, "enif_alloc failed");
+  }
+
+  invalid = enif_make_list(env, 0);
+  start = stats_start();
+
+  for (i = 0; i < n_sigs; i++) {
+    if (is_packed) {
+      entry = packed.data + (size_t)i * PACKED_ENTRY_SIZE;
+      ok = verify_partial_entry(entry, entry + 32, entry + 32 + 66, 33, cache, session, &sigs[i]);
+    } else {
+      if (!enif_get_list_cell(env, list, &head, &tail) ||
+          !enif_get_tuple(env, head, &arity, &tuple) || arity != 3 ||
+          !enif_inspect_binary(env, tuple[0], &bin_psig) || bin_psig.size != 32 ||
+          !enif_inspect_binary(env, tuple[1], &bin_pubnonce) || bin_pubnonce.size != 66 ||
+          !enif_inspect_binary(env, tuple[2], &bin_pubkey)) {
+        goto bad_arg;
+      }
+      ok = verify_partial_entry(bin_psig.data, bin_pubnonce.data, bin_pubkey.data, bin_pubkey.size, cache, session, &sigs[i]);
+      list = tail;
+    }
+
+    if (!ok) {
+      invalid = enif_make_list_cell(env, enif_make_uint(env, i), invalid);
+    }
+    sigs_ptrs[i] = &sigs[i];
+  }
+
+  stats_record(STATS_MUSIG_PARTIAL_VERIFY, start, enif_is_empty_list(env, invalid));
+
+  if (!enif_is_empty_list(env, invalid)) {
+    enif_free(sigs);
+    enif_free(sigs_ptrs);
+    enif_make_reverse_list(env, invalid, &result);
+    return enif_make_tuple2(env, enif_make_atom(env, "error"), result);
+  }
+
+  if (!enif_is_identical(argv[3], enif_make_atom(env, "true"))) {
+    enif_free(sigs);
+    enif_free(sigs_ptrs);
+    return enif_make_atom(env, "ok");
+  }
+
+  sig64 = enif_make_new_binary(env, 64, &result);
+  start = stats_start();
+  ok = secp256k1_musig_partial_sig_agg(ctx, sig64, session, sigs_ptrs, n_sigs);
+  stats_record(STATS_MUSIG_AGG, start, ok);
+  enif_free(sigs);
+  enif_free(sigs_ptrs);
+  if (!ok) {
+    return error_result(env, "secp256k1_musig_partial_sig_agg failed");
+  }
+
+  return enif_make_tuple2(env, enif_make_atom(env, "ok"), result);
+
+bad_arg:
+  enif_free(sigs);
+  enif_free(sigs_ptrs);
+  return enif_make_badarg(env);
+}
+
+static ERL_NIF_TERM
+partial_sig_verify_batch(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary packed;
+  unsigned int n_sigs;
+  size_t cost;
+
+  if (enif_inspect_binary(env, argv[2], &packed)) {
+    n_sigs = packed.size / PACKED_ENTRY_SIZE;
+  } else if (!enif_get_list_length(env, argv[2], &n_sigs)) {
+    return enif_make_badarg(env);
+  }
+
+  cost = (size_t)n_sigs * PARTIAL_VERIFY_COST_US;
+  if (needs_dirty_scheduler(cost)) {
+    return enif_schedule_nif(env, "partial_sig_verify_batch", ERL_NIF_DIRTY_JOB_CPU_BOUND, verify_partial_sigs, argc, argv);
+  }
+
+  result = verify_partial_sigs(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+/* Operation stats extended with secnonce counts, a growing number of unused
+ * secnonces usually means sessions are abandoned or leaked */
+static ERL_NIF_TERM
+musig_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM map = stats_map(env);
+
+  enif_make_map_put(env, map, enif_make_atom(env, "musig_secnonces_live"),
+    enif_make_uint64(env, __atomic_load_n(&secnonces_live, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "musig_secnonces_unused"),
+    enif_make_uint64(env, __atomic_load_n(&secnonces_unused, __ATOMIC_RELAXED)), &map);
+
+  return map;
+}
+
 static ErlNifFunc nif_funcs[] = {
-  {"pubkey_agg", 1, pubkey_agg},
+  {"pubkey_agg_keys", 3, pubkey_agg},
+  {"keyagg_memo_configure", 1, keyagg_memo_configure},
+  {"keyagg_memo_info", 0, keyagg_memo_info},
   {"pubkey_get", 1, pubkey_get},
   {"pubkey_ec_tweak_add", 2, pubkey_ec_tweak_add},
   {"pubkey_xonly_tweak_add", 2, pubkey_xonly_tweak_add},
   {"nonce_gen", 5, nonce_gen},
+  {"nonce_pool_new", 4, nonce_pool_new},
+  {"nonce_pool_take", 1, nonce_pool_take},
+  {"nonce_pool_configure", 3, nonce_pool_configure},
+  {"nonce_pool_info", 1, nonce_pool_info},
   {"nonce_agg", 1, nonce_agg},
   {"nonce_process", 3, nonce_process},
   {"partial_sign", 4, partial_sign},
   {"partial_sig_verify", 5, partial_sig_verify},
-  {"partial_sig_agg", 2, partial_sig_agg}
+  {"partial_sig_agg", 2, partial_sig_agg},
+  {"partial_sig_verify_batch", 4, partial_sig_verify_batch},
+  {"stats", 0, musig_stats}
 };
 
-ERL_NIF_INIT(Elixir.Secp256k1.MuSig, nif_funcs, &musig_load, NULL, &upgrade, &unload)
+ERL_NIF_INIT(Elixir.Secp256k1.MuSig, nif_funcs, &musig_load, NULL, &upgrade, &musig_unload)
 
@@ -0,0 +1,204 @@
+#include <stdio.h>
+
+#include "sha2.h"
+
+/* Nostr events (NIP-01)
+ *
+ * Event id is SHA-256 of the canonical JSON serialization
+ * `[0,<pubkey>,<created_at>,<kind>,<tags>,<content>]`. The serialization is
+ * never built, its pieces are written straight into the hash. Event fields
+ * are passed as `{id, pubkey, created_at, kind, tags, content, sig}` tuple
+ * with id, pubkey and sig as lowercase hex as they appear in the JSON.
+ * Include after utils.h. */
+
+#define NOSTR_EVENT_FIELDS 7
+
+typedef enum {
+  NOSTR_OK,
+  NOSTR_INVALID_ID,
+  NOSTR_INVALID_SIG,
+  NOSTR_MALFORMED
+} nostr_status;
+
+static const char *nostr_status_names[] = {"ok", "invalid_id", "invalid_sig", "malformed"};
+
+static int
+hex_value(unsigned char c)
+{
+  if (c >= '0' && c <= '9') {
+    return c - '0';
+  }
+  if (c >= 'a' && c <= 'f') {
+    return c - 'a' + 10;
+  }
+  return -1;
+}
+
+/* Decodes lowercase hex of exactly `len` bytes, returns 0 for invalid input */
+static int
+decode_hex(unsigned char *out, const ErlNifBinary *hex, size_t len)
+{
+  size_t i;
+  int hi, lo;
+
+  if (hex->size != 2 * len) {
+    return 0;
+  }
+
+  for (i = 0; i < len; i++) {
+    hi = hex_value(hex->data[2 * i]);
+    lo = hex_value(hex->data[2 * i + 1]);
+    if (hi < 0 || lo < 0) {
+      return 0;
+    }
+    out[i] = (unsigned char)(hi << 4 | lo);
+  }
+
+  return 1;
+}
+
+static void
+hash_literal(sha256_ctx *hash, const char *str)
+{
+  sha256_write(hash, (const unsigned char *)str, strlen(str));
+}
+
+/* Hashes JSON string, only the characters NIP-01 lists are escaped */
+static void
+hash_json_string(sha256_ctx *hash, const ErlNifBinary *str)
+{
+  const char *escape;
+  size_t i, run = 0;
+
+  hash_literal(hash, "\"");
+  for (i = 0; i < str->size; i++) {
+    switch (str->data[i]) {
+    case '\n': escape = "\\n"; break;
+    case '"': escape = "\\\""; break;
+    case '\\': escape = "\\\\"; break;
+    case '\r': escape = "\\r"; break;
+    case '\t': escape = "\\t"; break;
+    case '\b': escape = "\\b"; break;
+    case '\f': escape = "\\f"; break;
+    default: continue;
+    }
+
+    sha256_write(hash, str->data + run, i - run);
+    hash_literal(hash, escape);
+    run = i + 1;
+  }
+  sha256_write(hash, str->data + run, str->size - run);
+  hash_literal(hash, "\"");
+}
+
+/* Hashes list of strings as JSON array, returns 0 when it is not one */
+static int
+hash_json_strings(ErlNifEnv *env, sha256_ctx *hash, ERL_NIF_TERM list)
+{
+  ERL_NIF_TERM head, tail;
+  ErlNifBinary str;
+  int first = 1;
+
+  hash_literal(hash, "[");
+  while (enif_get_list_cell(env, list, &head, &tail)) {
+    if (!enif_inspect_binary(env, head, &str)) {
+      return 0;
+    }
+    if (!first) {
+      hash_literal(hash, ",");
+    }
+    hash_json_string(hash, &str);
+    first = 0;
+    list = tail;
+  }
+  hash_literal(hash, "]");
+
+  return enif_is_empty_list(env, list);
+}
+
+/* Computes event id of `{pubkey, created_at, kind, tags, content}` fields,
+ * returns 0 for malformed fields */
+static int
+nostr_event_id(ErlNifEnv *env, const ERL_NIF_TERM *fields, unsigned char *id32)
+{
+  ERL_NIF_TERM head, tail, tags = fields[3];
+  ErlNifBinary pubkey, content;
+  ErlNifUInt64 created_at, kind;
+  unsigned char pubkey32[32];
+  char number[48];
+  int first = 1;
+  sha256_ctx hash;
+
+  if (!enif_inspect_binary(env, fields[0], &pubkey) || !decode_hex(pubkey32, &pubkey, 32) ||
+      !enif_get_uint64(env, fields[1], &created_at) ||
+      !enif_get_uint64(env, fields[2], &kind) ||
+      !enif_inspect_binary(env, fields[4], &content)) {
+    return 0;
+  }
+
+  sha256_init(&hash);
+  hash_literal(&hash, "[0,\"");
+  sha256_write(&hash, pubkey.data, pubkey.size);
+  snprintf(number, sizeof(number), "\",%llu,%llu,[", (unsigned long long)created_at, (unsigned long long)kind);
+  hash_literal(&hash, number);
+
+  while (enif_get_list_cell(env, tags, &head, &tail)) {
+    if (!first) {
+      hash_literal(&hash, ",");
+    }
+    if (!hash_json_strings(env, &hash, head)) {
+      return 0;
+    }
+    first = 0;
+    tags = tail;
+  }
+  if (!enif_is_empty_list(env, tags)) {
+    return 0;
+  }
+
+  hash_literal(&hash, "],");
+  hash_json_string(&hash, &content);
+  hash_literal(&hash, "]");
+  sha256_finalize(&hash, id32);
+
+  return 1;
+}
+
+/* Estimated cost of hashing `{pubkey, created_at, kind, tags, content}`
+ * fields: content plus the serialized tags (strings, quotes and separators,
+ * escapes ignored). Malformed fields are counted as far as they parse. */
+static size_t
+nostr_hash_cost(ErlNifEnv *env, const ERL_NIF_TERM *fields)
+{
+  ERL_NIF_TERM tag, tags = fields[3], head, tail;
+  ErlNifBinary str;
+  size_t bytes = 0;
+
+  if (enif_inspect_binary(env, fields[4], &str)) {
+    bytes += str.size;
+  }
+
+  while (enif_get_list_cell(env, tags, &tag, &tags)) {
+    bytes += 3;
+    while (enif_get_list_cell(env, tag, &head, &tail) && enif_inspect_binary(env, head, &str)) {
+      bytes += str.size + 3;
+      tag = tail;
+    }
+  }
+
+  return bytes / HASH_BYTES_PER_US;
+}
+
+/* Estimated cost of hashing and verifying the event */
+static size_t
+nostr_event_cost(ErlNifEnv *env, ERL_NIF_TERM event)
+{
+  const ERL_NIF_TERM *fields;
+  int arity;
+
+  if (enif_get_tuple(env, event, &arity, &fields) && arity == NOSTR_EVENT_FIELDS) {
+    return VERIFY_COST_US + nostr_hash_cost(env, fields + 1);
+  }
+
+  return VERIFY_COST_US;
+}
@@ -61,3 +61,14 @@ static int fill_random(unsigned char *data, size_t size)
 #endif
     return 0;
 }
+
+/* Clears memory the compiler can't prove is read again, memset could be
+ * optimized out */
+static void secure_erase(void *ptr, size_t len)
+{
+    volatile unsigned char *p = (volatile unsigned char *)ptr;
+    while (len--)
+    {
+        *p++ = 0;
+    }
+}
@@ -0,0 +1,301 @@
+#include "utils.h"
+
+#include <secp256k1_recovery.h>
+
+// Rough cost (us) of a single pubkey recovery, see utils.h
+#define RECOVER_COST_US 65
+
+/* Parses 65 bytes long `compact || recid` signature */
+static int
+parse_signature(ErlNifEnv *env, ERL_NIF_TERM term, secp256k1_ecdsa_recoverable_signature *sig)
+{
+  ErlNifBinary bin;
+
+  if (!enif_inspect_binary(env, term, &bin) || bin.size != 65 || bin.data[64] > 3)
+  {
+    return 0;
+  }
+
+  return secp256k1_ecdsa_recoverable_signature_parse_compact(ctx, sig, bin.data, bin.data[64]);
+}
+
+/* Serializes recovered pubkey, returns 0 when it failed */
+static int
+make_pubkey(ErlNifEnv *env, const secp256k1_pubkey *pubkey, int compressed, ERL_NIF_TERM *result)
+{
+  size_t len = compressed ? 33 : 65;
+  unsigned char *finished;
+
+  finished = enif_make_new_binary(env, len, result);
+  return secp256k1_ec_pubkey_serialize(ctx, finished, &len, pubkey,
+                                       compressed ? SECP256K1_EC_COMPRESSED : SECP256K1_EC_UNCOMPRESSED);
+}
+
+/* Recovers pubkey of single `{signature, msg_hash}` pair, 0 when it failed */
+static int
+recover_one(ErlNifEnv *env, const secp256k1_ecdsa_recoverable_signature *sig, const unsigned char *msg_hash, int compressed, ERL_NIF_TERM *result)
+{
+  secp256k1_pubkey pubkey;
+  ErlNifTime start;
+  int ok;
+
+  start = stats_start();
+  ok = secp256k1_ecdsa_recover(ctx, &pubkey, sig, msg_hash);
+  stats_record(STATS_RECOVER, start, ok);
+
+  return ok && make_pubkey(env, &pubkey, compressed, result);
+}
+
+// API
+
+static ERL_NIF_TERM
+sign(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary msg_hash, seckey, auxiliary_rand;
+
+  secp256k1_ecdsa_recoverable_signature sig;
+
+  unsigned char *finished;
+  ErlNifTime start;
+  int recid, ok;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &msg_hash) ||
+      !enif_inspect_binary(env, argv[1], &seckey) ||
+      !enif_inspect_binary(env, argv[2], &auxiliary_rand))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (msg_hash.size != 32 || auxiliary_rand.size != 32 ||
+      !(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  {
+    return enif_make_badarg(env);
+  }
+
+  start = stats_start();
+  ok = secp256k1_ecdsa_sign_recoverable(signing_ctx(), &sig, msg_hash.data, seckey.data, NULL, auxiliary_rand.data);
+  stats_record(STATS_SIGN, start, ok);
+  if (!ok)
+  {
+    return error_result(env, "secp256k1_ecdsa_sign_recoverable failed");
+  }
+
+  finished = enif_make_new_binary(env, 65, &result);
+  if (!secp256k1_ecdsa_recoverable_signature_serialize_compact(ctx, finished, &recid, &sig))
+  {
+    return error_result(env, "secp256k1_ecdsa_recoverable_signature_serialize_compact failed");
+  }
+  finished[64] = (unsigned char)recid;
+
+  return result;
+}
+
+static ERL_NIF_TERM
+parse_compact(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary compact;
+
+  secp256k1_ecdsa_recoverable_signature sig;
+
+  unsigned char *finished;
+  int recid;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &compact) ||
+      !enif_get_int(env, argv[1], &recid))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (compact.size != 64 || recid < 0 || recid > 3)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!secp256k1_ecdsa_recoverable_signature_parse_compact(ctx, &sig, compact.data, recid))
+  {
+    return error_result(env, "secp256k1_ecdsa_recoverable_signature_parse_compact failed");
+  }
+
+  finished = enif_make_new_binary(env, 65, &result);
+  memcpy(finished, compact.data, 64);
+  finished[64] = (unsigned char)recid;
+
+  return result;
+}
+
+static ERL_NIF_TERM
+serialize_compact(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM compact;
+
+  secp256k1_ecdsa_recoverable_signature sig;
+
+  unsigned char *finished;
+  int recid;
+
+  if (!parse_signature(env, argv[0], &sig))
+  {
+    return enif_make_badarg(env);
+  }
+
+  finished = enif_make_new_binary(env, 64, &compact);
+  if (!secp256k1_ecdsa_recoverable_signature_serialize_compact(ctx, finished, &recid, &sig))
+  {
+    return error_result(env, "secp256k1_ecdsa_recoverable_signature_serialize_compact failed");
+  }
+
+  return enif_make_tuple2(env, compact, enif_make_int(env, recid));
+}
+
+static ERL_NIF_TERM
+to_ecdsa(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+
+  secp256k1_ecdsa_recoverable_signature recoverable_sig;
+  secp256k1_ecdsa_signature sig;
+
+  unsigned char *finished;
+
+  if (!parse_signature(env, argv[0], &recoverable_sig))
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!secp256k1_ecdsa_recoverable_signature_convert(ctx, &sig, &recoverable_sig))
+  {
+    return error_result(env, "secp256k1_ecdsa_recoverable_signature_convert failed");
+  }
+
+  finished = enif_make_new_binary(env, 64, &result);
+  if (!secp256k1_ecdsa_signature_serialize_compact(ctx, finished, &sig))
+  {
+    return error_result(env, "secp256k1_ecdsa_signature_serialize_compact failed");
+  }
+
+  return result;
+}
+
+static ERL_NIF_TERM
+recover(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary msg_hash;
+
+  secp256k1_ecdsa_recoverable_signature sig;
+
+  // load arguments
+  if (!parse_signature(env, argv[0], &sig) ||
+      !enif_inspect_binary(env, argv[1], &msg_hash) ||
+      !enif_is_atom(env, argv[2]))
+  {
+    return enif_make_badarg(env);
+  }
+
+  // check arguments size
+  if (msg_hash.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!recover_one(env, &sig, msg_hash.data, enif_is_identical(argv[2], enif_make_atom(env, "true")), &result))
+  {
+    return error_result(env, "secp256k1_ecdsa_recover failed");
+  }
+
+  return result;
+}
+
+/* Recovers pubkey of every `{signature, msg_hash}` entry, `nil` for the ones
+ * which can not be recovered */
+static ERL_NIF_TERM
+recover_list(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, pubkey, result, list = argv[0];
+  ERL_NIF_TERM *pubkeys;
+  ErlNifBinary msg_hash;
+  const ERL_NIF_TERM *tuple;
+  unsigned int length, index = 0;
+  int arity, compressed;
+
+  secp256k1_ecdsa_recoverable_signature sig;
+
+  if (!enif_get_list_length(env, list, &length) || !enif_is_atom(env, argv[1]))
+  {
+    return enif_make_badarg(env);
+  }
+  compressed = enif_is_identical(argv[1], enif_make_atom(env, "true"));
+
+  pubkeys = enif_alloc((length ? length : 1) * sizeof(ERL_NIF_TERM));
+  if (!pubkeys)
+  {
+    return error_result(env, "enif_alloc failed");
+  }
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    if (!enif_get_tuple(env, head, &arity, &tuple) || arity != 2 ||
+        !enif_inspect_binary(env, tuple[1], &msg_hash) || msg_hash.size != 32)
+    {
+      enif_free(pubkeys);
+      return enif_make_badarg(env);
+    }
+
+    if (parse_signature(env, tuple[0], &sig) && recover_one(env, &sig, msg_hash.data, compressed, &pubkey))
+    {
+      pubkeys[index] = pubkey;
+    }
+    else
+    {
+      pubkeys[index] = enif_make_atom(env, "nil");
+    }
+
+    index++;
+    list = tail;
+  }
+
+  result = enif_make_list_from_array(env, pubkeys, length);
+  enif_free(pubkeys);
+  return result;
+}
+
+static ERL_NIF_TERM
+recover_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  unsigned int length;
+  size_t cost;
+
+  if (!enif_get_list_length(env, argv[0], &length))
+  {
+    return enif_make_badarg(env);
+  }
+
+  cost = (size_t)length * RECOVER_COST_US;
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "recover_pubkeys", ERL_NIF_DIRTY_JOB_CPU_BOUND, recover_list, argc, argv);
+  }
+
+  result = recover_list(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+static ErlNifFunc nif_funcs[] = {
+    {"sign", 3, sign},
+    {"parse_compact", 2, parse_compact},
+    {"serialize_compact", 1, serialize_compact},
+    {"to_ecdsa", 1, to_ecdsa},
+    {"recover_pubkey", 3, recover},
+    {"recover_pubkeys", 2, recover_many},
+    {"stats", 0, stats},
+};
+
+ERL_NIF_INIT(Elixir.Secp256k1.Recovery, nif_funcs, &load, NULL, &upgrade, &unload)
@@ -1,80 +1,284 @@
 #include "utils.h"
+#include "iodata.h"
+#include "nostr.h"
+#include "sigcache.h"
 
 #include <secp256k1.h>
 #include <secp256k1_extrakeys.h>
 #include <secp256k1_schnorrsig.h>
 
-// API
+// Resource type for keypairs so long-lived keys don't have to be recreated on every signature
+static ErlNifResourceType *keypair_resource_type;
+
+typedef struct {
+  secp256k1_keypair keypair;
+} keypair_wrapper;
+
+static void
+destruct_keypair(ErlNifEnv *env, void *obj)
+{
+  secure_erase(obj, sizeof(keypair_wrapper));
+}
+
+static int
+schnorrsig_load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
+{
+  // Initialize the library context via utils.h's load
+  if (load(env, priv, load_info) != 0)
+  {
+    return -1;
+  }
+
+  keypair_resource_type = enif_open_resource_type(
+      env,
+      NULL,
+      "keypair_resource",
+      destruct_keypair,
+      ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+      NULL);
+
+  if (!keypair_resource_type || !open_hash_state_type(env) || !sigcache_open())
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+static void
+schnorrsig_unload(ErlNifEnv *env, void *priv)
+{
+  sigcache_close();
+  unload(env, priv);
+}
+
+/* Returns keypair stored in the keypair resource or creates one from seckey
+ * binary into `tmp` (caller must erase it), NULL for invalid argument */
+static const secp256k1_keypair *
+get_keypair(ErlNifEnv *env, ERL_NIF_TERM term, secp256k1_keypair *tmp)
+{
+  keypair_wrapper *wrapper;
+  ErlNifBinary seckey;
+
+  if (enif_get_resource(env, term, keypair_resource_type, (void **)&wrapper))
+  {
+    return &wrapper->keypair;
+  }
+
+  if (!enif_inspect_binary(env, term, &seckey) || seckey.size != 32)
+  {
+    return NULL;
+  }
 
+  /* also verifies the seckey */
+  if (!secp256k1_keypair_create(signing_ctx(), tmp, seckey.data))
+  {
+    return NULL;
+  }
+
+  return tmp;
+}
+
+/* Signs 32 byte hash with keypair resource or seckey term */
 static ERL_NIF_TERM
-sign32(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+sign_hash(ErlNifEnv *env, const unsigned char *msg_hash, ERL_NIF_TERM seckey, const unsigned char *auxiliary_rand)
 {
   ERL_NIF_TERM result;
-  ErlNifBinary message, seckey, auxiliary_rand;
 
-  secp256k1_keypair keypair;
+  secp256k1_keypair tmp_keypair;
+  const secp256k1_keypair *keypair;
 
   unsigned char signature[64];
   unsigned char *finished;
+  ErlNifTime start;
+  int signed_ok;
 
-  /* load arguments given by Elixir */
-  if (!enif_inspect_binary(env, argv[0], &message) ||
-      !enif_inspect_binary(env, argv[1], &seckey) ||
-      !enif_inspect_binary(env, argv[2], &auxiliary_rand))
+  /* keypair resource or seckey binary */
+  start = stats_start();
+  if (!(keypair = get_keypair(env, seckey, &tmp_keypair)))
   {
     return enif_make_badarg(env);
   }
 
-  /* check expected arguments size */
-  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  /* Generate a Schnorr signature */
+  signed_ok = secp256k1_schnorrsig_sign32(signing_ctx(), signature, msg_hash, keypair, auxiliary_rand);
+  secure_erase(&tmp_keypair, sizeof(tmp_keypair));
+  stats_record(STATS_SIGN, start, signed_ok);
+
+  if (!signed_ok)
+  {
+    return error_result(env, "secp256k1_schnorrsig_sign32 failed");
+  }
+
+  /* Convert signature to Erlang binary */
+  finished = enif_make_new_binary(env, sizeof(signature), &result);
+  memcpy(finished, signature, sizeof(signature));
+  return result;
+}
+
+/* Verifies signature with serialized xonly pubkey, successful verifications
+ * are remembered in the verification cache when it is enabled. Returns -1 for
+ * invalid pubkey. */
+static int
+verify_cached(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *pubkey)
+{
+  secp256k1_xonly_pubkey xonly_pubkey;
+  unsigned char entry[32];
+  int cached = sigcache_enabled();
+  int valid;
+
+  if (cached)
+  {
+    sigcache_entry(entry, signature, 64, pubkey, 32, message, message_len);
+    if (sigcache_contains(entry))
+    {
+      return 1;
+    }
+  }
+
+  if (!secp256k1_xonly_pubkey_parse(ctx, &xonly_pubkey, pubkey))
+  {
+    return -1;
+  }
+
+  valid = secp256k1_schnorrsig_verify(ctx, signature, message, message_len, &xonly_pubkey);
+  if (valid && cached)
+  {
+    sigcache_insert(entry);
+  }
+
+  return valid;
+}
+
+/* Verifies signature with already loaded arguments */
+static ERL_NIF_TERM
+verify_message(ErlNifEnv *env, const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *pubkey)
+{
+  ErlNifTime start;
+  int valid;
+
+  // parsing is part of the verification latency
+  start = stats_start();
+
+  valid = verify_cached(signature, message, message_len, pubkey);
+  if (valid < 0)
+  {
+    stats_record(STATS_VERIFY, start, 0);
+    return error_result(env, "secp256k1_xonly_pubkey_parse failed");
+  }
+
+  stats_record(STATS_VERIFY, start, valid);
+  return enif_make_atom(env, valid ? "true" : "false");
+}
+
+// API
+
+static ERL_NIF_TERM
+keypair(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  ErlNifBinary seckey;
+  keypair_wrapper *wrapper;
+  ErlNifTime start;
+  int ok;
+
+  // load arguments
+  if (!enif_inspect_binary(env, argv[0], &seckey) || seckey.size != 32)
   {
     return enif_make_badarg(env);
   }
 
-  if (message.size != 32)
+  wrapper = enif_alloc_resource(keypair_resource_type, sizeof(keypair_wrapper));
+  if (!wrapper)
   {
+    return error_result(env, "enif_alloc_resource failed");
+  }
+
+  start = stats_start();
+  ok = secp256k1_keypair_create(signing_ctx(), &wrapper->keypair, seckey.data);
+  stats_record(STATS_PUBKEY, start, ok);
+  if (!ok)
+  {
+    enif_release_resource(wrapper);
     return enif_make_badarg(env);
   }
 
-  if (auxiliary_rand.size != 32)
+  result = enif_make_resource(env, wrapper);
+  enif_release_resource(wrapper);
+  return result;
+}
+
+static ERL_NIF_TERM
+keypair_xonly_pubkey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  keypair_wrapper *wrapper;
+  secp256k1_xonly_pubkey pubkey;
+  unsigned char *finished;
+
+  if (!enif_get_resource(env, argv[0], keypair_resource_type, (void **)&wrapper))
   {
     return enif_make_badarg(env);
   }
 
-  /* create key pair from secret key */
-  if (!secp256k1_keypair_create(ctx, &keypair, seckey.data))
+  if (!secp256k1_keypair_xonly_pub(ctx, &pubkey, NULL, &wrapper->keypair))
   {
-    return error_result(env, "secp256k1_keypair_create failed");
+    return error_result(env, "secp256k1_keypair_xonly_pub failed");
   }
 
-  /* Generate a Schnorr signature */
-  if (!secp256k1_schnorrsig_sign32(ctx, signature, message.data, &keypair, auxiliary_rand.data))
+  finished = enif_make_new_binary(env, 32, &result);
+  if (!secp256k1_xonly_pubkey_serialize(ctx, finished, &pubkey))
   {
-    return error_result(env, "secp256k1_schnorrsig_sign32 failed");
+    return error_result(env, "secp256k1_xonly_pubkey_serialize failed");
   }
 
-  /* Convert signature to Erlang binary */
-  finished = enif_make_new_binary(env, sizeof(signature), &result);
-  memcpy(finished, signature, sizeof(signature));
-  secure_erase(&keypair, sizeof(keypair));
   return result;
 }
 
+static ERL_NIF_TERM
+sign32(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifBinary message, auxiliary_rand;
+
+  /* load arguments given by Elixir */
+  if (!enif_inspect_binary(env, argv[0], &message) ||
+      !enif_inspect_binary(env, argv[2], &auxiliary_rand))
+  {
+    return enif_make_badarg(env);
+  }
+
+  /* check expected arguments size */
+  if (message.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (auxiliary_rand.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  return sign_hash(env, message.data, argv[1], auxiliary_rand.data);
+}
+
 static ERL_NIF_TERM
 sign_custom(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
   ERL_NIF_TERM result;
-  ErlNifBinary message, seckey, auxiliary_rand;
+  ErlNifBinary message, auxiliary_rand;
 
   secp256k1_schnorrsig_extraparams extraparams = SECP256K1_SCHNORRSIG_EXTRAPARAMS_INIT;
-  secp256k1_keypair keypair;
+  secp256k1_keypair tmp_keypair;
+  const secp256k1_keypair *keypair;
 
   unsigned char signature[64];
   unsigned char *finished;
+  ErlNifTime start;
+  size_t cost;
+  int signed_ok;
 
   /* load arguments given by Elixir */
   if (!enif_inspect_binary(env, argv[0], &message) ||
-      !enif_inspect_binary(env, argv[1], &seckey) ||
       !enif_inspect_binary(env, argv[2], &auxiliary_rand))
   {
     return enif_make_badarg(env);
@@ -85,23 +289,29 @@ sign_custom(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     return enif_make_badarg(env);
   }
 
-  /* check expected arguments size */
-  if (!(seckey.size == 32 && secp256k1_ec_seckey_verify(ctx, seckey.data)))
+  /* message is hashed twice (nonce and challenge), long ones go to dirty scheduler */
+  cost = SIGN_COST_US + 2 * message.size / HASH_BYTES_PER_US;
+  if (needs_dirty_scheduler(cost))
   {
-    return enif_make_badarg(env);
+    return enif_schedule_nif(env, "sign_custom", ERL_NIF_DIRTY_JOB_CPU_BOUND, sign_custom, argc, argv);
   }
 
-  /* create key pair from secret key */
-  if (!secp256k1_keypair_create(ctx, &keypair, seckey.data))
+  /* keypair resource or seckey binary */
+  start = stats_start();
+  if (!(keypair = get_keypair(env, argv[1], &tmp_keypair)))
   {
-    return error_result(env, "secp256k1_keypair_create failed");
+    return enif_make_badarg(env);
   }
 
   /* Assign the randomness to the extraparams data field */
   extraparams.ndata = auxiliary_rand.data;
 
   /* Generate a Schnorr signature */
-  if (!secp256k1_schnorrsig_sign_custom(ctx, signature, message.data, message.size, &keypair, &extraparams))
+  signed_ok = secp256k1_schnorrsig_sign_custom(signing_ctx(), signature, message.data, message.size, keypair, &extraparams);
+  secure_erase(&tmp_keypair, sizeof(tmp_keypair));
+  stats_record(STATS_SIGN, start, signed_ok);
+
+  if (!signed_ok)
   {
     return error_result(env, "secp256k1_schnorrsig_sign_custom failed");
   }
@@ -109,16 +319,16 @@ sign_custom(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
   /* Convert signature to Erlang binary */
   finished = enif_make_new_binary(env, sizeof(signature), &result);
   memcpy(finished, signature, sizeof(signature));
-  secure_erase(&keypair, sizeof(keypair));
+  consume_timeslice(env, cost);
   return result;
 }
 
 static ERL_NIF_TERM
 verify(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 {
+  ERL_NIF_TERM result;
   ErlNifBinary signature, message, pubkey;
-
-  secp256k1_xonly_pubkey xonly_pubkey;
+  size_t cost;
 
   // load arguments
   if (!enif_inspect_binary(env, argv[0], &signature) ||
@@ -134,23 +344,484 @@ verify(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     return enif_make_badarg(env);
   }
 
-  if (!secp256k1_xonly_pubkey_parse(ctx, &xonly_pubkey, pubkey.data))
+  // long messages are hashed on dirty scheduler
+  cost = VERIFY_COST_US + message.size / HASH_BYTES_PER_US;
+  if (needs_dirty_scheduler(cost))
   {
-    return error_result(env, "secp256k1_xonly_pubkey_parse failed");
+    return enif_schedule_nif(env, "valid?", ERL_NIF_DIRTY_JOB_CPU_BOUND, verify, argc, argv);
   }
 
-  if (secp256k1_schnorrsig_verify(ctx, signature.data, message.data, message.size, &xonly_pubkey))
+  result = verify_message(env, signature.data, message.data, message.size, pubkey.data);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+/* Continues hashing of iodata message, argv is `{hash_state, rest_of_message,
+ * seckey, aux}` */
+static ERL_NIF_TERM
+sign_iodata_continue(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM next[4];
+  hash_state *state;
+  ErlNifBinary auxiliary_rand;
+  unsigned char msg_hash[32];
+
+  if (!enif_get_resource(env, argv[0], hash_state_resource_type, (void **)&state))
+  {
+    return enif_make_badarg(env);
+  }
+
+  memcpy(next, argv, sizeof(next));
+  switch (hash_iodata(env, &state->hash, &next[1]))
+  {
+  case IODATA_BADARG:
+    return enif_make_badarg(env);
+  case IODATA_YIELD:
+    return enif_schedule_nif(env, "sign_iodata", 0, sign_iodata_continue, 4, next);
+  case IODATA_DONE:
+    break;
+  }
+
+  sha256_finalize(&state->hash, msg_hash);
+
+  /* aux was checked before hashing started */
+  enif_inspect_binary(env, argv[3], &auxiliary_rand);
+
+  return sign_hash(env, msg_hash, argv[2], auxiliary_rand.data);
+}
+
+static ERL_NIF_TERM
+sign_iodata(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM args[4];
+  ErlNifBinary auxiliary_rand, seckey;
+  keypair_wrapper *wrapper;
+
+  /* iodata, keypair or seckey, aux and hash tag (nil for plain SHA-256), the
+   * seckey itself is verified when signing */
+  if (!(enif_get_resource(env, argv[1], keypair_resource_type, (void **)&wrapper) ||
+        (enif_inspect_binary(env, argv[1], &seckey) && seckey.size == 32)) ||
+      !enif_inspect_binary(env, argv[2], &auxiliary_rand) || auxiliary_rand.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!new_hash_state(env, argv[3], &args[0]))
+  {
+    return enif_make_badarg(env);
+  }
+
+  args[1] = argv[0];
+  args[2] = argv[1];
+  args[3] = argv[2];
+  return sign_iodata_continue(env, 4, args);
+}
+
+/* Continues hashing of iodata message, argv is `{hash_state, rest_of_message,
+ * signature, pubkey}` */
+static ERL_NIF_TERM
+verify_iodata_continue(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM next[4];
+  hash_state *state;
+  ErlNifBinary signature, pubkey;
+  unsigned char msg_hash[32];
+
+  if (!enif_get_resource(env, argv[0], hash_state_resource_type, (void **)&state))
+  {
+    return enif_make_badarg(env);
+  }
+
+  memcpy(next, argv, sizeof(next));
+  switch (hash_iodata(env, &state->hash, &next[1]))
   {
-    return enif_make_atom(env, "true");
+  case IODATA_BADARG:
+    return enif_make_badarg(env);
+  case IODATA_YIELD:
+    return enif_schedule_nif(env, "verify_iodata", 0, verify_iodata_continue, 4, next);
+  case IODATA_DONE:
+    break;
   }
 
-  return enif_make_atom(env, "false");
+  sha256_finalize(&state->hash, msg_hash);
+
+  /* arguments were checked before hashing started */
+  enif_inspect_binary(env, argv[2], &signature);
+  enif_inspect_binary(env, argv[3], &pubkey);
+
+  return verify_message(env, signature.data, msg_hash, sizeof(msg_hash), pubkey.data);
+}
+
+static ERL_NIF_TERM
+verify_iodata(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM args[4];
+  ErlNifBinary signature, pubkey;
+
+  /* signature, iodata, pubkey and hash tag (nil for plain SHA-256) */
+  if (!enif_inspect_binary(env, argv[0], &signature) || signature.size != 64 ||
+      !enif_inspect_binary(env, argv[2], &pubkey) || pubkey.size != 32)
+  {
+    return enif_make_badarg(env);
+  }
+
+  if (!new_hash_state(env, argv[3], &args[0]))
+  {
+    return enif_make_badarg(env);
+  }
+
+  args[1] = argv[1];
+  args[2] = argv[0];
+  args[3] = argv[2];
+  return verify_iodata_continue(env, 4, args);
+}
+
+/* Parse one `{signature, message, pubkey}` batch entry. Returns 0 on malformed
+ * input, -1 when the entry is well-formed but can never verify (invalid
+ * pubkey) and 1 when the entry is ready for secp256k1_schnorrsig_verify.
+ * With NULL `xonly_pubkey` only the shape is checked. */
+static int
+parse_batch_item(ErlNifEnv *env, ERL_NIF_TERM item, ErlNifBinary *signature, ErlNifBinary *message, secp256k1_xonly_pubkey *xonly_pubkey)
+{
+  const ERL_NIF_TERM *tuple;
+  ErlNifBinary pubkey;
+  int arity;
+
+  if (!enif_get_tuple(env, item, &arity, &tuple) || arity != 3)
+  {
+    return 0;
+  }
+
+  if (!enif_inspect_binary(env, tuple[0], signature) ||
+      !enif_inspect_binary(env, tuple[1], message) ||
+      !enif_inspect_binary(env, tuple[2], &pubkey))
+  {
+    return 0;
+  }
+
+  if (signature->size != 64 || pubkey.size != 32)
+  {
+    return 0;
+  }
+
+  if (xonly_pubkey && !secp256k1_xonly_pubkey_parse(ctx, xonly_pubkey, pubkey.data))
+  {
+    return -1;
+  }
+
+  return 1;
+}
+
+/* Estimated cost of verifying the batch, malformed entries are left for the
+ * verification itself to report */
+static size_t
+batch_cost(ErlNifEnv *env, ERL_NIF_TERM list)
+{
+  ERL_NIF_TERM head, tail;
+  const ERL_NIF_TERM *tuple;
+  ErlNifBinary message;
+  size_t cost = 0;
+  int arity;
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    cost += VERIFY_COST_US;
+    if (enif_get_tuple(env, head, &arity, &tuple) && arity == 3 &&
+        enif_inspect_binary(env, tuple[1], &message))
+    {
+      cost += message.size / HASH_BYTES_PER_US;
+    }
+    list = tail;
+  }
+
+  return cost;
+}
+
+/* Verifies the list up to the first invalid entry, the rest is only checked
+ * for malformed input without parsing or verifying */
+static ERL_NIF_TERM
+verify_batch_all(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, list = argv[0];
+  ErlNifBinary signature, message;
+  secp256k1_xonly_pubkey xonly_pubkey;
+  ErlNifTime start = stats_start();
+  int valid = 1;
+  int parsed;
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    /* keep checking the shape of the rest of the list so bad input is
+     * reported the same way no matter where the first invalid entry is */
+    parsed = parse_batch_item(env, head, &signature, &message, valid ? &xonly_pubkey : NULL);
+    if (parsed == 0)
+    {
+      return enif_make_badarg(env);
+    }
+
+    if (valid && (parsed < 0 || !secp256k1_schnorrsig_verify(ctx, signature.data, message.data, message.size, &xonly_pubkey)))
+    {
+      valid = 0;
+    }
+
+    list = tail;
+  }
+
+  if (!enif_is_empty_list(env, list))
+  {
+    return enif_make_badarg(env);
+  }
+
+  stats_record(STATS_VERIFY_BATCH, start, valid);
+  return enif_make_atom(env, valid ? "true" : "false");
+}
+
+/* Verifies every entry and returns indices of the invalid ones */
+static ERL_NIF_TERM
+verify_batch_each(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, result, invalid, list = argv[0];
+  ErlNifBinary signature, message;
+  secp256k1_xonly_pubkey xonly_pubkey;
+  ErlNifTime start = stats_start();
+  unsigned int index = 0;
+  int parsed;
+
+  invalid = enif_make_list(env, 0);
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    parsed = parse_batch_item(env, head, &signature, &message, &xonly_pubkey);
+    if (parsed == 0)
+    {
+      return enif_make_badarg(env);
+    }
+
+    if (parsed < 0 || !secp256k1_schnorrsig_verify(ctx, signature.data, message.data, message.size, &xonly_pubkey))
+    {
+      invalid = enif_make_list_cell(env, enif_make_uint(env, index), invalid);
+    }
+
+    index++;
+    list = tail;
+  }
+
+  if (!enif_is_empty_list(env, list))
+  {
+    return enif_make_badarg(env);
+  }
+
+  stats_record(STATS_VERIFY_BATCH, start, enif_is_empty_list(env, invalid));
+  if (enif_is_empty_list(env, invalid))
+  {
+    return enif_make_atom(env, "ok");
+  }
+
+  enif_make_reverse_list(env, invalid, &result);
+  return enif_make_tuple2(env, enif_make_atom(env, "error"), result);
+}
+
+static ERL_NIF_TERM
+valid_batch(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  size_t cost;
+
+  if (!enif_is_list(env, argv[0]))
+  {
+    return enif_make_badarg(env);
+  }
+
+  cost = batch_cost(env, argv[0]);
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "valid_batch?", ERL_NIF_DIRTY_JOB_CPU_BOUND, verify_batch_all, argc, argv);
+  }
+
+  result = verify_batch_all(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+static ERL_NIF_TERM
+verify_batch(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  size_t cost;
+
+  if (!enif_is_list(env, argv[0]))
+  {
+    return enif_make_badarg(env);
+  }
+
+  cost = batch_cost(env, argv[0]);
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "verify_batch", ERL_NIF_DIRTY_JOB_CPU_BOUND, verify_batch_each, argc, argv);
+  }
+
+  result = verify_batch_each(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+/* Checks event id and signature of one event tuple */
+static nostr_status
+verify_event(ErlNifEnv *env, ERL_NIF_TERM event)
+{
+  const ERL_NIF_TERM *fields;
+  ErlNifBinary id_hex, pubkey_hex, sig_hex;
+  unsigned char claimed_id[32], id[32], pubkey[32], sig[64];
+  ErlNifTime start;
+  int arity, valid;
+
+  if (!enif_get_tuple(env, event, &arity, &fields) || arity != NOSTR_EVENT_FIELDS ||
+      !enif_inspect_binary(env, fields[0], &id_hex) || !decode_hex(claimed_id, &id_hex, 32) ||
+      !enif_inspect_binary(env, fields[1], &pubkey_hex) || !decode_hex(pubkey, &pubkey_hex, 32) ||
+      !enif_inspect_binary(env, fields[6], &sig_hex) || !decode_hex(sig, &sig_hex, 64))
+  {
+    return NOSTR_MALFORMED;
+  }
+
+  if (!nostr_event_id(env, fields + 1, id))
+  {
+    return NOSTR_MALFORMED;
+  }
+
+  if (memcmp(id, claimed_id, sizeof(id)) != 0)
+  {
+    return NOSTR_INVALID_ID;
+  }
+
+  start = stats_start();
+  valid = verify_cached(sig, id, sizeof(id), pubkey) > 0;
+  stats_record(STATS_VERIFY, start, valid);
+
+  return valid ? NOSTR_OK : NOSTR_INVALID_SIG;
+}
+
+static ERL_NIF_TERM
+make_event_status(ErlNifEnv *env, nostr_status status)
+{
+  if (status == NOSTR_OK)
+  {
+    return enif_make_atom(env, "ok");
+  }
+
+  return enif_make_tuple2(env, enif_make_atom(env, "error"), enif_make_atom(env, nostr_status_names[status]));
+}
+
+/* Verifies every event of the list, returns list of statuses */
+static ERL_NIF_TERM
+verify_events_each(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, result, statuses, list = argv[0];
+
+  statuses = enif_make_list(env, 0);
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    statuses = enif_make_list_cell(env, make_event_status(env, verify_event(env, head)), statuses);
+    list = tail;
+  }
+
+  if (!enif_is_empty_list(env, list))
+  {
+    return enif_make_badarg(env);
+  }
+
+  enif_make_reverse_list(env, statuses, &result);
+  return result;
+}
+
+static ERL_NIF_TERM
+verify_events(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM head, tail, result, list = argv[0];
+  size_t cost = 0;
+
+  if (!enif_is_list(env, list))
+  {
+    return enif_make_badarg(env);
+  }
+
+  while (enif_get_list_cell(env, list, &head, &tail))
+  {
+    cost += nostr_event_cost(env, head);
+    list = tail;
+  }
+
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "verify_events", ERL_NIF_DIRTY_JOB_CPU_BOUND, verify_events_each, argc, argv);
+  }
+
+  result = verify_events_each(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+/* Computes event id of `{pubkey, created_at, kind, tags, content}` tuple */
+static ERL_NIF_TERM
+compute_event_id(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  const ERL_NIF_TERM *fields;
+  unsigned char *finished;
+  int arity;
+
+  if (!enif_get_tuple(env, argv[0], &arity, &fields) || arity != NOSTR_EVENT_FIELDS - 2)
+  {
+    return enif_make_badarg(env);
+  }
+
+  finished = enif_make_new_binary(env, 32, &result);
+  if (!nostr_event_id(env, fields, finished))
+  {
+    return enif_make_badarg(env);
+  }
+
+  return result;
+}
+
+static ERL_NIF_TERM
+event_id(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ERL_NIF_TERM result;
+  const ERL_NIF_TERM *fields;
+  size_t cost = 0;
+  int arity;
+
+  if (enif_get_tuple(env, argv[0], &arity, &fields) && arity == NOSTR_EVENT_FIELDS - 2)
+  {
+    cost = nostr_hash_cost(env, fields);
+  }
+
+  if (needs_dirty_scheduler(cost))
+  {
+    return enif_schedule_nif(env, "event_id", ERL_NIF_DIRTY_JOB_CPU_BOUND, compute_event_id, argc, argv);
+  }
+
+  result = compute_event_id(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
 }
 
 static ErlNifFunc nif_funcs[] = {
+    {"keypair", 1, keypair},
+    {"xonly_pubkey", 1, keypair_xonly_pubkey},
     {"sign32", 3, sign32},
     {"sign_custom", 3, sign_custom},
     {"valid?", 3, verify},
+    {"valid_batch?", 1, valid_batch},
+    {"verify_batch", 1, verify_batch},
+    {"sign_iodata", 4, sign_iodata},
+    {"verify_iodata", 4, verify_iodata},
+    {"event_id", 1, event_id},
+    {"verify_events", 1, verify_events},
+    {"sigcache_configure", 1, configure_sigcache},
+    {"sigcache_stats", 0, sigcache_stats},
+    {"stats", 0, stats},
 };
 
-ERL_NIF_INIT(Elixir.Secp256k1.Schnorr, nif_funcs, &load, NULL, &upgrade, &unload)
+ERL_NIF_INIT(Elixir.Secp256k1.Schnorr, nif_funcs, &schnorrsig_load, NULL, &upgrade, &schnorrsig_unload)
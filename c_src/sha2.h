@@ -0,0 +1,308 @@
+#ifndef SECP256K1_NIF_SHA2_H
+#define SECP256K1_NIF_SHA2_H
+
+#include <stdint.h>
+
+/* SHA-256, SHA-512 and HMAC-SHA512 (FIPS 180-4, RFC 2104)
+ *
+ * libsecp256k1 does not export its hash functions (only one-shot
+ * secp256k1_tagged_sha256) and SHA-512 is not part of it at all, so the NIFs
+ * which need incremental hashing (iodata messages) or HMAC-SHA512 (BIP32 child
+ * derivation) use this small portable implementation. Include after utils.h. */
+
+typedef struct {
+  uint32_t state[8];
+  uint64_t bytes;
+  unsigned char buf[64];
+} sha256_ctx;
+
+typedef struct {
+  uint64_t state[8];
+  uint64_t bytes;
+  unsigned char buf[128];
+} sha512_ctx;
+
+typedef struct {
+  sha512_ctx inner;
+  sha512_ctx outer;
+} hmac_sha512_ctx;
+
+static const uint64_t sha512_k[80] = {
+  0x428a2f98d728ae22ULL, 0x7137449123ef65cdULL, 0xb5c0fbcfec4d3b2fULL, 0xe9b5dba58189dbbcULL,
+  0x3956c25bf348b538ULL, 0x59f111f1b605d019ULL, 0x923f82a4af194f9bULL, 0xab1c5ed5da6d8118ULL,
+  0xd807aa98a3030242ULL, 0x12835b0145706fbeULL, 0x243185be4ee4b28cULL, 0x550c7dc3d5ffb4e2ULL,
+  0x72be5d74f27b896fULL, 0x80deb1fe3b1696b1ULL, 0x9bdc06a725c71235ULL, 0xc19bf174cf692694ULL,
+  0xe49b69c19ef14ad2ULL, 0xefbe4786384f25e3ULL, 0x0fc19dc68b8cd5b5ULL, 0x240ca1cc77ac9c65ULL,
+  0x2de92c6f592b0275ULL, 0x4a7484aa6ea6e483ULL, 0x5cb0a9dcbd41fbd4ULL, 0x76f988da831153b5ULL,
+  0x983e5152ee66dfabULL, 0xa831c66d2db43210ULL, 0xb00327c898fb213fULL, 0xbf597fc7beef0ee4ULL,
+  0xc6e00bf33da88fc2ULL, 0xd5a79147930aa725ULL, 0x06ca6351e003826fULL, 0x142929670a0e6e70ULL,
+  0x27b70a8546d22ffcULL, 0x2e1b21385c26c926ULL, 0x4d2c6dfc5ac42aedULL, 0x53380d139d95b3dfULL,
+  0x650a73548baf63deULL, 0x766a0abb3c77b2a8ULL, 0x81c2c92e47edaee6ULL, 0x92722c851482353bULL,
+  0xa2bfe8a14cf10364ULL, 0xa81a664bbc423001ULL, 0xc24b8b70d0f89791ULL, 0xc76c51a30654be30ULL,
+  0xd192e819d6ef5218ULL, 0xd69906245565a910ULL, 0xf40e35855771202aULL, 0x106aa07032bbd1b8ULL,
+  0x19a4c116b8d2d0c8ULL, 0x1e376c085141ab53ULL, 0x2748774cdf8eeb99ULL, 0x34b0bcb5e19b48a8ULL,
+  0x391c0cb3c5c95a63ULL, 0x4ed8aa4ae3418acbULL, 0x5b9cca4f7763e373ULL, 0x682e6ff3d6b2b8a3ULL,
+  0x748f82ee5defb2fcULL, 0x78a5636f43172f60ULL, 0x84c87814a1f0ab72ULL, 0x8cc702081a6439ecULL,
+  0x90befffa23631e28ULL, 0xa4506cebde82bde9ULL, 0xbef9a3f7b2c67915ULL, 0xc67178f2e372532bULL,
+  0xca273eceea26619cULL, 0xd186b8c721c0c207ULL, 0xeada7dd6cde0eb1eULL, 0xf57d4f7fee6ed178ULL,
+  0x06f067aa72176fbaULL, 0x0a637dc5a2c898a6ULL, 0x113f9804bef90daeULL, 0x1b710b35131c471bULL,
+  0x28db77f523047d84ULL, 0x32caab7b40c72493ULL, 0x3c9ebe0a15c9bebcULL, 0x431d67c49c100d4cULL,
+  0x4cc5d4becb3e42b6ULL, 0x597f299cfc657e2aULL, 0x5fcb6fab3ad6faecULL, 0x6c44198c4a475817ULL
+};
+
+static const uint32_t sha256_k[64] = {
+  0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+  0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+  0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+  0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+  0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+  0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+  0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+  0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+#define SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define SHA512_ROTR(x, n) (((x) >> (n)) | ((x) << (64 - (n))))
+
+static inline void
+sha256_init(sha256_ctx *hash)
+{
+  hash->state[0] = 0x6a09e667;
+  hash->state[1] = 0xbb67ae85;
+  hash->state[2] = 0x3c6ef372;
+  hash->state[3] = 0xa54ff53a;
+  hash->state[4] = 0x510e527f;
+  hash->state[5] = 0x9b05688c;
+  hash->state[6] = 0x1f83d9ab;
+  hash->state[7] = 0x5be0cd19;
+  hash->bytes = 0;
+}
+
+static inline void
+sha256_transform(uint32_t *state, const unsigned char *block)
+{
+  uint32_t w[64], a, b, c, d, e, f, g, h, t1, t2;
+  int i;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = (uint32_t)block[i * 4] << 24 | (uint32_t)block[i * 4 + 1] << 16 |
+           (uint32_t)block[i * 4 + 2] << 8 | (uint32_t)block[i * 4 + 3];
+  }
+  for (i = 16; i < 64; i++) {
+    w[i] = (SHA256_ROTR(w[i - 2], 17) ^ SHA256_ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10)) + w[i - 7] +
+           (SHA256_ROTR(w[i - 15], 7) ^ SHA256_ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3)) + w[i - 16];
+  }
+
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+  for (i = 0; i < 64; i++) {
+    t1 = h + (SHA256_ROTR(e, 6) ^ SHA256_ROTR(e, 11) ^ SHA256_ROTR(e, 25)) + ((e & f) ^ (~e & g)) +
+         sha256_k[i] + w[i];
+    t2 = (SHA256_ROTR(a, 2) ^ SHA256_ROTR(a, 13) ^ SHA256_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static inline void
+sha256_write(sha256_ctx *hash, const unsigned char *data, size_t len)
+{
+  size_t fill = hash->bytes % 64, take;
+
+  hash->bytes += len;
+  while (len > 0) {
+    // whole blocks are hashed straight from the input
+    if (fill == 0 && len >= 64) {
+      sha256_transform(hash->state, data);
+      data += 64;
+      len -= 64;
+      continue;
+    }
+    take = 64 - fill < len ? 64 - fill : len;
+    memcpy(hash->buf + fill, data, take);
+    fill += take;
+    data += take;
+    len -= take;
+    if (fill == 64) {
+      sha256_transform(hash->state, hash->buf);
+      fill = 0;
+    }
+  }
+}
+
+static inline void
+sha256_finalize(sha256_ctx *hash, unsigned char out[32])
+{
+  unsigned char pad[72] = {0x80};
+  uint64_t bits = hash->bytes << 3;
+  size_t fill = hash->bytes % 64, len;
+  int i;
+
+  // padding up to 56 mod 64 followed by 64 bit big endian length
+  len = (fill < 56 ? 56 : 120) - fill;
+  for (i = 0; i < 8; i++) {
+    pad[len + 7 - i] = (unsigned char)(bits >> (8 * i));
+  }
+  sha256_write(hash, pad, len + 8);
+
+  for (i = 0; i < 32; i++) {
+    out[i] = (unsigned char)(hash->state[i / 4] >> (24 - 8 * (i % 4)));
+  }
+  secure_erase(hash, sizeof(*hash));
+}
+
+/* Starts BIP340 tagged hash `SHA256(SHA256(tag) || SHA256(tag) || msg)` */
+static inline void
+sha256_init_tagged(sha256_ctx *hash, const unsigned char *tag, size_t taglen)
+{
+  unsigned char taghash[32];
+
+  sha256_init(hash);
+  sha256_write(hash, tag, taglen);
+  sha256_finalize(hash, taghash);
+
+  sha256_init(hash);
+  sha256_write(hash, taghash, sizeof(taghash));
+  sha256_write(hash, taghash, sizeof(taghash));
+}
+
+static inline void
+sha512_init(sha512_ctx *hash)
+{
+  hash->state[0] = 0x6a09e667f3bcc908ULL;
+  hash->state[1] = 0xbb67ae8584caa73bULL;
+  hash->state[2] = 0x3c6ef372fe94f82bULL;
+  hash->state[3] = 0xa54ff53a5f1d36f1ULL;
+  hash->state[4] = 0x510e527fade682d1ULL;
+  hash->state[5] = 0x9b05688c2b3e6c1fULL;
+  hash->state[6] = 0x1f83d9abfb41bd6bULL;
+  hash->state[7] = 0x5be0cd19137e2179ULL;
+  hash->bytes = 0;
+}
+
+static inline void
+sha512_transform(uint64_t *state, const unsigned char *block)
+{
+  uint64_t w[80], a, b, c, d, e, f, g, h, t1, t2;
+  int i, j;
+
+  for (i = 0; i < 16; i++) {
+    w[i] = 0;
+    for (j = 0; j < 8; j++) {
+      w[i] = (w[i] << 8) | block[i * 8 + j];
+    }
+  }
+  for (i = 16; i < 80; i++) {
+    w[i] = (SHA512_ROTR(w[i - 2], 19) ^ SHA512_ROTR(w[i - 2], 61) ^ (w[i - 2] >> 6)) + w[i - 7] +
+           (SHA512_ROTR(w[i - 15], 1) ^ SHA512_ROTR(w[i - 15], 8) ^ (w[i - 15] >> 7)) + w[i - 16];
+  }
+
+  a = state[0]; b = state[1]; c = state[2]; d = state[3];
+  e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+  for (i = 0; i < 80; i++) {
+    t1 = h + (SHA512_ROTR(e, 14) ^ SHA512_ROTR(e, 18) ^ SHA512_ROTR(e, 41)) + ((e & f) ^ (~e & g)) +
+         sha512_k[i] + w[i];
+    t2 = (SHA512_ROTR(a, 28) ^ SHA512_ROTR(a, 34) ^ SHA512_ROTR(a, 39)) + ((a & b) ^ (a & c) ^ (b & c));
+    h = g; g = f; f = e; e = d + t1;
+    d = c; c = b; b = a; a = t1 + t2;
+  }
+
+  state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+  state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+}
+
+static inline void
+sha512_write(sha512_ctx *hash, const unsigned char *data, size_t len)
+{
+  size_t fill = hash->bytes % 128, take;
+
+  hash->bytes += len;
+  while (len > 0) {
+    take = 128 - fill < len ? 128 - fill : len;
+    memcpy(hash->buf + fill, data, take);
+    fill += take;
+    data += take;
+    len -= take;
+    if (fill == 128) {
+      sha512_transform(hash->state, hash->buf);
+      fill = 0;
+    }
+  }
+}
+
+static inline void
+sha512_finalize(sha512_ctx *hash, unsigned char out[64])
+{
+  unsigned char pad[144] = {0x80};
+  uint64_t bits = hash->bytes << 3;
+  size_t fill = hash->bytes % 128, len;
+  int i;
+
+  // padding up to 112 mod 128 followed by 128 bit big endian length
+  len = (fill < 112 ? 112 : 240) - fill;
+  for (i = 0; i < 8; i++) {
+    pad[len + 15 - i] = (unsigned char)(bits >> (8 * i));
+  }
+  sha512_write(hash, pad, len + 16);
+
+  for (i = 0; i < 64; i++) {
+    out[i] = (unsigned char)(hash->state[i / 8] >> (56 - 8 * (i % 8)));
+  }
+  secure_erase(hash, sizeof(*hash));
+}
+
+static inline void
+hmac_sha512_init(hmac_sha512_ctx *hmac, const unsigned char *key, size_t keylen)
+{
+  unsigned char block[128], keyhash[64];
+  int i;
+
+  memset(block, 0, sizeof(block));
+  if (keylen > sizeof(block)) {
+    sha512_init(&hmac->inner);
+    sha512_write(&hmac->inner, key, keylen);
+    sha512_finalize(&hmac->inner, keyhash);
+    memcpy(block, keyhash, sizeof(keyhash));
+  } else {
+    memcpy(block, key, keylen);
+  }
+
+  for (i = 0; i < 128; i++) {
+    block[i] ^= 0x5c;
+  }
+  sha512_init(&hmac->outer);
+  sha512_write(&hmac->outer, block, sizeof(block));
+
+  for (i = 0; i < 128; i++) {
+    block[i] ^= 0x5c ^ 0x36;
+  }
+  sha512_init(&hmac->inner);
+  sha512_write(&hmac->inner, block, sizeof(block));
+
+  secure_erase(block, sizeof(block));
+  secure_erase(keyhash, sizeof(keyhash));
+}
+
+static inline void
+hmac_sha512_write(hmac_sha512_ctx *hmac, const unsigned char *data, size_t len)
+{
+  sha512_write(&hmac->inner, data, len);
+}
+
+static inline void
+hmac_sha512_finalize(hmac_sha512_ctx *hmac, unsigned char out[64])
+{
+  unsigned char inner[64];
+
+  sha512_finalize(&hmac->inner, inner);
+  sha512_write(&hmac->outer, inner, sizeof(inner));
+  sha512_finalize(&hmac->outer, out);
+  secure_erase(inner, sizeof(inner));
+}
+
+#endif
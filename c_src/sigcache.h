@@ -0,0 +1,275 @@
+#include "sha2.h"
+
+/* Cache of successful signature verifications
+ *
+ * Similar in spirit to Bitcoin Core's sigcache. Entries are SHA-256 of a
+ * random salt, the signature, the pubkey and the message, so the cache does
+ * not keep anything usable and its placement can't be predicted by peers
+ * sending crafted signatures. Only valid signatures are stored.
+ *
+ * The table is set associative with SIGCACHE_WAYS entries per bucket, a new
+ * entry goes to an empty way or replaces a pseudo random one. Buckets are
+ * guarded by striped mutexes, the table itself by a rwlock taken exclusively
+ * only when it is resized. The cache is disabled (zero size) until
+ * `sigcache_configure` gives it memory. Every NIF library including this
+ * header has its own cache. Include after utils.h. */
+
+#define SIGCACHE_WAYS 4
+#define SIGCACHE_STRIPES 64
+// Rough speed of allocating and clearing a new table, larger resizes run on dirty scheduler
+#define SIGCACHE_CLEAR_BYTES_PER_US 4096
+
+typedef struct {
+  unsigned char entries[SIGCACHE_WAYS][32];
+} sigcache_bucket;
+
+static struct {
+  ErlNifRWLock *lock;  // guards the table pointer and size
+  ErlNifMutex *stripes[SIGCACHE_STRIPES];
+  sigcache_bucket *buckets;
+  size_t n_buckets;
+  sha256_ctx salted;  // hash state after the salt
+  unsigned long hits, misses, entries;
+} sigcache;
+
+static int
+sigcache_open(void)
+{
+  unsigned char salt[32];
+  int i;
+
+  memset(&sigcache, 0, sizeof(sigcache));
+  if (!fill_random(salt, sizeof(salt))) {
+    return 0;
+  }
+  sha256_init(&sigcache.salted);
+  sha256_write(&sigcache.salted, salt, sizeof(salt));
+  secure_erase(salt, sizeof(salt));
+
+  if (!(sigcache.lock = enif_rwlock_create("secp256k1_sigcache"))) {
+    return 0;
+  }
+  for (i = 0; i < SIGCACHE_STRIPES; i++) {
+    if (!(sigcache.stripes[i] = enif_mutex_create("secp256k1_sigcache_stripe"))) {
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+static void
+sigcache_close(void)
+{
+  int i;
+
+  if (sigcache.buckets) {
+    enif_free(sigcache.buckets);
+  }
+  for (i = 0; i < SIGCACHE_STRIPES; i++) {
+    if (sigcache.stripes[i]) {
+      enif_mutex_destroy(sigcache.stripes[i]);
+    }
+  }
+  if (sigcache.lock) {
+    enif_rwlock_destroy(sigcache.lock);
+  }
+  memset(&sigcache, 0, sizeof(sigcache));
+}
+
+/* Resizes the cache to at most `max_bytes` (dropping all entries), zero
+ * disables it. Returns the size actually used or -1 when out of memory. */
+static long
+sigcache_configure(size_t max_bytes)
+{
+  sigcache_bucket *buckets = NULL;
+  size_t n_buckets = max_bytes / sizeof(sigcache_bucket);
+
+  if (n_buckets > 0) {
+    buckets = enif_alloc(n_buckets * sizeof(sigcache_bucket));
+    if (!buckets) {
+      return -1;
+    }
+    memset(buckets, 0, n_buckets * sizeof(sigcache_bucket));
+  }
+
+  enif_rwlock_rwlock(sigcache.lock);
+  if (sigcache.buckets) {
+    enif_free(sigcache.buckets);
+  }
+  sigcache.buckets = buckets;
+  __atomic_store_n(&sigcache.n_buckets, n_buckets, __ATOMIC_RELAXED);
+  __atomic_store_n(&sigcache.entries, 0, __ATOMIC_RELAXED);
+  enif_rwlock_rwunlock(sigcache.lock);
+
+  return (long)(n_buckets * sizeof(sigcache_bucket));
+}
+
+/* Computes cache entry of the verification, signature and pubkey lengths are
+ * part of the hash so the fields can't be shifted into each other (message is
+ * last so its length is implied) */
+static void
+sigcache_entry(unsigned char *entry32, const unsigned char *sig, size_t sig_len, const unsigned char *pubkey, size_t pubkey_len, const unsigned char *msg, size_t msg_len)
+{
+  sha256_ctx hash = sigcache.salted;
+  unsigned char lengths[2];
+
+  lengths[0] = (unsigned char)sig_len;
+  lengths[1] = (unsigned char)pubkey_len;
+  sha256_write(&hash, lengths, sizeof(lengths));
+  sha256_write(&hash, sig, sig_len);
+  sha256_write(&hash, pubkey, pubkey_len);
+  sha256_write(&hash, msg, msg_len);
+  sha256_finalize(&hash, entry32);
+}
+
+static size_t
+sigcache_bucket_index(const unsigned char *entry32, size_t n_buckets)
+{
+  size_t index = 0;
+  int i;
+
+  for (i = 0; i < 8; i++) {
+    index = index << 8 | entry32[i];
+  }
+
+  return index % n_buckets;
+}
+
+/* Looks the entry up, inserts it when `insert` is set, returns non-zero when
+ * it was already cached */
+static int
+sigcache_access(const unsigned char *entry32, int insert)
+{
+  static const unsigned char empty[32] = {0};
+  sigcache_bucket *bucket;
+  ErlNifMutex *stripe;
+  size_t index;
+  int way, found = 0, free_way = -1;
+
+  enif_rwlock_rlock(sigcache.lock);
+  if (sigcache.n_buckets == 0) {
+    enif_rwlock_runlock(sigcache.lock);
+    return 0;
+  }
+
+  index = sigcache_bucket_index(entry32, sigcache.n_buckets);
+  bucket = &sigcache.buckets[index];
+  stripe = sigcache.stripes[index % SIGCACHE_STRIPES];
+
+  enif_mutex_lock(stripe);
+  for (way = 0; way < SIGCACHE_WAYS; way++) {
+    if (memcmp(bucket->entries[way], entry32, 32) == 0) {
+      found = 1;
+      break;
+    }
+    if (free_way < 0 && memcmp(bucket->entries[way], empty, 32) == 0) {
+      free_way = way;
+    }
+  }
+
+  if (!found && insert) {
+    if (free_way < 0) {
+      free_way = entry32[8] % SIGCACHE_WAYS;
+    } else {
+      __atomic_fetch_add(&sigcache.entries, 1, __ATOMIC_RELAXED);
+    }
+    memcpy(bucket->entries[free_way], entry32, 32);
+  }
+  enif_mutex_unlock(stripe);
+  enif_rwlock_runlock(sigcache.lock);
+
+  if (!insert) {
+    __atomic_fetch_add(found ? &sigcache.hits : &sigcache.misses, 1, __ATOMIC_RELAXED);
+  }
+
+  return found;
+}
+
+/* Returns non-zero when the verification is cached */
+static inline int
+sigcache_contains(const unsigned char *entry32)
+{
+  return sigcache_access(entry32, 0);
+}
+
+/* Remembers successful verification */
+static inline void
+sigcache_insert(const unsigned char *entry32)
+{
+  sigcache_access(entry32, 1);
+}
+
+/* Returns non-zero when the cache is enabled, checked before computing the
+ * entry so disabled cache costs nothing */
+static inline int
+sigcache_enabled(void)
+{
+  return __atomic_load_n(&sigcache.n_buckets, __ATOMIC_RELAXED) > 0;
+}
+
+static ERL_NIF_TERM
+sigcache_stats_map(ErlNifEnv *env)
+{
+  ERL_NIF_TERM map = enif_make_new_map(env);
+  size_t bytes;
+
+  enif_rwlock_rlock(sigcache.lock);
+  bytes = sigcache.n_buckets * sizeof(sigcache_bucket);
+  enif_rwlock_runlock(sigcache.lock);
+
+  enif_make_map_put(env, map, enif_make_atom(env, "hits"),
+    enif_make_uint64(env, __atomic_load_n(&sigcache.hits, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "misses"),
+    enif_make_uint64(env, __atomic_load_n(&sigcache.misses, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "entries"),
+    enif_make_uint64(env, __atomic_load_n(&sigcache.entries, __ATOMIC_RELAXED)), &map);
+  enif_make_map_put(env, map, enif_make_atom(env, "bytes"), enif_make_uint64(env, bytes), &map);
+
+  return map;
+}
+
+// API shared by the modules including the cache
+
+static ERL_NIF_TERM
+resize_sigcache(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifUInt64 max_bytes;
+  long bytes;
+
+  enif_get_uint64(env, argv[0], &max_bytes);
+
+  bytes = sigcache_configure((size_t)max_bytes);
+  if (bytes < 0) {
+    return error_result(env, "enif_alloc failed");
+  }
+
+  return enif_make_tuple2(env, enif_make_atom(env, "ok"), enif_make_uint64(env, (ErlNifUInt64)bytes));
+}
+
+static ERL_NIF_TERM
+configure_sigcache(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  ErlNifUInt64 max_bytes;
+  size_t cost;
+  ERL_NIF_TERM result;
+
+  if (!enif_get_uint64(env, argv[0], &max_bytes) || max_bytes > SIZE_MAX) {
+    return enif_make_badarg(env);
+  }
+
+  cost = (size_t)max_bytes / SIGCACHE_CLEAR_BYTES_PER_US;
+  if (needs_dirty_scheduler(cost)) {
+    return enif_schedule_nif(env, "sigcache_configure", ERL_NIF_DIRTY_JOB_CPU_BOUND, resize_sigcache, argc, argv);
+  }
+
+  result = resize_sigcache(env, argc, argv);
+  consume_timeslice(env, cost);
+  return result;
+}
+
+static ERL_NIF_TERM
+sigcache_stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  return sigcache_stats_map(env);
+}
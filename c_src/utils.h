@@ -1,22 +1,478 @@
+/* nanosleep, `-std=c99` hides it in glibc. BSD and macOS headers expose it by
+ * default and would hide getentropy from random.h under _POSIX_C_SOURCE */
+#if defined(__linux__) && !defined(_POSIX_C_SOURCE)
+#define _POSIX_C_SOURCE 200809L
+#endif
+
 #include <erl_nif.h>
 #include <secp256k1.h>
 #include <string.h>
 #include <assert.h>
+#include <time.h>
 
 #include "random.h"
 
+#ifdef SECP256K1_NIF_SHARED
+#include "core/context.h"
+#endif
+
+/* NIFs should not keep a normal scheduler busy for longer than ~1ms. The
+ * costs below are rough timings of the library primitives in microseconds
+ * and are used to estimate how long a call is going to take. */
+#define TIMESLICE_US 1000
+#define VERIFY_COST_US 60
+#define SIGN_COST_US 50
+#define PARSE_COST_US 5
+#define HASH_BYTES_PER_US 256
+
 static secp256k1_context *ctx = NULL;
 
+/* Per-scheduler contexts
+ *
+ * The base `ctx` is randomized once in `load` and afterwards only read, so it
+ * is safe to share for all public key operations. Operations using the
+ * secret key with the generator (pubkey derivation, signing, nonce
+ * generation) go through `signing_ctx()` instead, which returns a context
+ * owned by the calling thread (normal or dirty scheduler, or a NIF thread)
+ * cloned from `ctx`.
+ *
+ * Every CONTEXT_REFRESH_USES operations the owner flags its slot. The
+ * refresher thread polls the flags every CONTEXT_REFRESH_POLL_MS and prepares
+ * a freshly randomized clone in the background, which the owner swaps in with
+ * a single atomic exchange on one of the following calls. The signing path
+ * takes no lock and never randomizes by itself.
+ *
+ * Threads that exit before unload (see async.c) hand their slot back with
+ * `release_context_slot()` and the next new thread claims it. */
+#ifndef CONTEXT_REFRESH_USES
+#define CONTEXT_REFRESH_USES 1000
+#endif
+
+#ifndef CONTEXT_REFRESH_POLL_MS
+#define CONTEXT_REFRESH_POLL_MS 100
+#endif
+
+typedef struct context_slot {
+  secp256k1_context *active;  // owner thread only
+  secp256k1_context *fresh;   // atomic, refresher -> owner
+  unsigned long uses;         // owner thread only
+  int refresh_requested;      // atomic, owner -> refresher
+  int claimed;                // atomic, set while a thread owns the slot
+  struct context_slot *next;  // immutable once published
+} context_slot;
+
+static ErlNifTSDKey context_slot_key;
+static context_slot *context_slots = NULL;  // atomic list head
+static int refresher_stop = 0;              // atomic
+static ErlNifTid refresher_tid;
+
 static void
-secure_erase(void *ptr, size_t len)
+sleep_us(unsigned long us)
+{
+#if defined(_WIN32)
+  Sleep((DWORD)((us + 999) / 1000));
+#else
+  struct timespec ts;
+
+  ts.tv_sec = us / 1000000;
+  ts.tv_nsec = (long)(us % 1000000) * 1000;
+  nanosleep(&ts, NULL);
+#endif
+}
+
+static secp256k1_context *
+randomized_clone(void)
+{
+  secp256k1_context *clone;
+  unsigned char randomize[32];
+
+  clone = secp256k1_context_clone(ctx);
+  if (!fill_random(randomize, sizeof(randomize)) || !secp256k1_context_randomize(clone, randomize))
+  {
+    secp256k1_context_destroy(clone);
+    clone = NULL;
+  }
+  secure_erase(randomize, sizeof(randomize));
+
+  return clone;
+}
+
+// Claims a slot released by an exited thread
+static context_slot *
+reuse_context_slot(void)
+{
+  context_slot *slot;
+  int unclaimed;
+
+  for (slot = __atomic_load_n(&context_slots, __ATOMIC_ACQUIRE); slot; slot = slot->next)
+  {
+    unclaimed = 0;
+    if (__atomic_compare_exchange_n(&slot->claimed, &unclaimed, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    {
+      return slot;
+    }
+  }
+
+  return NULL;
+}
+
+static context_slot *
+new_context_slot(void)
+{
+  context_slot *slot;
+
+  if ((slot = reuse_context_slot()))
+  {
+    enif_tsd_set(context_slot_key, slot);
+    return slot;
+  }
+
+  slot = enif_alloc(sizeof(context_slot));
+  if (!slot)
+  {
+    return NULL;
+  }
+
+  slot->active = randomized_clone();
+  if (!slot->active)
+  {
+    enif_free(slot);
+    return NULL;
+  }
+  slot->fresh = NULL;
+  slot->uses = 0;
+  slot->refresh_requested = 0;
+  slot->claimed = 1;
+
+  // publish the slot to the refresher
+  slot->next = __atomic_load_n(&context_slots, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&context_slots, &slot->next, slot, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+
+  enif_tsd_set(context_slot_key, slot);
+  return slot;
+}
+
+/* Hands the calling thread's slot back, call before a NIF created thread exits */
+static inline void
+release_context_slot(void)
+{
+  context_slot *slot;
+
+  slot = enif_tsd_get(context_slot_key);
+  if (slot)
+  {
+    enif_tsd_set(context_slot_key, NULL);
+    __atomic_store_n(&slot->claimed, 0, __ATOMIC_RELEASE);
+  }
+}
+
+/* Returns context of the calling thread for secret key operations */
+static inline secp256k1_context *
+signing_ctx(void)
 {
-  volatile unsigned char *p = (volatile unsigned char *)ptr;
-  while (len--)
+  context_slot *slot;
+  secp256k1_context *fresh;
+
+  slot = enif_tsd_get(context_slot_key);
+  if (!slot && !(slot = new_context_slot()))
   {
-    *p++ = 0;
+    // out of memory or entropy, the base context is still safe to use
+    return ctx;
+  }
+
+  fresh = __atomic_exchange_n(&slot->fresh, NULL, __ATOMIC_ACQUIRE);
+  if (fresh)
+  {
+    secp256k1_context_destroy(slot->active);
+    slot->active = fresh;
+    slot->uses = 0;
+    __atomic_store_n(&slot->refresh_requested, 0, __ATOMIC_RELAXED);
+  }
+
+  // picked up by the refresher on its next poll
+  if (++slot->uses % CONTEXT_REFRESH_USES == 0)
+  {
+    __atomic_store_n(&slot->refresh_requested, 1, __ATOMIC_RELAXED);
+  }
+
+  return slot->active;
+}
+
+static void *
+context_refresher(void *arg)
+{
+  context_slot *slot;
+  secp256k1_context *fresh, *expected;
+
+  while (!__atomic_load_n(&refresher_stop, __ATOMIC_ACQUIRE))
+  {
+    for (slot = __atomic_load_n(&context_slots, __ATOMIC_ACQUIRE); slot; slot = slot->next)
+    {
+      if (!__atomic_load_n(&slot->refresh_requested, __ATOMIC_RELAXED) ||
+          __atomic_load_n(&slot->fresh, __ATOMIC_ACQUIRE))
+      {
+        continue;
+      }
+
+      if (!(fresh = randomized_clone()))
+      {
+        continue;
+      }
+
+      expected = NULL;
+      if (!__atomic_compare_exchange_n(&slot->fresh, &expected, fresh, 0, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+      {
+        secp256k1_context_destroy(fresh);
+      }
+    }
+
+    sleep_us(CONTEXT_REFRESH_POLL_MS * 1000UL);
   }
+
+  return NULL;
 }
 
+static int
+start_context_refresher(void)
+{
+  if (enif_tsd_key_create("secp256k1_context_slot", &context_slot_key) != 0)
+  {
+    return -1;
+  }
+
+  if (enif_thread_create("secp256k1_refresher", &refresher_tid, context_refresher, NULL, NULL) != 0)
+  {
+    return -1;
+  }
+
+  return 0;
+}
+
+// Waits at most one poll interval for the refresher to notice
+static void
+stop_context_refresher(void)
+{
+  context_slot *slot, *next;
+
+  __atomic_store_n(&refresher_stop, 1, __ATOMIC_RELEASE);
+  enif_thread_join(refresher_tid, NULL);
+
+  for (slot = context_slots; slot; slot = next)
+  {
+    next = slot->next;
+    secp256k1_context_destroy(slot->active);
+    if (slot->fresh)
+    {
+      secp256k1_context_destroy(slot->fresh);
+    }
+    enif_free(slot);
+  }
+  context_slots = NULL;
+
+  enif_tsd_key_destroy(context_slot_key);
+}
+
+/* Operation statistics
+ *
+ * Every thread calling the NIFs records into its own slot, so recording is a
+ * few relaxed stores without any contention. `stats/0` sums all the slots, the
+ * totals may lag behind a little but a single counter is never torn.
+ *
+ * Latency bucket 0 counts calls faster than 2us, bucket `i` calls taking
+ * [2^i, 2^(i+1)) microseconds, the last bucket everything slower. */
+typedef enum {
+  STATS_PUBKEY,
+  STATS_SIGN,
+  STATS_VERIFY,
+  STATS_VERIFY_BATCH,
+  STATS_ECDH,
+  STATS_RECOVER,
+  STATS_MUSIG_NONCE_GEN,
+  STATS_MUSIG_PARTIAL_SIGN,
+  STATS_MUSIG_PARTIAL_VERIFY,
+  STATS_MUSIG_AGG,
+  STATS_BIP32_DERIVE,
+  STATS_OPS
+} stats_op;
+
+static const char *stats_op_names[STATS_OPS] = {
+  "pubkey",
+  "sign",
+  "verify",
+  "verify_batch",
+  "ecdh",
+  "recover",
+  "musig_nonce_gen",
+  "musig_partial_sign",
+  "musig_partial_verify",
+  "musig_agg",
+  "bip32_derive"
+};
+
+#define STATS_BUCKETS 24
+
+typedef struct stats_slot {
+  unsigned long count[STATS_OPS];
+  unsigned long failed[STATS_OPS];
+  unsigned long latency[STATS_OPS][STATS_BUCKETS];
+  struct stats_slot *next;  // immutable once published
+} stats_slot;
+
+static ErlNifTSDKey stats_slot_key;
+static stats_slot *stats_slots = NULL;  // atomic list head
+
+static stats_slot *
+new_stats_slot(void)
+{
+  stats_slot *slot;
+
+  slot = enif_alloc(sizeof(stats_slot));
+  if (!slot)
+  {
+    return NULL;
+  }
+  memset(slot, 0, sizeof(stats_slot));
+
+  slot->next = __atomic_load_n(&stats_slots, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&stats_slots, &slot->next, slot, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED))
+    ;
+
+  enif_tsd_set(stats_slot_key, slot);
+  return slot;
+}
+
+// only the owner thread writes, relaxed load and store are enough
+static inline void
+stats_add(unsigned long *counter, unsigned long n)
+{
+  __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+/* Returns start time to be passed to `stats_record` */
+static inline ErlNifTime
+stats_start(void)
+{
+  return enif_monotonic_time(ERL_NIF_USEC);
+}
+
+/* Records one operation started at `start`, `ok` is zero for failed calls
+ * and invalid signatures */
+static inline void
+stats_record(stats_op op, ErlNifTime start, int ok)
+{
+  stats_slot *slot;
+  ErlNifTime elapsed;
+  int bucket = 0;
+
+  slot = enif_tsd_get(stats_slot_key);
+  if (!slot && !(slot = new_stats_slot()))
+  {
+    return;
+  }
+
+  elapsed = enif_monotonic_time(ERL_NIF_USEC) - start;
+  while (elapsed >= 2 && bucket < STATS_BUCKETS - 1)
+  {
+    elapsed >>= 1;
+    bucket++;
+  }
+
+  stats_add(&slot->count[op], 1);
+  stats_add(&slot->latency[op][bucket], 1);
+  if (!ok)
+  {
+    stats_add(&slot->failed[op], 1);
+  }
+}
+
+/* Returns map of `op => {count, failed, latency_buckets}` for all operations
+ * recorded by this module */
+static ERL_NIF_TERM
+stats_map(ErlNifEnv *env)
+{
+  stats_slot *slot;
+  unsigned long count[STATS_OPS] = {0}, failed[STATS_OPS] = {0};
+  unsigned long latency[STATS_OPS][STATS_BUCKETS] = {{0}};
+  ERL_NIF_TERM map, buckets[STATS_BUCKETS];
+  int op, i;
+
+  for (slot = __atomic_load_n(&stats_slots, __ATOMIC_ACQUIRE); slot; slot = slot->next)
+  {
+    for (op = 0; op < STATS_OPS; op++)
+    {
+      count[op] += __atomic_load_n(&slot->count[op], __ATOMIC_RELAXED);
+      failed[op] += __atomic_load_n(&slot->failed[op], __ATOMIC_RELAXED);
+      for (i = 0; i < STATS_BUCKETS; i++)
+      {
+        latency[op][i] += __atomic_load_n(&slot->latency[op][i], __ATOMIC_RELAXED);
+      }
+    }
+  }
+
+  map = enif_make_new_map(env);
+  for (op = 0; op < STATS_OPS; op++)
+  {
+    if (!count[op])
+    {
+      continue;
+    }
+
+    for (i = 0; i < STATS_BUCKETS; i++)
+    {
+      buckets[i] = enif_make_uint64(env, latency[op][i]);
+    }
+
+    enif_make_map_put(
+        env, map, enif_make_atom(env, stats_op_names[op]),
+        enif_make_tuple3(env, enif_make_uint64(env, count[op]), enif_make_uint64(env, failed[op]),
+                         enif_make_list_from_array(env, buckets, STATS_BUCKETS)),
+        &map);
+  }
+
+  return map;
+}
+
+static inline ERL_NIF_TERM
+stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
+{
+  return stats_map(env);
+}
+
+static int
+start_stats(void)
+{
+  return enif_tsd_key_create("secp256k1_stats_slot", &stats_slot_key);
+}
+
+static void
+stop_stats(void)
+{
+  stats_slot *slot, *next;
+
+  for (slot = stats_slots; slot; slot = next)
+  {
+    next = slot->next;
+    enif_free(slot);
+  }
+  stats_slots = NULL;
+
+  enif_tsd_key_destroy(stats_slot_key);
+}
+
+#ifdef SECP256K1_NIF_SHARED
+static int
+load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
+{
+  // all modules share the base context owned by the core library
+  ctx = secp256k1_nif_shared_context();
+  if (!ctx || start_stats() != 0)
+  {
+    return -1;
+  }
+  return start_context_refresher();
+}
+#else
 static int
 load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
 {
@@ -30,8 +486,13 @@ load(ErlNifEnv *env, void **priv, ERL_NIF_TERM load_info)
   return_val = secp256k1_context_randomize(ctx, randomize);
   assert(return_val);
   secure_erase(randomize, sizeof(randomize));
-  return 0;
+  if (start_stats() != 0)
+  {
+    return -1;
+  }
+  return start_context_refresher();
 }
+#endif
 
 static int
 upgrade(ErlNifEnv *env, void **priv, void **old_priv, ERL_NIF_TERM load_info)
@@ -42,10 +503,36 @@ upgrade(ErlNifEnv *env, void **priv, void **old_priv, ERL_NIF_TERM load_info)
 static void
 unload(ErlNifEnv *env, void *priv)
 {
+  stop_context_refresher();
+  stop_stats();
+#ifndef SECP256K1_NIF_SHARED
   secp256k1_context_destroy(ctx);
+#endif
   return;
 }
 
+/* Returns non-zero when work of the given cost must be moved off the normal
+ * scheduler the NIF is currently running on */
+static inline int
+needs_dirty_scheduler(size_t cost_us)
+{
+  return cost_us > TIMESLICE_US && enif_thread_type() == ERL_NIF_THR_NORMAL_SCHEDULER;
+}
+
+/* Reports the share of the timeslice used by work of the given cost */
+static inline void
+consume_timeslice(ErlNifEnv *env, size_t cost_us)
+{
+  size_t percent = cost_us * 100 / TIMESLICE_US;
+
+  if (enif_thread_type() != ERL_NIF_THR_NORMAL_SCHEDULER)
+  {
+    return;
+  }
+
+  enif_consume_timeslice(env, percent < 1 ? 1 : (percent > 100 ? 100 : (int)percent));
+}
+
 static ERL_NIF_TERM
 error_result(ErlNifEnv *env, char *error_msg)
 {
@@ -94,6 +94,53 @@ defmodule Secp256k1 do
   @typedoc "ECDH shared secret is 32 bytes long binary"
   @type shared_secret() :: <<_::256>>
 
+  @typedoc """
+  Hash of iodata message computed inside the NIF, plain SHA-256 or BIP340 tagged hash
+  """
+  @type message_hash() :: :sha256 | {:tagged, tag :: binary()}
+
+  @typedoc """
+  Statistics of one operation type
+
+    - `count` number of calls
+    - `failed` number of failed calls, for verification also invalid signatures
+    - `latency` histogram of `{upper_bound_us, calls}` with power of two buckets, empty buckets are
+      left out
+    - `p50_us`, `p99_us` upper bound of the bucket containing the percentile
+  """
+  @type operation_stats() :: %{
+          count: non_neg_integer(),
+          failed: non_neg_integer(),
+          latency: [{pos_integer() | :infinity, pos_integer()}],
+          p50_us: pos_integer() | :infinity,
+          p99_us: pos_integer() | :infinity
+        }
+
+  @typedoc """
+  Statistics collected by the NIFs since they were loaded
+  """
+  @type stats() :: %{
+          operations: %{atom() => operation_stats()},
+          musig_secnonces_live: non_neg_integer(),
+          musig_secnonces_unused: non_neg_integer()
+        }
+
+  @stats_modules [
+    Secp256k1.Async,
+    Secp256k1.BIP32,
+    Secp256k1.ECDH,
+    Secp256k1.ECDSA,
+    Secp256k1.ElligatorSwift,
+    Secp256k1.Extrakeys,
+    Secp256k1.Keyring,
+    Secp256k1.MuSig,
+    Secp256k1.Recovery,
+    Secp256k1.Schnorr
+  ]
+
+  # must match STATS_BUCKETS in c_src/utils.h
+  @stats_buckets 24
+
   @doc """
   Derive pubkey from provided seckey
 
@@ -125,12 +172,54 @@ defmodule Secp256k1 do
 
   Output
     - 2-tuple with seckey on the first place and pubkey on the second place
+
+  Raises `RuntimeError` when the OS entropy source or an allocation fails.
   """
   @spec keypair(type :: pubkey_type()) :: {seckey(), pubkey()}
   def keypair(type) when type in [:xonly, :compressed, :uncompressed] do
-    keypair(:crypto.strong_rand_bytes(32), type)
+    case keypairs(1, type) do
+      <<seckey::binary-size(32), pubkey::binary>> -> {seckey, pubkey}
+      {:error, reason} -> raise reason
+    end
+  end
+
+  @doc """
+  Generate `count` new secp256k1 keypairs in one call
+
+  Seckeys are drawn from the OS CSPRNG inside the NIF in blocks (not one system call per key),
+  candidates which are not valid seckeys are replaced. More than 40 keypairs are generated on
+  dirty CPU scheduler.
+
+  Input
+    - `count` number of keypairs, at most 1_048_576
+    - `type` (see `pubkey/2`)
+
+  Output
+    - binary of packed keypairs, 32 byte seckey followed by the pubkey (32, 33 or 65 bytes
+      depending on `type`) for each keypair
+    - `{:error, reason}` when the OS entropy source or an allocation fails
+
+  ## Examples
+
+      iex> packed = Secp256k1.keypairs(3, :xonly)
+      iex> keypairs = for <<seckey::binary-32, pubkey::binary-32 <- packed>>, do: {seckey, pubkey}
+      iex> length(keypairs)
+      3
+      iex> Enum.all?(keypairs, fn {sk, pk} -> Secp256k1.pubkey(sk, :xonly) == pk end)
+      true
+
+  """
+  @spec keypairs(count :: non_neg_integer(), type :: pubkey_type()) ::
+          binary() | {:error, String.t()}
+  def keypairs(count, type)
+      when is_integer(count) and count >= 0 and type in [:xonly, :compressed, :uncompressed] do
+    Secp256k1.ECDSA.random_keypairs(count, keygen_type(type))
   end
 
+  defp keygen_type(:compressed), do: 0
+  defp keygen_type(:uncompressed), do: 1
+  defp keygen_type(:xonly), do: 2
+
   @doc """
   Generate new secp256k1 keypair from provided seckey
 
@@ -197,4 +286,82 @@ defmodule Secp256k1 do
           pubkey :: xonly_pubkey()
         ) :: boolean()
   defdelegate schnorr_valid?(signature, message, pubkey), to: Secp256k1.Schnorr, as: :valid?
+
+  @doc """
+  Get operation counters and latency histograms collected by the NIFs
+
+  Operations are `:pubkey`, `:sign`, `:verify`, `:verify_batch`, `:ecdh`, `:recover`,
+  `:musig_nonce_gen`, `:musig_partial_sign`, `:musig_partial_verify`, `:musig_agg` and
+  `:bip32_derive`. Only operations which were called at least once are included. All values are
+  cumulative since the NIFs were loaded.
+
+  `musig_secnonces_live` is the number of MuSig secret nonces currently in memory and
+  `musig_secnonces_unused` the number of secret nonces garbage collected without signing, growing
+  values of either usually point to abandoned signing sessions.
+
+  See `Secp256k1.Telemetry` for emitting the stats as `:telemetry` events.
+
+  ## Examples
+
+      iex> {seckey, _pubkey} = Secp256k1.keypair(:xonly)
+      iex> Secp256k1.schnorr_sign(:crypto.hash(:sha256, "stats"), seckey)
+      iex> %{operations: %{sign: %{count: count}}} = Secp256k1.stats()
+      iex> count > 0
+      true
+
+  """
+  @spec stats() :: stats()
+  def stats do
+    raw = Enum.map(@stats_modules, & &1.stats())
+
+    operations =
+      raw
+      |> Enum.flat_map(fn stats -> for {op, {_, _, _} = value} <- stats, do: {op, value} end)
+      |> Enum.group_by(&elem(&1, 0), &elem(&1, 1))
+      |> Map.new(fn {op, values} -> {op, operation_stats(values)} end)
+
+    %{
+      operations: operations,
+      musig_secnonces_live: raw |> Enum.map(&Map.get(&1, :musig_secnonces_live, 0)) |> Enum.sum(),
+      musig_secnonces_unused:
+        raw |> Enum.map(&Map.get(&1, :musig_secnonces_unused, 0)) |> Enum.sum()
+    }
+  end
+
+  # every NIF module counts its own calls, sum them up
+  defp operation_stats(values) do
+    {count, failed, buckets} =
+      Enum.reduce(values, fn {c, f, b}, {count, failed, buckets} ->
+        {count + c, failed + f, Enum.zip_with(b, buckets, &+/2)}
+      end)
+
+    latency =
+      for {calls, index} <- Enum.with_index(buckets), calls > 0, do: {upper_bound(index), calls}
+
+    %{
+      count: count,
+      failed: failed,
+      latency: latency,
+      p50_us: percentile(latency, count * 0.5),
+      p99_us: percentile(latency, count * 0.99)
+    }
+  end
+
+  defp upper_bound(index) when index == @stats_buckets - 1, do: :infinity
+  defp upper_bound(index), do: Integer.pow(2, index + 1)
+
+  defp percentile(latency, rank) do
+    Enum.reduce_while(latency, 0, fn {bound, calls}, seen ->
+      if seen + calls >= rank, do: {:halt, bound}, else: {:cont, seen + calls}
+    end)
+  end
+
+  # tag argument of the iodata NIFs, `nil` for plain SHA-256
+  @doc false
+  def hash_tag(opts) do
+    case Keyword.get(opts, :hash, :sha256) do
+      :sha256 -> nil
+      {:tagged, tag} when is_binary(tag) -> tag
+    end
+  end
 end
@@ -0,0 +1,173 @@
+defmodule Secp256k1.Async do
+  @moduledoc """
+  Module verifying signatures on a native thread pool with results delivered as messages
+
+  Verification jobs are queued and the call returns immediately with a reference, the result is
+  sent to the calling process as `{ref, result}` once a pool thread verifies it. Callers don't
+  block and don't compete for the dirty schedulers.
+
+  The pool is started when the module is loaded, its size is read from the application
+  environment:
+
+      config :lib_secp256k1, Secp256k1.Async,
+        threads: 4,
+        max_queue: 10_000
+
+  `:threads` defaults to `System.schedulers_online/0` and `:max_queue` (maximum number of queued
+  signatures, every item of a list passed to `verify_many/2` counts) to `10_000`. When the queue
+  is full new jobs are rejected with `{:error, "queue full"}`, so producers can back off instead
+  of piling up work. Use `configure/1` to change the pool at runtime.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> msg_hash = :crypto.hash(:sha256, "async")
+      iex> signature = Secp256k1.Schnorr.sign(msg_hash, seckey)
+      iex> {:ok, ref} = Secp256k1.Async.verify(:schnorr, {signature, msg_hash, pubkey})
+      iex> Secp256k1.Async.await(ref)
+      true
+
+  """
+
+  @default_max_queue 10_000
+
+  @typedoc """
+  Signature scheme of the verified items
+  """
+  @type scheme() :: :ecdsa | :schnorr
+
+  @typedoc """
+  Signature, message and pubkey
+
+  ECDSA items are compact signature, 32 byte hash and compressed or uncompressed pubkey, Schnorr
+  items signature, message of any length and xonly pubkey.
+  """
+  @type item() ::
+          {Secp256k1.ecdsa_sig(), Secp256k1.hash(), Secp256k1.pubkey()}
+          | {Secp256k1.schnorr_sig(), binary(), Secp256k1.xonly_pubkey()}
+
+  @typedoc """
+  Pool state
+
+    - `threads` number of running worker threads
+    - `queued` signatures waiting for a worker
+    - `max_queue` queue limit
+    - `completed` and `rejected` cumulative jobs (calls of `verify/2` and `verify_many/2`) since
+      the module was loaded
+  """
+  @type info() :: %{
+          threads: pos_integer(),
+          queued: non_neg_integer(),
+          max_queue: non_neg_integer(),
+          completed: non_neg_integer(),
+          rejected: non_neg_integer()
+        }
+
+  @doc """
+  Queue verification of one signature
+
+  Result is sent to the calling process as `{ref, valid}` with boolean `valid`. Invalid pubkeys
+  are reported as invalid signatures.
+  """
+  @spec verify(scheme :: scheme(), item :: item()) :: {:ok, reference()} | {:error, String.t()}
+  def verify(scheme, item) do
+    ref = make_ref()
+
+    with :ok <- submit_verify(scheme(scheme), item, ref), do: {:ok, ref}
+  end
+
+  @doc """
+  Queue verification of list of signatures as a single job
+
+  Result is sent to the calling process as `{ref, results}` with list of booleans in the order
+  of the items. A list longer than the `:max_queue` limit is always rejected.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> [h1, h2] = for msg <- ["a", "b"], do: :crypto.hash(:sha256, msg)
+      iex> [s1, s2] = for hash <- [h1, h2], do: Secp256k1.ECDSA.sign(hash, seckey)
+      iex> items = [{s1, h1, pubkey}, {s2, h2, pubkey}, {s1, h2, pubkey}]
+      iex> {:ok, ref} = Secp256k1.Async.verify_many(:ecdsa, items)
+      iex> Secp256k1.Async.await(ref)
+      [true, true, false]
+
+  """
+  @spec verify_many(scheme :: scheme(), items :: [item()]) ::
+          {:ok, reference()} | {:error, String.t()}
+  def verify_many(scheme, items) when is_list(items) do
+    ref = make_ref()
+
+    with :ok <- submit_verify_many(scheme(scheme), items, ref), do: {:ok, ref}
+  end
+
+  @doc """
+  Wait for result of the job, returns `{:error, :timeout}` when it doesn't arrive in time
+  """
+  @spec await(ref :: reference(), timeout :: timeout()) ::
+          boolean() | [boolean()] | {:error, :timeout}
+  def await(ref, timeout \\ 5000) when is_reference(ref) do
+    receive do
+      {^ref, result} -> result
+    after
+      timeout -> {:error, :timeout}
+    end
+  end
+
+  @doc """
+  Change the pool
+
+  ## Options
+    - `:threads` - number of worker threads, the pool is restarted when it changes (queued jobs
+      are kept). The restart waits for the jobs being verified and runs on a dirty IO scheduler.
+      If no thread can be started new jobs are rejected with `{:error, "no workers"}` until a
+      later `configure/1` succeeds. Defaults to the last requested number, so a call without it
+      retries a failed start with the same size.
+    - `:max_queue` - queue limit in signatures, lowering it doesn't drop already queued jobs
+  """
+  @spec configure(opts :: [threads: pos_integer(), max_queue: non_neg_integer()]) ::
+          :ok | {:error, String.t()}
+  def configure(opts) when is_list(opts) do
+    # without `:threads` the pool keeps the last requested size, even after a failed start
+    configure_pool(
+      Keyword.get(opts, :threads),
+      Keyword.get(opts, :max_queue, info().max_queue)
+    )
+  end
+
+  @doc """
+  Get current pool state
+  """
+  @spec info() :: info()
+  def info, do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def submit_verify(_scheme, _item, _ref), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def submit_verify_many(_scheme, _items, _ref), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def configure_pool(_threads, _max_queue), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  defp scheme(:ecdsa), do: 0
+  defp scheme(:schnorr), do: 1
+
+  # internal NIF related
+
+  @on_load :load_nifs
+
+  defp load_nifs do
+    config = Application.get_env(:lib_secp256k1, __MODULE__, [])
+    threads = Keyword.get(config, :threads, System.schedulers_online())
+    max_queue = Keyword.get(config, :max_queue, @default_max_queue)
+
+    :lib_secp256k1
+    |> Application.app_dir("priv/async")
+    |> String.to_charlist()
+    |> :erlang.load_nif({threads, max_queue})
+  end
+end
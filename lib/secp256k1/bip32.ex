@@ -0,0 +1,181 @@
+defmodule Secp256k1.BIP32 do
+  @moduledoc """
+  Module implementing BIP32 hierarchical deterministic key derivation
+
+  Extended keys are plain binaries, `xprv` is 32 bytes of chain code followed by 32 bytes of
+  seckey and `xpub` is 32 bytes of chain code followed by 33 bytes of compressed pubkey. Base58
+  serialization (with depth, parent fingerprint and child number) is not part of this module.
+
+  ## Examples
+
+      iex> xprv = Secp256k1.BIP32.master_key(:crypto.strong_rand_bytes(32))
+      iex> xpub = xprv |> Secp256k1.BIP32.derive("m/84'/0'/0'") |> Secp256k1.BIP32.xpub()
+      iex> Secp256k1.BIP32.derive(xpub, "m/0/5") ==
+      ...>   xprv |> Secp256k1.BIP32.derive("m/84'/0'/0'/0/5") |> Secp256k1.BIP32.xpub()
+      true
+
+  """
+
+  import Bitwise
+
+  @hardened 0x80000000
+
+  @typedoc """
+  Extended private key, chain code followed by seckey
+  """
+  @type xprv() :: <<_::512>>
+
+  @typedoc """
+  Extended public key, chain code followed by compressed pubkey
+  """
+  @type xpub() :: <<_::520>>
+
+  @typedoc """
+  Parsed xpub returned by `parent/1`
+  """
+  @opaque parent() :: reference()
+
+  @typedoc """
+  Derivation path, either string like `"m/44'/0'/0'/0"` (`h` is accepted in place of `'`) or list
+  of child indexes (hardened ones `>= 0x80000000`, see `hardened/1`)
+  """
+  @type path() :: String.t() | [non_neg_integer()]
+
+  @doc """
+  Create master xprv from 16 to 64 bytes long seed
+  """
+  @spec master_key(seed :: binary()) :: xprv() | {:error, String.t()}
+  def master_key(_seed), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Derive child extended key at `path`
+
+  Both xprv and xpub are accepted, hardened children can be derived only from xprv.
+  """
+  @spec derive(xkey :: xprv() | xpub(), path :: path()) :: xprv() | xpub() | {:error, String.t()}
+  def derive(xkey, path) when byte_size(xkey) == 64, do: derive_xprv(xkey, parse_path(path))
+  def derive(xkey, path) when byte_size(xkey) == 65, do: derive_xpub(xkey, parse_path(path))
+
+  @doc """
+  Get xpub of xprv
+  """
+  @spec xpub(xprv :: xprv()) :: xpub()
+  def xpub(_xprv), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Parse xpub once for repeated `derive_range/2` calls
+
+  The handle keeps the parsed point and the HMAC state keyed with the chain code.
+  """
+  @spec parent(xpub :: xpub()) :: parent()
+  def parent(_xpub), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Derive compressed pubkeys of non-hardened children in `range` of xpub (or `parent/1` handle)
+
+  All pubkeys are returned packed in a single binary of 33 byte entries, use `unpack/1` to get a
+  list. The (practically impossible) invalid children are left as 33 zero bytes. Large ranges are
+  derived on dirty CPU scheduler.
+
+  The range has to be ascending with step 1 and within non-hardened indexes, otherwise
+  `ArgumentError` is raised.
+
+  ## Examples
+
+      iex> xprv = Secp256k1.BIP32.master_key(:crypto.strong_rand_bytes(32))
+      iex> xpub = Secp256k1.BIP32.xpub(xprv)
+      iex> packed = Secp256k1.BIP32.derive_range(xpub, 0..9)
+      iex> byte_size(packed)
+      330
+      iex> Enum.at(Secp256k1.BIP32.unpack(packed), 7) == binary_part(Secp256k1.BIP32.derive(xpub, [7]), 32, 33)
+      true
+
+  """
+  @spec derive_range(xpub :: xpub() | parent(), range :: Range.t()) :: binary()
+  def derive_range(xpub, first..last//step = range) do
+    cond do
+      step != 1 ->
+        raise ArgumentError, "expected range with step 1, got: #{inspect(range)}"
+
+      first < 0 or first >= @hardened or last >= @hardened ->
+        raise ArgumentError, "range #{inspect(range)} is outside of non-hardened indexes"
+
+      true ->
+        derive_range(xpub, first, max(last - first + 1, 0))
+    end
+  end
+
+  @doc """
+  Split packed pubkeys returned by `derive_range/2` into a list
+  """
+  @spec unpack(packed :: binary()) :: [Secp256k1.compressed_pubkey()]
+  def unpack(packed), do: for(<<pubkey::binary-33 <- packed>>, do: pubkey)
+
+  @doc """
+  Hardened child index
+
+  ## Examples
+
+      iex> Secp256k1.BIP32.hardened(44)
+      0x8000002C
+
+  """
+  @spec hardened(index :: non_neg_integer()) :: non_neg_integer()
+  def hardened(index) when index >= 0 and index < @hardened, do: index ||| @hardened
+
+  @doc """
+  Parse derivation path into list of child indexes
+
+  ## Examples
+
+      iex> Secp256k1.BIP32.parse_path("m/44'/0h/1")
+      [0x8000002C, 0x80000000, 1]
+
+  """
+  @spec parse_path(path :: path()) :: [non_neg_integer()]
+  def parse_path(path) when is_list(path) do
+    Enum.each(path, fn
+      index when is_integer(index) and index >= 0 and index <= 0xFFFFFFFF -> :ok
+      index -> raise ArgumentError, "invalid child index #{inspect(index)}"
+    end)
+
+    path
+  end
+
+  def parse_path("m" <> rest) do
+    rest
+    |> String.split("/", trim: true)
+    |> Enum.map(fn segment ->
+      case Integer.parse(segment) do
+        {index, hard} when hard in ["'", "h", "H"] and index >= 0 and index < @hardened ->
+          hardened(index)
+
+        {index, ""} when index >= 0 and index < @hardened -> index
+        _other -> raise ArgumentError, "invalid path segment #{inspect(segment)}"
+      end
+    end)
+  end
+
+  @doc false
+  def derive_xprv(_xprv, _path), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def derive_xpub(_xpub, _path), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def derive_range(_xpub, _first, _count), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  # internal NIF related
+
+  @on_load :load_nifs
+
+  defp load_nifs do
+    :lib_secp256k1
+    |> Application.app_dir("priv/bip32")
+    |> String.to_charlist()
+    |> :erlang.load_nif(0)
+  end
+end
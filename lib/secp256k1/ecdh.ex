@@ -0,0 +1,122 @@
+defmodule Secp256k1.ECDH do
+  @moduledoc """
+  Module implementing EC Diffie-Hellman key exchange
+
+  ## Examples
+
+      iex> {alice_seckey, alice_pubkey} = Secp256k1.keypair(:compressed)
+      iex> {bob_seckey, bob_pubkey} = Secp256k1.keypair(:compressed)
+      iex> Secp256k1.ECDH.ecdh(alice_seckey, bob_pubkey) == Secp256k1.ECDH.ecdh(bob_seckey, alice_pubkey)
+      true
+
+  """
+
+  @typedoc """
+  Reference to the native keypair created by `keypair/1`
+  """
+  @type keypair() :: reference()
+
+  @typedoc """
+  Output of the shared point
+
+    - `:sha256` (default) - SHA256 hash of the compressed shared point (32 bytes)
+    - `:x` - raw X coordinate of the shared point (32 bytes), used by NIP-04 and NIP-44
+    - `:point` - compressed shared point (33 bytes)
+  """
+  @type hash() :: :sha256 | :x | :point
+
+  @doc """
+  Create reusable keypair from seckey
+
+  Keypair holds already verified seckey in native memory (erased when the keypair is garbage
+  collected). It can be passed to the ECDH functions instead of the seckey.
+  """
+  @spec keypair(seckey :: Secp256k1.seckey()) :: keypair()
+  def keypair(_seckey), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Compute shared secret from own seckey and other party's compressed or uncompressed pubkey
+
+  Shared secret is SHA256 hash of the compressed shared point
+  """
+  @spec ecdh(seckey :: Secp256k1.seckey() | keypair(), pubkey :: Secp256k1.pubkey()) ::
+          Secp256k1.shared_secret()
+  def ecdh(_seckey, _pubkey), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Compute shared secret with selected output
+
+  ## Options
+    - `:hash` - output of the shared point, see `t:hash/0`
+
+  ## Examples
+
+      iex> {alice_seckey, alice_pubkey} = Secp256k1.keypair(:compressed)
+      iex> {bob_seckey, bob_pubkey} = Secp256k1.keypair(:compressed)
+      iex> point = Secp256k1.ECDH.ecdh(alice_seckey, bob_pubkey, hash: :point)
+      iex> Secp256k1.ECDH.ecdh(bob_seckey, alice_pubkey, hash: :x) == binary_part(point, 1, 32)
+      true
+
+  """
+  @spec ecdh(
+          seckey :: Secp256k1.seckey() | keypair(),
+          pubkey :: Secp256k1.pubkey(),
+          opts :: [hash: hash()]
+        ) :: binary()
+  def ecdh(seckey, pubkey, opts), do: ecdh_mode(seckey, pubkey, mode(opts))
+
+  @doc """
+  Compute shared secrets of one seckey with many pubkeys in a single call
+
+  Pubkeys are either list of compressed or uncompressed pubkeys, returning list of secrets with
+  `nil` for invalid pubkeys, or binary of packed compressed pubkeys (33 bytes each), returning
+  packed secrets with invalid pubkeys left as zero bytes. Accepts the same options as `ecdh/3`.
+  More than 25 pubkeys are processed on dirty CPU scheduler.
+
+  ## Examples
+
+      iex> {seckey, _} = Secp256k1.keypair(:compressed)
+      iex> server = Secp256k1.ECDH.keypair(seckey)
+      iex> peers = for _ <- 1..3, do: elem(Secp256k1.keypair(:compressed), 1)
+      iex> Secp256k1.ECDH.ecdh_many(server, peers) == Enum.map(peers, &Secp256k1.ECDH.ecdh(seckey, &1))
+      true
+      iex> Secp256k1.ECDH.ecdh_many(server, Enum.join(peers), hash: :x) |> byte_size()
+      96
+
+  """
+  @spec ecdh_many(
+          seckey :: Secp256k1.seckey() | keypair(),
+          pubkeys :: [Secp256k1.pubkey()] | binary(),
+          opts :: [hash: hash()]
+        ) :: [binary() | nil] | binary()
+  def ecdh_many(seckey, pubkeys, opts \\ []), do: ecdh_batch(seckey, pubkeys, mode(opts))
+
+  @doc false
+  def ecdh_mode(_seckey, _pubkey, _mode), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def ecdh_batch(_seckey, _pubkeys, _mode), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  # output modes of the native ECDH
+  defp mode(opts) do
+    case Keyword.get(opts, :hash, :sha256) do
+      :sha256 -> 0
+      :x -> 1
+      :point -> 2
+    end
+  end
+
+  # internal NIF related
+
+  @on_load :load_nifs
+
+  defp load_nifs do
+    :lib_secp256k1
+    |> Application.app_dir("priv/ecdh")
+    |> String.to_charlist()
+    |> :erlang.load_nif(0)
+  end
+end
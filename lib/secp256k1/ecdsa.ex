@@ -3,8 +3,29 @@ defmodule Secp256k1.ECDSA do
   Module implementing ECDSA pubkey derivation and signatures
   """
 
+  import Bitwise
   import Secp256k1.Guards
 
+  @typedoc """
+  Reference to the native keypair created by `keypair/1`
+  """
+  @type keypair() :: reference()
+
+  @typedoc """
+  DER encoded signature (at most 72 bytes when strictly encoded)
+  """
+  @type der_sig() :: binary()
+
+  @typedoc """
+  Options of signature parsing
+
+    - `:der` - parse the signature as DER even when it is 64 bytes long (otherwise 64 byte
+      signature is compact and any other size is DER)
+    - `:lax` - accept DER encodings which are not valid under BIP66 (implies `:der`)
+    - `:normalize` - convert high-S signature to low-S before verifying
+  """
+  @type sig_opts() :: [der: boolean(), lax: boolean(), normalize: boolean()]
+
   @doc """
   Derive pubkey from seckey
 
@@ -55,6 +76,25 @@ defmodule Secp256k1.ECDSA do
           Secp256k1.uncompressed_pubkey()
   def decompress_pubkey(_pubkey), do: :erlang.nif_error({:error, :not_loaded})
 
+  @doc """
+  Create reusable keypair from seckey
+
+  Keypair holds already verified seckey in native memory (erased when the keypair is garbage
+  collected). It can be passed to `sign/2` and `sign/3` instead of the seckey.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> keypair = Secp256k1.ECDSA.keypair(seckey)
+      iex> msg_hash = :crypto.hash(:sha256, "hello")
+      iex> signature = Secp256k1.ECDSA.sign(msg_hash, keypair)
+      iex> Secp256k1.ECDSA.valid?(signature, msg_hash, pubkey)
+      true
+
+  """
+  @spec keypair(seckey :: Secp256k1.seckey()) :: keypair()
+  def keypair(_seckey), do: :erlang.nif_error({:error, :not_loaded})
+
   @doc """
   Generate ECDSA signature of message hash (AUX is randomly generated)
 
@@ -67,9 +107,10 @@ defmodule Secp256k1.ECDSA do
       64
 
   """
-  @spec sign(msg_hash :: Secp256k1.hash(), seckey :: Secp256k1.seckey()) ::
+  @spec sign(msg_hash :: Secp256k1.hash(), seckey :: Secp256k1.seckey() | keypair()) ::
           Secp256k1.ecdsa_sig()
-  def sign(msg_hash, seckey) when is_hash(msg_hash) and is_seckey(seckey) do
+  def sign(msg_hash, seckey)
+      when is_hash(msg_hash) and (is_seckey(seckey) or is_reference(seckey)) do
     sign(msg_hash, seckey, :crypto.strong_rand_bytes(32))
   end
 
@@ -78,7 +119,7 @@ defmodule Secp256k1.ECDSA do
   """
   @spec sign(
           msg_hash :: Secp256k1.hash(),
-          seckey :: Secp256k1.seckey(),
+          seckey :: Secp256k1.seckey() | keypair(),
           aux :: <<_::256>>
         ) :: Secp256k1.ecdsa_sig()
   def sign(_msg_hash, _seckey, _aux), do: :erlang.nif_error({:error, :not_loaded})
@@ -86,6 +127,8 @@ defmodule Secp256k1.ECDSA do
   @doc """
   Check if ECDSA signature is valid
 
+  Signature is either 64 bytes compact or strict DER, see `valid?/4` for the other encodings.
+
   ## Examples
 
       iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
@@ -96,12 +139,229 @@ defmodule Secp256k1.ECDSA do
 
   """
   @spec valid?(
-          signature :: Secp256k1.ecdsa_sig(),
+          signature :: Secp256k1.ecdsa_sig() | der_sig(),
           msg_hash :: Secp256k1.hash(),
           pubkey :: Secp256k1.compressed_pubkey()
         ) :: boolean()
   def valid?(_signature, _msg_hash, _pubkey), do: :erlang.nif_error({:error, :not_loaded})
 
+  @doc """
+  Check if ECDSA signature is valid, with parsing options (see `t:sig_opts/0`)
+
+  Historical signatures can be verified without converting them first, libsecp256k1 accepts only
+  low-S signatures so those need `normalize: true`.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> msg_hash = :crypto.hash(:sha256, "hello")
+      iex> der = msg_hash |> Secp256k1.ECDSA.sign(seckey) |> Secp256k1.ECDSA.serialize_der()
+      iex> Secp256k1.ECDSA.valid?(der, msg_hash, pubkey, lax: true, normalize: true)
+      true
+
+  """
+  @spec valid?(
+          signature :: Secp256k1.ecdsa_sig() | der_sig(),
+          msg_hash :: Secp256k1.hash(),
+          pubkey :: Secp256k1.compressed_pubkey(),
+          opts :: sig_opts()
+        ) :: boolean()
+  def valid?(signature, msg_hash, pubkey, opts) do
+    verify_flags(signature, msg_hash, pubkey, sig_flags(opts))
+  end
+
+  @doc """
+  Check list of ECDSA signatures in a single call
+
+  Takes list of `{signature, msg_hash, pubkey}` tuples (pubkey can be compressed or uncompressed)
+  and returns bitstring with one bit per entry - `1` when the signature is valid, `0` otherwise.
+  Signatures are parsed the same way as in `valid?/4` with the `opts`. Lists longer than 16 items
+  are verified on a dirty CPU scheduler.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> msg_hash = :crypto.hash(:sha256, "hello")
+      iex> signature = Secp256k1.ECDSA.sign(msg_hash, seckey)
+      iex> other_hash = :crypto.hash(:sha256, "world")
+      iex> Secp256k1.ECDSA.valid_many([{signature, msg_hash, pubkey}, {signature, other_hash, pubkey}])
+      <<1::1, 0::1>>
+
+  """
+  @spec valid_many(
+          [
+            {signature :: Secp256k1.ecdsa_sig() | der_sig(), msg_hash :: Secp256k1.hash(),
+             pubkey :: Secp256k1.compressed_pubkey() | Secp256k1.uncompressed_pubkey()}
+          ],
+          opts :: sig_opts()
+        ) :: bitstring()
+  def valid_many(items, opts \\ []) when is_list(items) do
+    size = length(items)
+    <<result::bitstring-size(size), _padding::bitstring>> = verify_many(items, sig_flags(opts))
+    result
+  end
+
+  @doc """
+  Parse DER signature into compact one
+
+  ## Options
+    - `:lax` (default false) - accept DER encodings which are not valid under BIP66 (excess
+      padding, wrong lengths, trailing data). Out of range values parse into invalid signature
+      which never verifies.
+
+  ## Examples
+
+      iex> {seckey, _} = Secp256k1.keypair(:compressed)
+      iex> signature = Secp256k1.ECDSA.sign(:crypto.hash(:sha256, "hello"), seckey)
+      iex> der = Secp256k1.ECDSA.serialize_der(signature)
+      iex> Secp256k1.ECDSA.parse_der(der) == signature
+      true
+
+  """
+  @spec parse_der(der :: der_sig(), opts :: [lax: boolean()]) ::
+          Secp256k1.ecdsa_sig() | {:error, String.t()}
+  def parse_der(der, opts \\ []), do: parse_der_sig(der, Keyword.get(opts, :lax, false))
+
+  @doc """
+  Serialize compact signature as DER
+  """
+  @spec serialize_der(signature :: Secp256k1.ecdsa_sig()) :: der_sig() | {:error, String.t()}
+  def serialize_der(_signature), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Convert compact signature to its low-S form (unchanged when already low-S)
+
+  ## Examples
+
+      iex> {seckey, _} = Secp256k1.keypair(:compressed)
+      iex> signature = Secp256k1.ECDSA.sign(:crypto.hash(:sha256, "hello"), seckey)
+      iex> Secp256k1.ECDSA.normalize(signature) == signature
+      true
+
+  """
+  @spec normalize(signature :: Secp256k1.ecdsa_sig()) ::
+          Secp256k1.ecdsa_sig() | {:error, String.t()}
+  def normalize(_signature), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Parse list of DER signatures in a single call, invalid ones are returned as `nil`
+
+  Accepts the same options as `parse_der/2`. Lists longer than 200 items are parsed on a dirty CPU
+  scheduler, the same applies to the other batch conversions.
+  """
+  @spec parse_der_many(ders :: [der_sig()], opts :: [lax: boolean()]) ::
+          [Secp256k1.ecdsa_sig() | nil]
+  def parse_der_many(ders, opts \\ []) when is_list(ders) do
+    convert_many(ders, if(Keyword.get(opts, :lax, false), do: :parse_der_lax, else: :parse_der))
+  end
+
+  @doc """
+  Serialize list of compact signatures as DER, invalid ones are returned as `nil`
+  """
+  @spec serialize_der_many(signatures :: [Secp256k1.ecdsa_sig()]) :: [der_sig() | nil]
+  def serialize_der_many(signatures) when is_list(signatures),
+    do: convert_many(signatures, :serialize_der)
+
+  @doc """
+  Convert list of compact signatures to low-S form, invalid ones are returned as `nil`
+  """
+  @spec normalize_many(signatures :: [Secp256k1.ecdsa_sig()]) :: [Secp256k1.ecdsa_sig() | nil]
+  def normalize_many(signatures) when is_list(signatures),
+    do: convert_many(signatures, :normalize)
+
+  @doc """
+  Hash iodata message and sign the hash in a single NIF call
+
+  The message is hashed inside the NIF without flattening it, long messages are hashed in chunks
+  yielding to the scheduler in between. The signature is the same as `sign/2` of the message hash.
+
+  ## Options
+    - `:hash` - `:sha256` (default) or `{:tagged, tag}` for BIP340 tagged hash
+    - `:aux` - AUX value (randomly generated by default) - NOT RECOMMENDED
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> signature = Secp256k1.ECDSA.sign_message(["hello", 32, ["world"]], seckey)
+      iex> Secp256k1.ECDSA.valid?(signature, :crypto.hash(:sha256, "hello world"), pubkey)
+      true
+
+  """
+  @spec sign_message(
+          message :: iodata(),
+          seckey :: Secp256k1.seckey() | keypair(),
+          opts :: [hash: Secp256k1.message_hash(), aux: <<_::256>>]
+        ) :: Secp256k1.ecdsa_sig()
+  def sign_message(message, seckey, opts \\ []) do
+    aux = Keyword.get_lazy(opts, :aux, fn -> :crypto.strong_rand_bytes(32) end)
+    sign_iodata(message, seckey, aux, Secp256k1.hash_tag(opts))
+  end
+
+  @doc """
+  Hash iodata message and check the ECDSA signature of the hash in a single NIF call
+
+  Accepts the same `:hash` option as `sign_message/3`.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> signature = Secp256k1.ECDSA.sign_message("hello world", seckey, hash: {:tagged, "app"})
+      iex> Secp256k1.ECDSA.valid_message?(signature, ["hello", " world"], pubkey, hash: {:tagged, "app"})
+      true
+
+  """
+  @spec valid_message?(
+          signature :: Secp256k1.ecdsa_sig(),
+          message :: iodata(),
+          pubkey :: Secp256k1.compressed_pubkey(),
+          opts :: [hash: Secp256k1.message_hash()]
+        ) :: boolean()
+  def valid_message?(signature, message, pubkey, opts \\ []) do
+    verify_iodata(signature, message, pubkey, Secp256k1.hash_tag(opts))
+  end
+
+  @doc false
+  def verify_flags(_signature, _msg_hash, _pubkey, _flags),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def random_keypairs(_count, _type), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def verify_many(_items, _flags), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def parse_der_sig(_der, _lax), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def convert_many(_signatures, _op), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def sign_iodata(_message, _seckey, _aux, _tag), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def verify_iodata(_signature, _message, _pubkey, _tag),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def sigcache_configure(_max_bytes), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def sigcache_stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  # flags of the native signature parsing
+  defp sig_flags(opts) do
+    Enum.reduce(opts, 0, fn
+      {:der, true}, flags -> flags ||| 1
+      {:lax, true}, flags -> flags ||| 2
+      {:normalize, true}, flags -> flags ||| 4
+      {_key, _value}, flags -> flags
+    end)
+  end
+
   # internal NIF related
 
   @on_load :load_nifs
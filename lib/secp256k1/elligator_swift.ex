@@ -0,0 +1,87 @@
+defmodule Secp256k1.ElligatorSwift do
+  @moduledoc """
+  Module implementing ElligatorSwift pubkey encoding and x-only ECDH used by BIP324 v2 transport
+
+  ElligatorSwift encodes pubkey as 64 bytes which are indistinguishable from random. Encoding is
+  randomized (with randomness generated inside the NIF) so the same pubkey has many encodings,
+  but every one of them decodes back to it.
+
+  ## Examples
+
+      iex> {alice_seckey, _} = Secp256k1.keypair(:compressed)
+      iex> {bob_seckey, _} = Secp256k1.keypair(:compressed)
+      iex> alice_ell = Secp256k1.ElligatorSwift.create(alice_seckey)
+      iex> bob_ell = Secp256k1.ElligatorSwift.create(bob_seckey)
+      iex> Secp256k1.ElligatorSwift.xdh(alice_ell, bob_ell, alice_seckey, :initiator) ==
+      ...>   Secp256k1.ElligatorSwift.xdh(alice_ell, bob_ell, bob_seckey, :responder)
+      true
+
+  """
+
+  @typedoc """
+  64 bytes long ElligatorSwift encoding of pubkey
+  """
+  @type ellswift() :: <<_::512>>
+
+  @typedoc """
+  Side of the BIP324 handshake, initiator sends its encoding first
+  """
+  @type party() :: :initiator | :responder
+
+  @doc """
+  Create ElligatorSwift encoding of seckey's pubkey
+
+  Faster than `encode/1` of the derived pubkey.
+  """
+  @spec create(seckey :: Secp256k1.seckey()) :: ellswift()
+  def create(_seckey), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Encode compressed or uncompressed pubkey
+
+  ## Examples
+
+      iex> {_, pubkey} = Secp256k1.keypair(:compressed)
+      iex> ell = Secp256k1.ElligatorSwift.encode(pubkey)
+      iex> Secp256k1.ElligatorSwift.decode(ell) == pubkey
+      true
+
+  """
+  @spec encode(pubkey :: Secp256k1.pubkey()) :: ellswift()
+  def encode(_pubkey), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Decode any 64 bytes into compressed pubkey
+  """
+  @spec decode(ellswift :: <<_::512>>) :: Secp256k1.compressed_pubkey()
+  def decode(_ellswift), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Compute BIP324 shared secret
+
+  `ell_a` is the initiator's encoding and `ell_b` the responder's one (in this order on both
+  sides), `seckey` is own seckey and `party` own side of the handshake. Shared secret is the
+  BIP324 tagged hash of both encodings and the shared x coordinate.
+  """
+  @spec xdh(ell_a :: ellswift(), ell_b :: ellswift(), seckey :: Secp256k1.seckey(), party()) ::
+          Secp256k1.shared_secret()
+  def xdh(ell_a, ell_b, seckey, :initiator), do: bip324_xdh(ell_a, ell_b, seckey, 0)
+  def xdh(ell_a, ell_b, seckey, :responder), do: bip324_xdh(ell_a, ell_b, seckey, 1)
+
+  @doc false
+  def bip324_xdh(_ell_a, _ell_b, _seckey, _party), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  # internal NIF related
+
+  @on_load :load_nifs
+
+  defp load_nifs do
+    :lib_secp256k1
+    |> Application.app_dir("priv/ellswift")
+    |> String.to_charlist()
+    |> :erlang.load_nif(0)
+  end
+end
@@ -3,6 +3,11 @@ defmodule Secp256k1.Extrakeys do
   Module implementing extrakeys functions of secp256k1
   """
 
+  @typedoc """
+  Parity of Y coordinate of the full pubkey, `0` for even and `1` for odd
+  """
+  @type parity() :: 0 | 1
+
   @doc """
   Derive xonly pubkey from seckey
 
@@ -17,6 +22,106 @@ defmodule Secp256k1.Extrakeys do
   @spec xonly_pubkey(Secp256k1.seckey()) :: Secp256k1.xonly_pubkey()
   def xonly_pubkey(_seckey), do: :erlang.nif_error({:error, :not_loaded})
 
+  @doc """
+  Convert compressed or uncompressed pubkey to xonly pubkey and parity of its Y coordinate
+  """
+  @spec xonly_from_pubkey(pubkey :: Secp256k1.pubkey()) :: {Secp256k1.xonly_pubkey(), parity()}
+  def xonly_from_pubkey(_pubkey), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Add tweak to xonly pubkey, returns xonly output key and its parity
+
+  ## Examples
+
+      iex> {seckey, _} = Secp256k1.keypair(:compressed)
+      iex> internal = Secp256k1.Extrakeys.xonly_pubkey(seckey)
+      iex> tweak = :crypto.strong_rand_bytes(32)
+      iex> {output, parity} = Secp256k1.Extrakeys.tweak_add(internal, tweak)
+      iex> Secp256k1.Extrakeys.tweak_add_check(output, parity, internal, tweak)
+      true
+
+  """
+  @spec tweak_add(internal :: Secp256k1.xonly_pubkey(), tweak :: <<_::256>>) ::
+          {Secp256k1.xonly_pubkey(), parity()}
+  def tweak_add(_internal, _tweak), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Check that output key with parity is internal key tweaked with tweak
+  """
+  @spec tweak_add_check(
+          output :: Secp256k1.xonly_pubkey(),
+          parity :: parity(),
+          internal :: Secp256k1.xonly_pubkey(),
+          tweak :: <<_::256>>
+        ) :: boolean()
+  def tweak_add_check(_output, _parity, _internal, _tweak),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Add tweaks to list of `{internal, tweak}` xonly pubkeys in a single call
+
+  Returns `{output, parity}` for every entry, `nil` for invalid ones. Lists longer than 50 items
+  are processed on dirty CPU scheduler.
+  """
+  @spec tweak_add_many([{internal :: Secp256k1.xonly_pubkey(), tweak :: <<_::256>>}]) ::
+          [{Secp256k1.xonly_pubkey(), parity()} | nil]
+  def tweak_add_many(items) when is_list(items), do: output_keys(items, false)
+
+  @doc """
+  Tweak seckey so it matches the output key of `tweak_add/2` of its xonly pubkey
+  """
+  @spec tweak_seckey(seckey :: Secp256k1.seckey(), tweak :: <<_::256>>) :: Secp256k1.seckey()
+  def tweak_seckey(seckey, tweak), do: seckey_tweak(seckey, tweak, nil)
+
+  @doc """
+  Compute BIP341 taproot output key of internal key and optional script tree merkle root
+
+  ## Examples
+
+      iex> {seckey, _} = Secp256k1.keypair(:compressed)
+      iex> internal = Secp256k1.Extrakeys.xonly_pubkey(seckey)
+      iex> {output, _parity} = Secp256k1.Extrakeys.taproot_output_key(internal)
+      iex> Secp256k1.Extrakeys.xonly_pubkey(Secp256k1.Extrakeys.taproot_seckey(seckey)) == output
+      true
+
+  """
+  @spec taproot_output_key(
+          internal :: Secp256k1.xonly_pubkey(),
+          merkle_root :: <<_::256>> | nil
+        ) :: {Secp256k1.xonly_pubkey(), parity()}
+  def taproot_output_key(internal, merkle_root \\ nil), do: taproot_output(internal, merkle_root)
+
+  @doc """
+  Compute BIP341 taproot output keys of list of internal keys in a single call
+
+  Entries are internal keys or `{internal, merkle_root}` tuples. Returns `{output, parity}` for
+  every entry, `nil` for invalid ones. Lists longer than 50 items are processed on dirty CPU
+  scheduler.
+  """
+  @spec taproot_output_keys([
+          Secp256k1.xonly_pubkey() | {Secp256k1.xonly_pubkey(), <<_::256>> | nil}
+        ]) :: [{Secp256k1.xonly_pubkey(), parity()} | nil]
+  def taproot_output_keys(items) when is_list(items), do: output_keys(items, true)
+
+  @doc """
+  Tweak seckey for BIP341 key path spending of its taproot output key
+  """
+  @spec taproot_seckey(seckey :: Secp256k1.seckey(), merkle_root :: <<_::256>> | nil) ::
+          Secp256k1.seckey()
+  def taproot_seckey(seckey, merkle_root \\ nil), do: seckey_tweak(seckey, nil, merkle_root)
+
+  @doc false
+  def seckey_tweak(_seckey, _tweak, _merkle_root), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def taproot_output(_internal, _merkle_root), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def output_keys(_items, _taproot), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
   # internal NIF related
 
   @on_load :load_nifs
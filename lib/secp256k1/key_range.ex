@@ -0,0 +1,212 @@
+defmodule Secp256k1.KeyRange do
+  @moduledoc """
+  Module walking ranges of consecutive seckeys (`seckey`, `seckey + 1`, `seckey + 2`, ...)
+
+  Each next pubkey is derived from the previous one by a single point addition instead of full
+  pubkey derivation, which makes bulk address pre-generation and vanity key search several times
+  faster than calling `Secp256k1.pubkey/2` in a loop.
+
+  ## Examples
+
+      iex> seckey = <<1::256>>
+      iex> [p1, p2, p3] = Secp256k1.KeyRange.pubkeys(seckey, 3)
+      iex> p3 == Secp256k1.pubkey(<<3::256>>, :compressed)
+      true
+      iex> {p1, p2} == {Secp256k1.pubkey(<<1::256>>, :compressed), Secp256k1.pubkey(<<2::256>>, :compressed)}
+      true
+
+  """
+
+  import Secp256k1.Guards
+
+  @bech32_charset ~c"qpzry9x8gf2tvdw0s3jn54khce6mua7l"
+  @max_uint64 0xFFFFFFFFFFFFFFFF
+
+  @typedoc """
+  Handle of running grind, the grind is stopped when the handle is garbage collected
+  """
+  @opaque grinder() :: reference()
+
+  @typedoc """
+  Pubkey type produced by the range
+  """
+  @type type() :: :compressed | :xonly
+
+  @typedoc """
+  Grind options
+
+  - `:prefix` - bitstring the serialized pubkey has to start with (required)
+  - `:type` - `:xonly` (default) or `:compressed`, the pubkey serialization matched by prefix
+  - `:threads` - number of native threads (default `System.schedulers_online/0`)
+  - `:count` - number of keys to try (default unlimited)
+  - `:limit` - stop after that many matches (default `0` - unlimited)
+  - `:ref` - reference tagging the messages (default `make_ref/0`)
+  """
+  @type grind_opt() ::
+          {:prefix, bitstring()}
+          | {:type, type()}
+          | {:threads, pos_integer()}
+          | {:count, non_neg_integer()}
+          | {:limit, non_neg_integer()}
+          | {:ref, reference()}
+
+  @doc """
+  Derive pubkeys of `count` consecutive seckeys starting with `seckey`
+
+  Large ranges are derived on dirty CPU scheduler.
+  """
+  @spec pubkeys(seckey :: Secp256k1.seckey(), count :: non_neg_integer(), type :: type()) ::
+          [Secp256k1.compressed_pubkey() | Secp256k1.xonly_pubkey()] | {:error, String.t()}
+  def pubkeys(seckey, count, type \\ :compressed)
+      when is_seckey(seckey) and is_integer(count) and count >= 0 and
+             type in [:compressed, :xonly] do
+    range_pubkeys(seckey, count, type == :xonly)
+  end
+
+  @doc """
+  Start searching seckeys from `seckey` upwards whose pubkey starts with the `:prefix`
+
+  Keys are tried by `:threads` native threads, every match is sent to the calling process as
+  `{ref, {:match, seckey, pubkey}}` as soon as it is found. When all threads finish (range
+  exhausted, `:limit` reached or `stop/1` called) `{ref, {:done, tried}}` is sent with the number
+  of keys tried. The grind runs only while the returned handle is referenced.
+
+  Prefix is matched against the serialized pubkey bits, use `hex_prefix/1` or `npub_prefix/1` to
+  build it. Other address formats can be searched by streaming `pubkeys/3` ranges.
+
+  ## Examples
+
+      iex> {:ok, ref, grinder} = Secp256k1.KeyRange.grind(<<1::256>>, prefix: <<0b1::1>>, limit: 1)
+      iex> receive do
+      ...>   {^ref, {:match, seckey, pubkey}} -> Secp256k1.pubkey(seckey, :xonly) == pubkey
+      ...> end
+      true
+      iex> Secp256k1.KeyRange.stop(grinder)
+      :ok
+
+  """
+  @spec grind(seckey :: Secp256k1.seckey(), opts :: [grind_opt()]) ::
+          {:ok, reference(), grinder()} | {:error, String.t()}
+  def grind(seckey, opts) when is_seckey(seckey) and is_list(opts) do
+    prefix = Keyword.fetch!(opts, :prefix)
+    type = Keyword.get(opts, :type, :xonly)
+    threads = Keyword.get(opts, :threads, System.schedulers_online())
+    count = Keyword.get(opts, :count, @max_uint64)
+    limit = Keyword.get(opts, :limit, 0)
+    ref = Keyword.get_lazy(opts, :ref, &make_ref/0)
+
+    padding = rem(8 - rem(bit_size(prefix), 8), 8)
+
+    case start_grind(
+           seckey,
+           <<prefix::bitstring, 0::size(padding)>>,
+           bit_size(prefix),
+           type == :xonly,
+           threads,
+           count,
+           limit,
+           ref
+         ) do
+      {:error, reason} -> {:error, reason}
+      grinder -> {:ok, ref, grinder}
+    end
+  end
+
+  @doc """
+  Stop running grind, `{ref, {:done, tried}}` message is still sent
+  """
+  @spec stop(grinder :: grinder()) :: :ok
+  def stop(_grinder), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Grind and wait for the result, returns `{matches, tried}`
+
+  Accepts the same options as `grind/2` plus `:timeout` in milliseconds (default `:infinity`),
+  after which the grind is stopped and the matches found so far are returned.
+  """
+  @spec find(seckey :: Secp256k1.seckey(), opts :: [grind_opt() | {:timeout, timeout()}]) ::
+          {[{Secp256k1.seckey(), Secp256k1.compressed_pubkey() | Secp256k1.xonly_pubkey()}],
+           non_neg_integer()}
+          | {:error, String.t()}
+  def find(seckey, opts) do
+    timeout = Keyword.get(opts, :timeout, :infinity)
+
+    with {:ok, ref, grinder} <- grind(seckey, opts) do
+      deadline = if timeout == :infinity, do: :infinity, else: now() + timeout
+      collect(ref, grinder, deadline, [])
+    end
+  end
+
+  defp collect(ref, grinder, deadline, acc) do
+    receive do
+      {^ref, {:match, seckey, pubkey}} ->
+        collect(ref, grinder, deadline, [{seckey, pubkey} | acc])
+
+      {^ref, {:done, tried}} ->
+        {Enum.reverse(acc), tried}
+    after
+      remaining(deadline) ->
+        :ok = stop(grinder)
+        collect(ref, grinder, :infinity, acc)
+    end
+  end
+
+  defp now, do: System.monotonic_time(:millisecond)
+
+  defp remaining(:infinity), do: :infinity
+  defp remaining(deadline), do: max(deadline - now(), 0)
+
+  @doc """
+  Prefix matching hex encoded pubkey starting with `hex`
+
+  ## Examples
+
+      iex> Secp256k1.KeyRange.hex_prefix("02ab")
+      <<0x02, 0xAB>>
+
+      iex> Secp256k1.KeyRange.hex_prefix("abc")
+      <<0xAB, 0xC::4>>
+
+  """
+  @spec hex_prefix(hex :: String.t()) :: bitstring()
+  def hex_prefix(hex) when is_binary(hex) do
+    for <<char <- String.downcase(hex)>>, into: <<>>, do: <<String.to_integer(<<char>>, 16)::4>>
+  end
+
+  @doc """
+  Prefix matching x-only pubkey whose bech32 `npub` encoding starts with `npub`
+
+  ## Examples
+
+      iex> Secp256k1.KeyRange.npub_prefix("npub1qq")
+      <<0::10>>
+
+  """
+  @spec npub_prefix(npub :: String.t()) :: bitstring()
+  def npub_prefix("npub1" <> data) do
+    for <<char <- data>>, into: <<>> do
+      case Enum.find_index(@bech32_charset, &(&1 == char)) do
+        nil -> raise ArgumentError, "invalid bech32 character #{inspect(<<char>>)}"
+        value -> <<value::5>>
+      end
+    end
+  end
+
+  @doc false
+  def range_pubkeys(_seckey, _count, _xonly), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def start_grind(_seckey, _prefix, _prefix_bits, _xonly, _threads, _count, _limit, _ref),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  # internal NIF related
+
+  @on_load :load_nifs
+
+  defp load_nifs do
+    :lib_secp256k1
+    |> Application.app_dir("priv/keyrange")
+    |> String.to_charlist()
+    |> :erlang.load_nif(0)
+  end
+end
@@ -0,0 +1,103 @@
+defmodule Secp256k1.Keyring do
+  @moduledoc """
+  Keyring of pre-parsed public keys
+
+  Parsing a compressed or x-only pubkey requires a square root, which is a significant part of
+  the verification cost. Keyring parses every pubkey only once, when it is added, and stores the
+  parsed points in native memory. Signatures can be then verified against the index returned by
+  `add/2`.
+
+  Keyring can be shared between processes, verification from multiple processes runs concurrently.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> keyring = Secp256k1.Keyring.new()
+      iex> index = Secp256k1.Keyring.add(keyring, pubkey)
+      iex> msg_hash = :crypto.hash(:sha256, "hello")
+      iex> signature = Secp256k1.Schnorr.sign(msg_hash, seckey)
+      iex> Secp256k1.Keyring.schnorr_valid?(keyring, index, signature, msg_hash)
+      true
+
+  """
+
+  @typedoc """
+  Reference to the native keyring
+  """
+  @type t() :: reference()
+
+  @typedoc """
+  Position of the pubkey in the keyring
+  """
+  @type index() :: non_neg_integer()
+
+  @doc """
+  Create new empty keyring
+  """
+  @spec new() :: t()
+  def new, do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Parse pubkey and add it to the keyring
+
+  Accepts compressed, uncompressed or x-only pubkey. X-only pubkeys are stored with even Y
+  coordinate as defined by BIP340. Returns index under which the pubkey is stored.
+  """
+  @spec add(keyring :: t(), pubkey :: Secp256k1.pubkey()) :: index() | {:error, String.t()}
+  def add(_keyring, _pubkey), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Number of pubkeys in the keyring
+  """
+  @spec size(keyring :: t()) :: non_neg_integer()
+  def size(_keyring), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Check if ECDSA signature is valid for pubkey stored under index
+
+  See `Secp256k1.ECDSA.valid?/3`
+  """
+  @spec ecdsa_valid?(
+          keyring :: t(),
+          index :: index(),
+          signature :: Secp256k1.ecdsa_sig(),
+          msg_hash :: Secp256k1.hash()
+        ) :: boolean()
+  def ecdsa_valid?(_keyring, _index, _signature, _msg_hash),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Check if Schnorr signature is valid for pubkey stored under index
+
+  Only X coordinate of the stored pubkey is used. See `Secp256k1.Schnorr.valid?/3`
+  """
+  @spec schnorr_valid?(
+          keyring :: t(),
+          index :: index(),
+          signature :: Secp256k1.schnorr_sig(),
+          message :: binary()
+        ) :: boolean()
+  def schnorr_valid?(_keyring, _index, _signature, _message),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Compute EC Diffie-Hellman secret with pubkey stored under index
+  """
+  @spec ecdh(keyring :: t(), index :: index(), seckey :: Secp256k1.seckey()) ::
+          Secp256k1.shared_secret()
+  def ecdh(_keyring, _index, _seckey), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  # internal NIF related
+
+  @on_load :load_nifs
+
+  defp load_nifs do
+    :lib_secp256k1
+    |> Application.app_dir("priv/keyring")
+    |> String.to_charlist()
+    |> :erlang.load_nif(0)
+  end
+end
@@ -32,11 +32,42 @@ defmodule Secp256k1.MuSig do
       # 7. Verification
       Secp256k1.Schnorr.valid?(final_sig, msg_hash, agg_pubkey)
       # => true
+
+  Key aggregation caches and sessions are native resources, they are immutable and can be shared
+  by concurrent signing processes of the same node without copying.
+  """
+
+  @typedoc """
+  Reference to the native key aggregation cache
   """
+  @type keyagg_cache :: reference()
 
-  @type keyagg_cache :: binary()
-  @type session :: binary()
+  @typedoc """
+  Reference to the native signing session
+  """
+  @type session :: reference()
   @type secnonce :: reference()
+
+  @typedoc """
+  Reference to the native pool of pre-generated nonces
+  """
+  @type nonce_pool :: reference()
+
+  @typedoc """
+  Nonce pool state
+
+    - `depth` and `rate` current configuration
+    - `available` pairs ready to be taken
+    - `generated`, `taken` and `misses` (takes from an empty pool) since the pool was started
+  """
+  @type nonce_pool_info :: %{
+          depth: pos_integer(),
+          rate: non_neg_integer(),
+          available: non_neg_integer(),
+          generated: non_neg_integer(),
+          taken: non_neg_integer(),
+          misses: non_neg_integer()
+        }
   # 66 bytes
   @type pubnonce :: <<_::528>>
   # 132 bytes
@@ -44,39 +75,89 @@ defmodule Secp256k1.MuSig do
   # 36 bytes
   @type partial_sig :: <<_::288>>
 
+  @typedoc """
+  Key aggregation memo state
+
+    - `size` number of slots, `0` when disabled
+    - `entries` occupied slots
+    - `hits` and `misses` cumulative lookups since the module was loaded
+  """
+  @type keyagg_memo_info :: %{
+          size: non_neg_integer(),
+          entries: non_neg_integer(),
+          hits: non_neg_integer(),
+          misses: non_neg_integer()
+        }
+
   @doc """
   Aggregates public keys.
 
   Returns the aggregated x-only public key and a key aggregation cache.
+
+  Aggregations are memoized in a bounded native table keyed by SHA-256 of the (sorted)
+  compressed keys, aggregating a known key set again returns the already computed cache
+  without parsing the keys and adding the points. See `keyagg_memo_configure/1`.
+
+  ## Options
+    - `:sort` (default false) - sort the keys as BIP327 `KeySort` first, so every signer gets
+      the same aggregated key regardless of the order it learned the keys in
+    - `:memo` (default true) - look up and store the aggregation in the memo
+
+  ## Examples
+
+      iex> {_, pk1} = Secp256k1.keypair(:compressed)
+      iex> {_, pk2} = Secp256k1.keypair(:compressed)
+      iex> {:ok, agg_pk, _cache} = Secp256k1.MuSig.pubkey_agg([pk1, pk2], sort: true)
+      iex> {:ok, ^agg_pk, _cache} = Secp256k1.MuSig.pubkey_agg([pk2, pk1], sort: true)
+      iex> byte_size(agg_pk)
+      32
+
   """
-  @spec pubkey_agg([Secp256k1.pubkey()]) ::
+  @spec pubkey_agg([Secp256k1.pubkey()], sort: boolean(), memo: boolean()) ::
           {:ok, Secp256k1.xonly_pubkey(), keyagg_cache()} | {:error, term()}
-  def pubkey_agg(pubkeys) when is_list(pubkeys), do: :erlang.nif_error({:error, :not_loaded})
+  def pubkey_agg(pubkeys, opts \\ []) when is_list(pubkeys) do
+    pubkey_agg_keys(pubkeys, Keyword.get(opts, :sort, false), Keyword.get(opts, :memo, true))
+  end
+
+  @doc """
+  Resizes the key aggregation memo to `size` slots, `0` disables it.
+
+  All memoized aggregations are dropped, caches already returned stay valid.
+  """
+  @spec keyagg_memo_configure(non_neg_integer()) :: :ok | {:error, term()}
+  def keyagg_memo_configure(size) when is_integer(size) and size >= 0,
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Gets current state of the key aggregation memo.
+  """
+  @spec keyagg_memo_info() :: keyagg_memo_info()
+  def keyagg_memo_info, do: :erlang.nif_error({:error, :not_loaded})
 
   @doc """
   Gets the full public key from the key aggregation cache.
   """
   @spec pubkey_get(keyagg_cache()) :: Secp256k1.pubkey() | {:error, term()}
-  def pubkey_get(cache) when is_binary(cache), do: :erlang.nif_error({:error, :not_loaded})
+  def pubkey_get(cache) when is_reference(cache), do: :erlang.nif_error({:error, :not_loaded})
 
   @doc """
   Applies a plain EC tweak to the aggregated public key.
 
-  Returns the new cache and the tweaked public key.
+  Returns the new cache and the tweaked public key, the original cache is left unchanged.
   """
   @spec pubkey_ec_tweak_add(keyagg_cache(), <<_::256>>) ::
           {:ok, keyagg_cache(), Secp256k1.pubkey()} | {:error, term()}
-  def pubkey_ec_tweak_add(cache, tweak) when is_binary(cache) and byte_size(tweak) == 32,
+  def pubkey_ec_tweak_add(cache, tweak) when is_reference(cache) and byte_size(tweak) == 32,
     do: :erlang.nif_error({:error, :not_loaded})
 
   @doc """
   Applies an x-only tweak to the aggregated public key.
 
-  Returns the new cache and the tweaked public key.
+  Returns the new cache and the tweaked public key, the original cache is left unchanged.
   """
   @spec pubkey_xonly_tweak_add(keyagg_cache(), <<_::256>>) ::
           {:ok, keyagg_cache(), Secp256k1.pubkey()} | {:error, term()}
-  def pubkey_xonly_tweak_add(cache, tweak) when is_binary(cache) and byte_size(tweak) == 32,
+  def pubkey_xonly_tweak_add(cache, tweak) when is_reference(cache) and byte_size(tweak) == 32,
     do: :erlang.nif_error({:error, :not_loaded})
 
   @doc """
@@ -101,6 +182,73 @@ defmodule Secp256k1.MuSig do
   def nonce_gen(_seckey, _pubkey, _msg, _cache, _extra),
     do: :erlang.nif_error({:error, :not_loaded})
 
+  @doc """
+  Starts a pool of pre-generated nonces of the signer.
+
+  A native thread fills the pool in the background, so `nonce_pool_take/1` in the first round of
+  a signing session is a pop instead of the nonce generation. Every pair is handed out exactly
+  once, pairs never taken are erased together with the pool when its reference is garbage
+  collected.
+
+  Pooled nonces are generated before the message and key aggregation cache are known, they are
+  derived from fresh randomness, the optional `seckey` and the signer's `pubkey` only (the other
+  `nonce_gen/5` inputs are optional hardening against a broken RNG).
+
+  ## Options
+    - `:depth` (default 64) - number of pairs kept ready
+    - `:rate` (default 0) - maximum pairs generated per second, `0` for no limit
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> pool = Secp256k1.MuSig.nonce_pool(seckey, pubkey, depth: 4)
+      iex> {:ok, secnonce, pubnonce} = Secp256k1.MuSig.nonce_pool_take(pool)
+      iex> {is_reference(secnonce), byte_size(pubnonce)}
+      {true, 66}
+
+  """
+  @spec nonce_pool(
+          Secp256k1.seckey() | nil,
+          Secp256k1.pubkey(),
+          depth: pos_integer(),
+          rate: non_neg_integer()
+        ) :: nonce_pool() | {:error, term()}
+  def nonce_pool(seckey, pubkey, opts \\ []) do
+    nonce_pool_new(seckey, pubkey, Keyword.get(opts, :depth, 64), Keyword.get(opts, :rate, 0))
+  end
+
+  @doc """
+  Takes a nonce from the pool.
+
+  Returns a secret nonce resource and a public nonce like `nonce_gen/5`. When the pool is empty
+  the nonce is generated on the spot.
+  """
+  @spec nonce_pool_take(nonce_pool()) :: {:ok, secnonce(), pubnonce()} | {:error, term()}
+  def nonce_pool_take(pool) when is_reference(pool), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Changes depth and refill rate of the pool, see `nonce_pool/3` for the options.
+
+  Lowering the depth erases the pairs which don't fit.
+  """
+  @spec nonce_pool_configure(nonce_pool(), depth: pos_integer(), rate: non_neg_integer()) ::
+          :ok | {:error, term()}
+  def nonce_pool_configure(pool, opts) when is_reference(pool) and is_list(opts) do
+    current = nonce_pool_info(pool)
+
+    nonce_pool_configure(
+      pool,
+      Keyword.get(opts, :depth, current.depth),
+      Keyword.get(opts, :rate, current.rate)
+    )
+  end
+
+  @doc """
+  Gets current state of the nonce pool.
+  """
+  @spec nonce_pool_info(nonce_pool()) :: nonce_pool_info()
+  def nonce_pool_info(pool) when is_reference(pool), do: :erlang.nif_error({:error, :not_loaded})
+
   @doc """
   Aggregates public nonces from all signers.
   """
@@ -112,7 +260,7 @@ defmodule Secp256k1.MuSig do
   """
   @spec nonce_process(aggnonce(), binary(), keyagg_cache()) :: session() | {:error, term()}
   def nonce_process(aggnonce, msg, cache)
-      when is_binary(aggnonce) and byte_size(msg) == 32 and is_binary(cache),
+      when is_binary(aggnonce) and byte_size(msg) == 32 and is_reference(cache),
       do: :erlang.nif_error({:error, :not_loaded})
 
   @doc """
@@ -138,12 +286,52 @@ defmodule Secp256k1.MuSig do
   def partial_sig_verify(_partial_sig, _pubnonce, _pubkey, _cache, _session),
     do: :erlang.nif_error({:error, :not_loaded})
 
+  @doc """
+  Verifies partial signatures of all signers in one call.
+
+  Entries are a list of `{partial_sig, pubnonce, pubkey}` tuples or a binary of packed entries
+  (32 bytes partial signature, 66 bytes pubnonce and 33 bytes compressed pubkey each). Returns
+  `{:error, indices}` with positions of the signers whose entry doesn't parse or verify.
+
+  ## Options
+    - `:aggregate` (default false) - when all entries are valid return `{:ok, signature}` with
+      the aggregated Schnorr signature instead of `:ok`
+
+  More than 10 entries are verified on dirty CPU scheduler.
+  """
+  @spec partial_sig_verify_many(
+          session(),
+          keyagg_cache(),
+          [{partial_sig(), pubnonce(), Secp256k1.pubkey()}] | binary(),
+          aggregate: boolean()
+        ) :: :ok | {:ok, Secp256k1.schnorr_sig()} | {:error, [non_neg_integer()] | term()}
+  def partial_sig_verify_many(session, cache, entries, opts \\ []) do
+    partial_sig_verify_batch(session, cache, entries, Keyword.get(opts, :aggregate, false))
+  end
+
   @doc """
   Aggregates partial signatures into the final Schnorr signature.
   """
   @spec partial_sig_agg(session(), [partial_sig()]) :: Secp256k1.schnorr_sig() | {:error, term()}
   def partial_sig_agg(_session, _partial_sigs), do: :erlang.nif_error({:error, :not_loaded})
 
+  @doc false
+  def nonce_pool_new(_seckey, _pubkey, _depth, _rate),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def nonce_pool_configure(_pool, _depth, _rate), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def pubkey_agg_keys(_pubkeys, _sort, _memo), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def partial_sig_verify_batch(_session, _cache, _entries, _aggregate),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
   # Internal NIF loading
 
   @on_load :load_nifs
@@ -0,0 +1,93 @@
+defmodule Secp256k1.Nostr do
+  @moduledoc """
+  Module implementing Nostr (NIP-01) event id computation and verification
+
+  Events are maps with `id`, `pubkey`, `created_at`, `kind`, `tags`, `content` and `sig` keys
+  (strings or atoms) as decoded from the event JSON, so `id`, `pubkey` and `sig` are lowercase
+  hex. Canonical serialization, hashing, id comparison and signature verification happen in a
+  single NIF call without building the serialized event.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> event = %{
+      ...>   "pubkey" => Base.encode16(pubkey, case: :lower),
+      ...>   "created_at" => 1_700_000_000,
+      ...>   "kind" => 1,
+      ...>   "tags" => [["t", "nostr"]],
+      ...>   "content" => "hello"
+      ...> }
+      iex> id = Secp256k1.Nostr.event_id(event)
+      iex> event = Map.merge(event, %{
+      ...>   "id" => Base.encode16(id, case: :lower),
+      ...>   "sig" => Base.encode16(Secp256k1.Schnorr.sign(id, seckey), case: :lower)
+      ...> })
+      iex> Secp256k1.Nostr.verify_event(event)
+      :ok
+      iex> Secp256k1.Nostr.verify_event(%{event | "content" => "bye"})
+      {:error, :invalid_id}
+
+  """
+
+  @typedoc """
+  Nostr event with string or atom keys
+  """
+  @type event() :: map()
+
+  @typedoc """
+  Result of event verification, `:malformed` when a field is missing or has invalid format
+  """
+  @type status() :: :ok | {:error, :invalid_id | :invalid_sig | :malformed}
+
+  @doc """
+  Compute event id (32 bytes SHA-256 of the canonical serialization)
+
+  Only `pubkey`, `created_at`, `kind`, `tags` and `content` are used. Raises `ArgumentError` for
+  malformed fields.
+  """
+  @spec event_id(event :: event()) :: Secp256k1.hash()
+  def event_id(event) when is_map(event) do
+    Secp256k1.Schnorr.event_id(
+      {get(event, "pubkey", :pubkey), get(event, "created_at", :created_at),
+       get(event, "kind", :kind), get(event, "tags", :tags), get(event, "content", :content)}
+    )
+  end
+
+  @doc """
+  Check that event id matches its content and the signature is valid
+  """
+  @spec verify_event(event :: event()) :: status()
+  def verify_event(event) do
+    [status] = verify_events([event])
+    status
+  end
+
+  @doc """
+  Check if event id and signature are valid
+  """
+  @spec valid_event?(event :: event()) :: boolean()
+  def valid_event?(event), do: verify_event(event) == :ok
+
+  @doc """
+  Verify list of events in a single call, returns status of every event
+
+  Lists with total cost over a scheduler timeslice (more than 16 short events) are verified on
+  dirty CPU scheduler.
+  """
+  @spec verify_events(events :: [event()]) :: [status()]
+  def verify_events(events) when is_list(events) do
+    events
+    |> Enum.map(&to_tuple/1)
+    |> Secp256k1.Schnorr.verify_events()
+  end
+
+  defp to_tuple(event) when is_map(event) do
+    {get(event, "id", :id), get(event, "pubkey", :pubkey), get(event, "created_at", :created_at),
+     get(event, "kind", :kind), get(event, "tags", :tags), get(event, "content", :content),
+     get(event, "sig", :sig)}
+  end
+
+  defp to_tuple(_event), do: nil
+
+  defp get(event, string, atom), do: Map.get(event, string, Map.get(event, atom))
+end
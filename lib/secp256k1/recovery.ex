@@ -0,0 +1,135 @@
+defmodule Secp256k1.Recovery do
+  @moduledoc """
+  Module implementing ECDSA signatures with public key recovery
+
+  Recoverable signature is 65 bytes long: 64 bytes of compact ECDSA signature followed by one byte
+  of recovery ID (0 - 3). This is the layout used by Ethereum, where the last byte is `v` and the
+  recovery ID is `v - 27` (or `v - 35 - 2 * chain_id` with EIP-155).
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> msg_hash = :crypto.hash(:sha256, "hello")
+      iex> signature = Secp256k1.Recovery.sign(msg_hash, seckey)
+      iex> Secp256k1.Recovery.recover(signature, msg_hash) == pubkey
+      true
+
+  """
+
+  import Secp256k1.Guards
+
+  @typedoc """
+  Recoverable signature is 65 bytes long binary, compact signature followed by recovery ID
+  """
+  @type signature() :: <<_::520>>
+
+  @typedoc """
+  Recovery ID
+  """
+  @type recid() :: 0..3
+
+  @doc """
+  Generate recoverable ECDSA signature of message hash (AUX is randomly generated)
+  """
+  @spec sign(msg_hash :: Secp256k1.hash(), seckey :: Secp256k1.seckey()) :: signature()
+  def sign(msg_hash, seckey) when is_hash(msg_hash) and is_seckey(seckey) do
+    sign(msg_hash, seckey, :crypto.strong_rand_bytes(32))
+  end
+
+  @doc """
+  Generate recoverable ECDSA signature of message hash and specify AUX value - NOT RECOMMENDED
+  """
+  @spec sign(msg_hash :: Secp256k1.hash(), seckey :: Secp256k1.seckey(), aux :: <<_::256>>) ::
+          signature()
+  def sign(_msg_hash, _seckey, _aux), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Create recoverable signature from compact ECDSA signature and recovery ID
+
+  ## Examples
+
+      iex> {seckey, _pubkey} = Secp256k1.keypair(:compressed)
+      iex> signature = Secp256k1.Recovery.sign(:crypto.hash(:sha256, "hello"), seckey)
+      iex> {compact, recid} = Secp256k1.Recovery.serialize_compact(signature)
+      iex> Secp256k1.Recovery.parse_compact(compact, recid) == signature
+      true
+
+  """
+  @spec parse_compact(compact :: Secp256k1.ecdsa_sig(), recid :: recid()) ::
+          signature() | {:error, String.t()}
+  def parse_compact(_compact, _recid), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Split recoverable signature into compact ECDSA signature and recovery ID
+  """
+  @spec serialize_compact(signature :: signature()) :: {Secp256k1.ecdsa_sig(), recid()}
+  def serialize_compact(_signature), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Convert recoverable signature to ECDSA signature accepted by `Secp256k1.ECDSA.valid?/3`
+  """
+  @spec to_ecdsa(signature :: signature()) :: Secp256k1.ecdsa_sig()
+  def to_ecdsa(_signature), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Recover pubkey of the signer
+
+  `type` is `:compressed` (default) or `:uncompressed` (used for Ethereum addresses)
+  """
+  @spec recover(
+          signature :: signature(),
+          msg_hash :: Secp256k1.hash(),
+          type :: :compressed | :uncompressed
+        ) ::
+          Secp256k1.compressed_pubkey() | Secp256k1.uncompressed_pubkey() | {:error, String.t()}
+  def recover(signature, msg_hash, type \\ :compressed)
+      when type in [:compressed, :uncompressed] do
+    recover_pubkey(signature, msg_hash, type == :compressed)
+  end
+
+  @doc """
+  Recover pubkeys of many signers in a single call
+
+  Returns pubkeys in the same order as the `{signature, msg_hash}` entries, `nil` for signatures
+  which are malformed or from which no pubkey can be recovered. Large lists are processed on dirty
+  CPU scheduler.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:compressed)
+      iex> msg_hash = :crypto.hash(:sha256, "hello")
+      iex> signature = Secp256k1.Recovery.sign(msg_hash, seckey)
+      iex> Secp256k1.Recovery.recover_many([{signature, msg_hash}, {<<0::520>>, msg_hash}])
+      [pubkey, nil]
+
+  """
+  @spec recover_many(
+          [{signature :: signature(), msg_hash :: Secp256k1.hash()}],
+          type :: :compressed | :uncompressed
+        ) :: [Secp256k1.compressed_pubkey() | Secp256k1.uncompressed_pubkey() | nil]
+  def recover_many(items, type \\ :compressed)
+      when is_list(items) and type in [:compressed, :uncompressed] do
+    recover_pubkeys(items, type == :compressed)
+  end
+
+  @doc false
+  def recover_pubkey(_signature, _msg_hash, _compressed),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def recover_pubkeys(_items, _compressed), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  # internal NIF related
+
+  @on_load :load_nifs
+
+  defp load_nifs do
+    :lib_secp256k1
+    |> Application.app_dir("priv/recovery")
+    |> String.to_charlist()
+    |> :erlang.load_nif(0)
+  end
+end
@@ -5,6 +5,39 @@ defmodule Secp256k1.Schnorr do
 
   import Secp256k1.Guards
 
+  @typedoc """
+  Reference to the native keypair created by `keypair/1`
+  """
+  @type keypair() :: reference()
+
+  @doc """
+  Create reusable keypair from seckey
+
+  Keypair holds the seckey together with the derived pubkey in native memory (erased when the
+  keypair is garbage collected). It can be passed to all sign functions instead of the seckey to
+  skip the pubkey derivation on every signature.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> keypair = Secp256k1.Schnorr.keypair(seckey)
+      iex> Secp256k1.Schnorr.xonly_pubkey(keypair) == pubkey
+      true
+      iex> msg_hash = :crypto.hash(:sha256, "hello")
+      iex> signature = Secp256k1.Schnorr.sign(msg_hash, keypair)
+      iex> Secp256k1.Schnorr.valid?(signature, msg_hash, pubkey)
+      true
+
+  """
+  @spec keypair(seckey :: Secp256k1.seckey()) :: keypair()
+  def keypair(_seckey), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Get xonly pubkey of the keypair
+  """
+  @spec xonly_pubkey(keypair :: keypair()) :: Secp256k1.xonly_pubkey()
+  def xonly_pubkey(_keypair), do: :erlang.nif_error({:error, :not_loaded})
+
   @doc """
   Generate Schnorr signature of message (can be hash or custom length message)
 
@@ -27,7 +60,8 @@ defmodule Secp256k1.Schnorr do
       64
 
   """
-  @spec sign(message :: binary(), seckey :: Secp256k1.seckey()) :: Secp256k1.schnorr_sig()
+  @spec sign(message :: binary(), seckey :: Secp256k1.seckey() | keypair()) ::
+          Secp256k1.schnorr_sig()
   def sign(message, seckey) when is_hash(message), do: sign32(message, seckey)
 
   def sign(message, seckey) when is_binary(message), do: sign_custom(message, seckey)
@@ -35,9 +69,10 @@ defmodule Secp256k1.Schnorr do
   @doc """
   Generate Schnorr signature of a hash (AUX is randomly generated)
   """
-  @spec sign32(msg_hash :: Secp256k1.hash(), seckey :: Secp256k1.seckey()) ::
+  @spec sign32(msg_hash :: Secp256k1.hash(), seckey :: Secp256k1.seckey() | keypair()) ::
           Secp256k1.schnorr_sig()
-  def sign32(msg_hash, seckey) when is_hash(msg_hash) and is_seckey(seckey) do
+  def sign32(msg_hash, seckey)
+      when is_hash(msg_hash) and (is_seckey(seckey) or is_reference(seckey)) do
     sign32(msg_hash, seckey, :crypto.strong_rand_bytes(32))
   end
 
@@ -46,7 +81,7 @@ defmodule Secp256k1.Schnorr do
   """
   @spec sign32(
           msg_hash :: Secp256k1.hash(),
-          seckey :: Secp256k1.seckey(),
+          seckey :: Secp256k1.seckey() | keypair(),
           aux :: <<_::32, _::_*8>>
         ) :: Secp256k1.schnorr_sig()
   def sign32(_msg_hash, _seckey, _aux), do: :erlang.nif_error({:error, :not_loaded})
@@ -54,16 +89,20 @@ defmodule Secp256k1.Schnorr do
   @doc """
   Generate Schnorr signature of arbitrary message (AUX is randomly generated)
   """
-  @spec sign_custom(message :: binary(), seckey :: Secp256k1.seckey()) :: Secp256k1.schnorr_sig()
-  def sign_custom(message, seckey) when is_seckey(seckey) do
+  @spec sign_custom(message :: binary(), seckey :: Secp256k1.seckey() | keypair()) ::
+          Secp256k1.schnorr_sig()
+  def sign_custom(message, seckey) when is_seckey(seckey) or is_reference(seckey) do
     sign_custom(message, seckey, :crypto.strong_rand_bytes(32))
   end
 
   @doc """
   Generate Schnorr signature of a arbitrary message and specify AUX - NOT RECOMMENDED
   """
-  @spec sign_custom(message :: binary(), seckey :: Secp256k1.seckey(), aux :: <<_::32, _::_*8>>) ::
-          Secp256k1.schnorr_sig()
+  @spec sign_custom(
+          message :: binary(),
+          seckey :: Secp256k1.seckey() | keypair(),
+          aux :: <<_::32, _::_*8>>
+        ) :: Secp256k1.schnorr_sig()
   def sign_custom(_message, _seckey, _aux), do: :erlang.nif_error({:error, :not_loaded})
 
   @doc """
@@ -85,6 +124,122 @@ defmodule Secp256k1.Schnorr do
         ) :: boolean()
   def valid?(_signature, _message, _pubkey), do: :erlang.nif_error({:error, :not_loaded})
 
+  @typedoc """
+  Single entry of the batch verification list
+  """
+  @type batch_item() ::
+          {signature :: Secp256k1.schnorr_sig(), message :: binary(),
+           pubkey :: Secp256k1.xonly_pubkey()}
+
+  @doc """
+  Validate list of Schnorr signatures in a single NIF call
+
+  Returns `true` only if every signature in the list is valid. Lists longer than 16 items are
+  verified on a dirty CPU scheduler. When the batch fails use `verify_batch/1` to find out which
+  entries are invalid.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> batch = for msg <- ["a", "b", "c"], do: {Secp256k1.Schnorr.sign(msg, seckey), msg, pubkey}
+      iex> Secp256k1.Schnorr.valid_batch?(batch)
+      true
+
+  """
+  @spec valid_batch?([batch_item()]) :: boolean()
+  def valid_batch?(_batch), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Validate list of Schnorr signatures and report every invalid entry
+
+  Returns `:ok` when all signatures are valid or `{:error, indices}` with zero-based indices of
+  the invalid entries otherwise.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> sig = Secp256k1.Schnorr.sign("a", seckey)
+      iex> Secp256k1.Schnorr.verify_batch([{sig, "a", pubkey}, {sig, "b", pubkey}])
+      {:error, [1]}
+
+  """
+  @spec verify_batch([batch_item()]) :: :ok | {:error, [non_neg_integer()]}
+  def verify_batch(_batch), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc """
+  Hash iodata message and sign the hash in a single NIF call
+
+  The message is hashed inside the NIF without flattening it, long messages are hashed in chunks
+  yielding to the scheduler in between. The 32 byte hash is signed, so the signature is the same
+  as `sign32/2` of the message hash (not `sign_custom/2` of the whole message).
+
+  ## Options
+    - `:hash` - `:sha256` (default) or `{:tagged, tag}` for BIP340 tagged hash
+    - `:aux` - AUX value (randomly generated by default) - NOT RECOMMENDED
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> signature = Secp256k1.Schnorr.sign_message(["hello", 32, ["world"]], seckey)
+      iex> Secp256k1.Schnorr.valid?(signature, :crypto.hash(:sha256, "hello world"), pubkey)
+      true
+
+  """
+  @spec sign_message(
+          message :: iodata(),
+          seckey :: Secp256k1.seckey() | keypair(),
+          opts :: [hash: Secp256k1.message_hash(), aux: <<_::256>>]
+        ) :: Secp256k1.schnorr_sig()
+  def sign_message(message, seckey, opts \\ []) do
+    aux = Keyword.get_lazy(opts, :aux, fn -> :crypto.strong_rand_bytes(32) end)
+    sign_iodata(message, seckey, aux, Secp256k1.hash_tag(opts))
+  end
+
+  @doc """
+  Hash iodata message and check the Schnorr signature of the hash in a single NIF call
+
+  Accepts the same `:hash` option as `sign_message/3`.
+
+  ## Examples
+
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> signature = Secp256k1.Schnorr.sign_message("hello world", seckey)
+      iex> Secp256k1.Schnorr.valid_message?(signature, ["hello", " world"], pubkey)
+      true
+
+  """
+  @spec valid_message?(
+          signature :: Secp256k1.schnorr_sig(),
+          message :: iodata(),
+          pubkey :: Secp256k1.xonly_pubkey(),
+          opts :: [hash: Secp256k1.message_hash()]
+        ) :: boolean()
+  def valid_message?(signature, message, pubkey, opts \\ []) do
+    verify_iodata(signature, message, pubkey, Secp256k1.hash_tag(opts))
+  end
+
+  @doc false
+  def sign_iodata(_message, _seckey, _aux, _tag), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def verify_iodata(_signature, _message, _pubkey, _tag),
+    do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def event_id(_fields), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def verify_events(_events), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def sigcache_configure(_max_bytes), do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def sigcache_stats, do: :erlang.nif_error({:error, :not_loaded})
+
+  @doc false
+  def stats, do: :erlang.nif_error({:error, :not_loaded})
+
   # internal NIF related
 
   @on_load :load_nifs
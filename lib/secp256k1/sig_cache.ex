@@ -0,0 +1,78 @@
+defmodule Secp256k1.SigCache do
+  @moduledoc """
+  Native cache of successful signature verifications
+
+  Gossip networks deliver the same signed objects many times. With the cache enabled the
+  ECDSA and Schnorr verify functions (including `Secp256k1.Nostr` event verification) remember
+  every valid signature and answer repeated verifications without the curve arithmetic.
+
+  Entries are salted SHA-256 hashes of the signature, message and pubkey (32 bytes each), the
+  salt is random for every VM so entries can't be predicted by peers. Only valid signatures are
+  cached, invalid ones are always verified again. When the cache is full new entries replace
+  older ones.
+
+  The cache is disabled until `configure/1` gives it memory.
+
+  ## Examples
+
+      iex> Secp256k1.SigCache.configure(1_048_576)
+      :ok
+      iex> {seckey, pubkey} = Secp256k1.keypair(:xonly)
+      iex> msg_hash = :crypto.hash(:sha256, "gossip")
+      iex> signature = Secp256k1.Schnorr.sign(msg_hash, seckey)
+      iex> Secp256k1.Schnorr.valid?(signature, msg_hash, pubkey)
+      true
+      iex> %{hits: hits} = Secp256k1.SigCache.stats()
+      iex> Secp256k1.Schnorr.valid?(signature, msg_hash, pubkey)
+      true
+      iex> Secp256k1.SigCache.stats().hits > hits
+      true
+      iex> Secp256k1.SigCache.configure(0)
+      :ok
+
+  """
+
+  @typedoc """
+  Cache statistics
+
+    - `hits` and `misses` cumulative lookups since the NIFs were loaded
+    - `entries` cached verifications since the last `configure/1`
+    - `bytes` memory used by the cache
+  """
+  @type stats() :: %{
+          hits: non_neg_integer(),
+          misses: non_neg_integer(),
+          entries: non_neg_integer(),
+          bytes: non_neg_integer()
+        }
+
+  @modules [Secp256k1.ECDSA, Secp256k1.Schnorr]
+
+  @doc """
+  Set memory limit of the cache in bytes, `0` disables it
+
+  The limit is split evenly between the ECDSA and Schnorr caches. Reconfiguring drops all cached
+  entries.
+  """
+  @spec configure(max_bytes :: non_neg_integer()) :: :ok | {:error, String.t()}
+  def configure(max_bytes) when is_integer(max_bytes) and max_bytes >= 0 do
+    share = div(max_bytes, length(@modules))
+
+    Enum.reduce_while(@modules, :ok, fn module, :ok ->
+      case module.sigcache_configure(share) do
+        {:ok, _bytes} -> {:cont, :ok}
+        {:error, _reason} = error -> {:halt, error}
+      end
+    end)
+  end
+
+  @doc """
+  Get cache statistics summed over the ECDSA and Schnorr caches
+  """
+  @spec stats() :: stats()
+  def stats do
+    @modules
+    |> Enum.map(& &1.sigcache_stats())
+    |> Enum.reduce(&Map.merge(&1, &2, fn _key, a, b -> a + b end))
+  end
+end
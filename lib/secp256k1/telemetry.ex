@@ -0,0 +1,48 @@
+defmodule Secp256k1.Telemetry do
+  @moduledoc """
+  Emit `Secp256k1.stats/0` as `:telemetry` events
+
+  Requires the optional `:telemetry` dependency. The NIFs only keep counters, so the stats have to
+  be polled, e.g. with `:telemetry_poller`:
+
+      {:telemetry_poller,
+       measurements: [{Secp256k1.Telemetry, :emit_stats, []}],
+       period: :timer.seconds(10)}
+
+  ## Events
+
+    - `[:secp256k1, :operation]` once for every called operation
+      - measurements: `count`, `failed`, `p50_us`, `p99_us` (see `t:Secp256k1.operation_stats/0`)
+      - metadata: `operation` name and the `latency` histogram
+    - `[:secp256k1, :musig, :secnonces]`
+      - measurements: `live` and `unused` secret nonces
+
+  Counts are cumulative since the NIFs were loaded, use `Telemetry.Metrics.last_value/2` or
+  compute the rate between polls.
+  """
+
+  # `:telemetry` is optional, don't warn when the project doesn't depend on it
+  @compile {:no_warn_undefined, :telemetry}
+
+  @doc """
+  Emit current stats as `:telemetry` events
+  """
+  @spec emit_stats() :: :ok
+  def emit_stats do
+    stats = Secp256k1.stats()
+
+    for {operation, op_stats} <- stats.operations do
+      :telemetry.execute(
+        [:secp256k1, :operation],
+        Map.take(op_stats, [:count, :failed, :p50_us, :p99_us]),
+        %{operation: operation, latency: op_stats.latency}
+      )
+    end
+
+    :telemetry.execute(
+      [:secp256k1, :musig, :secnonces],
+      %{live: stats.musig_secnonces_live, unused: stats.musig_secnonces_unused},
+      %{}
+    )
+  end
+end
@@ -16,6 +16,7 @@ defmodule Secp256k1.MixProject do
       consolidate_protocols: Mix.env() != :test,
       elixirc_paths: elixirc_paths(Mix.env()),
       deps: deps(),
+      aliases: aliases(),
 
       # Elixir make
       compilers: [:elixir_make] ++ Mix.compilers(),
@@ -47,6 +48,9 @@ defmodule Secp256k1.MixProject do
       # C compilation
       {:elixir_make, "~> 0.9", runtime: false},
 
+      # Optional stats reporting
+      {:telemetry, "~> 1.0", optional: true},
+
       # Development
       {:ex_check, "~> 0.16", only: [:dev], runtime: false},
       {:credo, "~> 1.7", only: [:dev], runtime: false},
@@ -56,11 +60,17 @@ defmodule Secp256k1.MixProject do
     ]
   end
 
+  defp aliases do
+    [
+      bench: "run bench/secp256k1.exs"
+    ]
+  end
+
   defp package do
     [
       name: "lib_secp256k1",
       maintainers: ["Sgiath <secp256k1@sgiath.dev>"],
-      files: ~w(lib LICENSE mix.exs README* CHANGELOG* c_src/*.[ch] Makefile),
+      files: ~w(lib LICENSE mix.exs README* CHANGELOG* c_src/*.[ch] c_src/core/*.[ch] Makefile),
       licenses: ["WTFPL"],
       links: %{
         "C library" => "https://github.com/bitcoin-core/secp256k1",
@@ -89,7 +99,7 @@ defmodule Secp256k1.MixProject do
 
   defp groups_for_modules do
     [
-      "Private API": [Secp256k1.ECDSA, Secp256k1.Extrakeys, Secp256k1.Schnorr, Secp256k1.MuSig]
+      "Private API": [Secp256k1.ECDH, Secp256k1.ECDSA, Secp256k1.Extrakeys, Secp256k1.Schnorr, Secp256k1.MuSig]
     ]
   end
 end
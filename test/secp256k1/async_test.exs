@@ -0,0 +1,90 @@
+defmodule Secp256k1Test.Async do
+  # pool configuration is shared by the whole VM
+  use Secp256k1Test.Case, async: false
+
+  alias Secp256k1.Async
+  alias Secp256k1.ECDSA
+  alias Secp256k1.Schnorr
+
+  doctest Secp256k1.Async
+
+  setup_all do
+    {schnorr_seckey, xonly} = Secp256k1.keypair(:xonly)
+    {ecdsa_seckey, compressed} = Secp256k1.keypair(:compressed)
+    msg_hash = :crypto.hash(:sha256, "async")
+
+    {:ok,
+     %{
+       schnorr: {Schnorr.sign(msg_hash, schnorr_seckey), msg_hash, xonly},
+       ecdsa: {ECDSA.sign(msg_hash, ecdsa_seckey), msg_hash, compressed}
+     }}
+  end
+
+  test "verify", %{schnorr: schnorr, ecdsa: ecdsa} do
+    {sig, msg_hash, pubkey} = schnorr
+
+    assert {:ok, ref} = Async.verify(:schnorr, schnorr)
+    assert_receive {^ref, true}
+
+    assert {:ok, ref} = Async.verify(:ecdsa, ecdsa)
+    assert_receive {^ref, true}
+
+    assert {:ok, ref} = Async.verify(:schnorr, {sig, "other message", pubkey})
+    assert_receive {^ref, false}
+
+    # not a point on the curve
+    assert {:ok, ref} = Async.verify(:schnorr, {sig, msg_hash, <<0::256>>})
+    assert_receive {^ref, false}
+  end
+
+  test "verify_many", %{schnorr: schnorr} do
+    {sig, _msg_hash, pubkey} = schnorr
+    items = [schnorr, {sig, "other", pubkey}, schnorr]
+
+    assert {:ok, ref} = Async.verify_many(:schnorr, items)
+    assert Async.await(ref) == [true, false, true]
+
+    assert {:ok, ref} = Async.verify_many(:schnorr, [])
+    assert Async.await(ref) == []
+  end
+
+  test "results arrive to the caller", %{ecdsa: ecdsa} do
+    refs = for _ <- 1..100, do: elem(Async.verify(:ecdsa, ecdsa), 1)
+
+    assert Enum.all?(refs, &(Async.await(&1) == true))
+    assert Async.info().completed >= 100
+  end
+
+  test "bad input", %{schnorr: schnorr, ecdsa: ecdsa} do
+    assert_raise ArgumentError, fn -> Async.verify(:ecdsa, schnorr) end
+    assert_raise ArgumentError, fn -> Async.verify(:schnorr, ecdsa) end
+    assert_raise ArgumentError, fn -> Async.verify_many(:ecdsa, [ecdsa, :bad]) end
+    assert_raise FunctionClauseError, fn -> Async.verify(:rsa, ecdsa) end
+  end
+
+  test "configure", %{schnorr: schnorr} do
+    %{threads: threads, max_queue: max_queue} = Async.info()
+    on_exit(fn -> Async.configure(threads: threads, max_queue: max_queue) end)
+
+    assert Async.configure(threads: 2) == :ok
+    assert %{threads: 2} = Async.info()
+
+    # full queue rejects new jobs
+    assert Async.configure(max_queue: 0) == :ok
+    assert %{threads: 2} = Async.info()
+    rejected = Async.info().rejected
+    assert Async.verify(:schnorr, schnorr) == {:error, "queue full"}
+    assert Async.info().rejected == rejected + 1
+
+    assert Async.configure(max_queue: 100) == :ok
+    assert {:ok, ref} = Async.verify(:schnorr, schnorr)
+    assert Async.await(ref)
+
+    # the limit counts signatures, not jobs
+    assert Async.verify_many(:schnorr, List.duplicate(schnorr, 101)) == {:error, "queue full"}
+    assert {:ok, ref} = Async.verify_many(:schnorr, List.duplicate(schnorr, 100))
+    assert Async.await(ref) == List.duplicate(true, 100)
+
+    assert_raise ArgumentError, fn -> Async.configure(threads: 0) end
+  end
+end
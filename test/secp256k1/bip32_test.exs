@@ -0,0 +1,88 @@
+defmodule Secp256k1Test.BIP32 do
+  use Secp256k1Test.Case, async: true
+
+  alias Secp256k1.BIP32
+
+  doctest Secp256k1.BIP32
+
+  # BIP32 test vector 1
+  setup_all do
+    {:ok,
+     %{
+       seed: d("000102030405060708090a0b0c0d0e0f"),
+       vectors: [
+         {"m",
+          d("873dff81c02f525623fd1fe5167eac3a55a049de3d314bb42ee227ffed37d508"),
+          d("e8f32e723decf4051aefac8e2c93c9c5b214313817cdb01a1494b917c8436b35"),
+          d("0339a36013301597daef41fbe593a02cc513d0b55527ec2df1050e2e8ff49c85c2")},
+         {"m/0'",
+          d("47fdacbd0f1097043b78c63c20c34ef4ed9a111d980047ad16282c7ae6236141"),
+          d("edb2e14f9ee77d26dd93b4ecede8d16ed408ce149b6cd80b0715a2d911a0afea"),
+          d("035a784662a4a20a65bf6aab9ae98a6c068a81c52e4b032c0fb5400c706cfccc56")},
+         {"m/0'/1",
+          d("2a7857631386ba23dacac34180dd1983734e444fdbf774041578e9b6adb37c19"),
+          d("3c6cb8d0f6a264c91ea8b5030fadaa8e538b020f0a387421a12de9319dc93368"),
+          d("03501e454bf00751f24b1b489aa925215d66af2234e3891c3b21a52bedb3cd711c")},
+         {"m/0'/1/2'",
+          d("04466b9cc8e161e966409ca52986c584f07e9dc81f735db683c3ff6ec7b1503f"),
+          d("cbce0d719ecf7431d88e6a89fa1483e02e35092af60c042b1df2ff59fa424dca"),
+          d("0357bfe1e341d01c69fe5654309956cbea516822fba8a601743a012a7896ee8dc2")},
+         {"m/0'/1/2'/2",
+          d("cfb71883f01676f587d023cc53a35bc7f88f724b1f8c2892ac1275ac822a3edd"),
+          d("0f479245fb19a38a1954c5c7c0ebab2f9bdfd96a17563ef28a6a4b1a2a764ef4"),
+          d("02e8445082a72f29b75ca48748a914df60622a609cacfce8ed0e35804560741d29")},
+         {"m/0'/1/2'/2/1000000000",
+          d("c783e67b921d2beb8f6b389cc646d7263b4145701dadd2161548a8b078e65e9e"),
+          d("471b76e389e528d6de6d816857e012c5455051cad6660850e58372a6c3e6e7c8"),
+          d("022a471424da5e657499d1ff51cb43c47481a03b1e77f951fe64cec9f5a48f7011")}
+       ]
+     }}
+  end
+
+  test "test vector", %{seed: seed, vectors: vectors} do
+    master = BIP32.master_key(seed)
+
+    for {path, chain_code, seckey, pubkey} <- vectors do
+      assert BIP32.derive(master, path) == chain_code <> seckey
+      assert BIP32.xpub(BIP32.derive(master, path)) == chain_code <> pubkey
+    end
+  end
+
+  test "public derivation", %{seed: seed} do
+    xprv = BIP32.derive(BIP32.master_key(seed), "m/0'/1/2'")
+    xpub = BIP32.xpub(xprv)
+
+    assert BIP32.derive(xpub, "m/2/1000000000") ==
+             BIP32.xpub(BIP32.derive(xprv, [2, 1_000_000_000]))
+    assert BIP32.derive(xpub, []) == xpub
+
+    assert_raise ArgumentError, fn -> BIP32.derive(xpub, [BIP32.hardened(0)]) end
+  end
+
+  test "derive range", %{seed: seed} do
+    xpub = seed |> BIP32.master_key() |> BIP32.derive("m/84'/0'/0'/0") |> BIP32.xpub()
+    parent = BIP32.parent(xpub)
+
+    expected = for i <- 100..149, do: binary_part(BIP32.derive(xpub, [i]), 32, 33)
+
+    assert BIP32.unpack(BIP32.derive_range(xpub, 100..149)) == expected
+    assert BIP32.unpack(BIP32.derive_range(parent, 100..149)) == expected
+    assert BIP32.derive_range(parent, 5..4//1) == <<>>
+
+    # large range on dirty scheduler
+    assert byte_size(BIP32.derive_range(parent, 0..9999)) == 10_000 * 33
+
+    assert_raise ArgumentError, fn -> BIP32.derive_range(<<0::520>>, 0..9) end
+    assert_raise ArgumentError, fn -> BIP32.derive_range(parent, 5..0//-1) end
+    assert_raise ArgumentError, fn -> BIP32.derive_range(parent, 0..0x80000000) end
+  end
+
+  test "invalid input" do
+    assert_raise ArgumentError, fn -> BIP32.master_key(<<0::64>>) end
+    assert_raise ArgumentError, fn -> BIP32.derive(<<0::512>>, [0]) end
+    assert_raise ArgumentError, fn -> BIP32.parse_path("m/x") end
+    assert_raise ArgumentError, fn -> BIP32.parse_path("m/2147483648'") end
+    assert_raise ArgumentError, fn -> BIP32.parse_path("m/-1h") end
+    assert_raise ArgumentError, fn -> BIP32.parse_path([0x100000000]) end
+  end
+end
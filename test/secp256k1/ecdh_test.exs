@@ -0,0 +1,65 @@
+defmodule Secp256k1Test.ECDH do
+  use Secp256k1Test.Case, async: true
+
+  alias Secp256k1.ECDH
+  alias Secp256k1.ECDSA
+
+  doctest Secp256k1.ECDH
+
+  setup_all do
+    {:ok,
+     %{
+       seckey: d("1111111111111111111111111111111111111111111111111111111111111111"),
+       pubkey: d("034f355bdcb7cc0af728ef3cceb9615d90684bb5b2ca5f859ab0f0b704075871aa")
+     }}
+  end
+
+  test "successful", %{seckey: s, pubkey: p} do
+    {other_seckey, other_pubkey} = Secp256k1.keypair(:compressed)
+
+    assert ECDH.ecdh(s, other_pubkey) == ECDH.ecdh(other_seckey, p)
+    assert ECDH.ecdh(other_seckey, ECDSA.decompress_pubkey(p)) == ECDH.ecdh(other_seckey, p)
+  end
+
+  test "output modes", %{seckey: s, pubkey: p} do
+    {other_seckey, other_pubkey} = Secp256k1.keypair(:compressed)
+    point = ECDH.ecdh(s, other_pubkey, hash: :point)
+
+    assert byte_size(point) == 33
+    assert ECDH.ecdh(other_seckey, p, hash: :point) == point
+    assert ECDH.ecdh(s, other_pubkey, hash: :x) == binary_part(point, 1, 32)
+    assert ECDH.ecdh(s, other_pubkey, hash: :sha256) == :crypto.hash(:sha256, point)
+    assert ECDH.ecdh(s, other_pubkey) == :crypto.hash(:sha256, point)
+    assert ECDH.ecdh(ECDH.keypair(s), other_pubkey) == ECDH.ecdh(s, other_pubkey)
+  end
+
+  test "ecdh_many", %{seckey: s, pubkey: p} do
+    keypair = ECDH.keypair(s)
+
+    # large batches are computed on dirty scheduler
+    peers = for _ <- 1..100, do: elem(Secp256k1.keypair(:compressed), 1)
+    expected = Enum.map(peers, &ECDH.ecdh(s, &1, hash: :x))
+
+    assert ECDH.ecdh_many(keypair, peers, hash: :x) == expected
+    assert ECDH.ecdh_many(s, Enum.join(peers), hash: :x) == Enum.join(expected)
+    few = Enum.take(peers, 3)
+    assert ECDH.ecdh_many(s, few) == Enum.map(few, &ECDH.ecdh(s, &1))
+    assert ECDH.ecdh_many(s, []) == []
+    assert ECDH.ecdh_many(s, <<>>) == <<>>
+
+    # invalid pubkeys
+    invalid = <<2, 0::256>>
+    assert ECDH.ecdh_many(s, [invalid, ECDSA.decompress_pubkey(p)], hash: :point) ==
+             [nil, ECDH.ecdh(s, p, hash: :point)]
+    assert ECDH.ecdh_many(s, invalid <> p) == <<0::256>> <> ECDH.ecdh(s, p)
+
+    assert_raise ArgumentError, fn -> ECDH.ecdh_many(s, <<0::264, 1>>) end
+    assert_raise ArgumentError, fn -> ECDH.ecdh_many(s, [<<1, 2, 3>>]) end
+    assert_raise ArgumentError, fn -> ECDH.ecdh_many(<<0::256>>, [p]) end
+  end
+
+  test "invalid input", %{pubkey: p} do
+    assert_raise ArgumentError, fn -> ECDH.ecdh(<<0::256>>, p) end
+    assert_raise ArgumentError, fn -> ECDH.ecdh(<<1::256>>, <<1, 2, 3>>) end
+  end
+end
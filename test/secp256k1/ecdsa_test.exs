@@ -28,4 +28,128 @@ defmodule Secp256k1Test.ECDSA do
     assert ECDSA.compress_pubkey(pu) == pc
     assert ECDSA.decompress_pubkey(pc) == pu
   end
+
+  test "keypair", %{seckey: seckey, pubkey_compressed: pc} do
+    keypair = ECDSA.keypair(seckey)
+    msg_hash = :crypto.hash(:sha256, "keypair")
+
+    assert ECDSA.valid?(ECDSA.sign(msg_hash, keypair), msg_hash, pc)
+    assert ECDSA.sign(msg_hash, keypair, <<0::256>>) == ECDSA.sign(msg_hash, seckey, <<0::256>>)
+
+    assert_raise ArgumentError, fn -> ECDSA.keypair(<<0::256>>) end
+  end
+
+  test "valid_many", %{seckey: seckey, pubkey_compressed: pc, pubkey_uncompressed: pu} do
+    entries =
+      for i <- 1..20 do
+        msg_hash = :crypto.hash(:sha256, Integer.to_string(i))
+        sig = ECDSA.sign(msg_hash, seckey)
+        pubkey = if rem(i, 2) == 0, do: pc, else: pu
+
+        # every third signature is checked against a different message
+        if rem(i, 3) == 0,
+          do: {sig, :crypto.hash(:sha256, "other"), pubkey},
+          else: {sig, msg_hash, pubkey}
+      end
+
+    expected = for i <- 1..20, into: <<>>, do: if(rem(i, 3) == 0, do: <<0::1>>, else: <<1::1>>)
+
+    assert ECDSA.valid_many([]) == <<>>
+    assert ECDSA.valid_many(entries) == expected
+    assert ECDSA.valid_many(Enum.take(entries, 3)) == <<1::1, 1::1, 0::1>>
+
+    assert_raise ArgumentError, fn -> ECDSA.valid_many([{<<0>>, <<0>>, pc}]) end
+    assert_raise ArgumentError, fn -> ECDSA.valid_many([hd(entries) | hd(entries)]) end
+  end
+
+  test "iodata message", %{seckey: seckey, pubkey_compressed: pc} do
+    aux = :crypto.strong_rand_bytes(32)
+
+    # nested deeper than the native stack, bytes, improper tails and a large binary which makes
+    # the NIF yield
+    deep = Enum.reduce(1..200, ["core"], fn i, acc -> [acc, rem(i, 256) | "tail"] end)
+    large = :binary.copy(<<0xAB>>, 3_000_000)
+    message = [deep, [large | "end"], []]
+    flat = IO.iodata_to_binary(message)
+
+    signature = ECDSA.sign_message(message, seckey, aux: aux)
+    assert signature == ECDSA.sign(:crypto.hash(:sha256, flat), seckey, aux)
+    assert ECDSA.valid_message?(signature, flat, pc)
+    refute ECDSA.valid_message?(signature, [flat, 0], pc)
+
+    # BIP340 tagged hash
+    tag_hash = :crypto.hash(:sha256, "tag")
+    tagged = :crypto.hash(:sha256, [tag_hash, tag_hash, flat])
+    signature = ECDSA.sign_message(message, seckey, hash: {:tagged, "tag"}, aux: aux)
+    assert signature == ECDSA.sign(tagged, seckey, aux)
+    assert ECDSA.valid_message?(signature, message, pc, hash: {:tagged, "tag"})
+    refute ECDSA.valid_message?(signature, message, pc)
+
+    assert_raise ArgumentError, fn -> ECDSA.sign_message(["a", 256], seckey) end
+    assert_raise ArgumentError, fn -> ECDSA.sign_message([large, :atom], seckey) end
+  end
+
+  @order 0xFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFFEBAAEDCE6AF48A03BBFD25E8CD0364141
+
+  test "DER signatures", %{seckey: seckey, pubkey_compressed: pc, pubkey_uncompressed: pu} do
+    msg_hash = :crypto.hash(:sha256, "der")
+    signature = ECDSA.sign(msg_hash, seckey)
+    <<r::binary-32, s::256>> = signature
+    der = ECDSA.serialize_der(signature)
+
+    assert ECDSA.parse_der(der) == signature
+    assert ECDSA.parse_der(der, lax: true) == signature
+    assert ECDSA.valid?(der, msg_hash, pc)
+    assert ECDSA.valid?(der, msg_hash, pc, der: true)
+    refute ECDSA.valid?(der, :crypto.hash(:sha256, "other"), pc)
+
+    # high-S signature is valid only after normalization
+    high_s = <<r::binary, @order - s::256>>
+    assert ECDSA.normalize(high_s) == signature
+    refute ECDSA.valid?(high_s, msg_hash, pc)
+    assert ECDSA.valid?(high_s, msg_hash, pc, normalize: true)
+    refute ECDSA.valid?(ECDSA.serialize_der(high_s), msg_hash, pc)
+    assert ECDSA.valid?(ECDSA.serialize_der(high_s), msg_hash, pc, normalize: true)
+
+    # non-strict encoding with zero padding, long form lengths and trailing data
+    padded_r = <<0, 0, r::binary>>
+    padded_s = <<0, s::256>>
+    body = <<2, 0x81, byte_size(padded_r)>> <> padded_r <> <<2, byte_size(padded_s)>> <> padded_s
+    lax = <<0x30, 0x81, byte_size(body)>> <> body <> <<1>>
+
+    assert {:error, _} = ECDSA.parse_der(lax)
+    assert ECDSA.parse_der(lax, lax: true) == signature
+    assert ECDSA.valid?(lax, msg_hash, pc, lax: true)
+
+    # values which do not fit 32 bytes parse into never valid signature
+    overflow = <<0x30, 0x26, 2, 33, 1, r::binary, 2, 1, 1>>
+    assert ECDSA.parse_der(overflow, lax: true) == <<0::512>>
+    assert {:error, _} = ECDSA.parse_der(<<0x31, 0>>, lax: true)
+
+    assert ECDSA.valid_many([{der, msg_hash, pu}, {lax, msg_hash, pc}]) == <<1::1, 0::1>>
+    assert ECDSA.valid_many([{der, msg_hash, pu}, {lax, msg_hash, pc}], lax: true) ==
+             <<1::1, 1::1>>
+    assert ECDSA.valid_message?(der, "der", pc)
+  end
+
+  test "batch DER conversions", %{seckey: seckey} do
+    signatures =
+      for i <- 1..300, do: ECDSA.sign(:crypto.hash(:sha256, Integer.to_string(i)), seckey)
+
+    # large lists are converted on dirty scheduler
+    ders = ECDSA.serialize_der_many(signatures)
+    assert ders == Enum.map(signatures, &ECDSA.serialize_der/1)
+    assert ECDSA.parse_der_many(ders) == signatures
+    assert ECDSA.parse_der_many(ders, lax: true) == signatures
+    assert ECDSA.normalize_many(signatures) == signatures
+
+    high_s = for <<r::binary-32, s::256>> <- signatures, do: <<r::binary, @order - s::256>>
+    assert ECDSA.normalize_many(high_s) == signatures
+
+    assert ECDSA.parse_der_many([hd(ders), <<0x30>>, ""]) == [hd(signatures), nil, nil]
+    assert ECDSA.serialize_der_many([<<0xFF::512>>, <<0>>]) == [nil, nil]
+    assert ECDSA.normalize_many([]) == []
+
+    assert_raise ArgumentError, fn -> ECDSA.normalize_many([:not_binary]) end
+  end
 end
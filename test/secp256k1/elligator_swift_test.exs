@@ -0,0 +1,82 @@
+defmodule Secp256k1Test.ElligatorSwift do
+  use Secp256k1Test.Case, async: true
+
+  alias Secp256k1.ECDSA
+  alias Secp256k1.ElligatorSwift
+
+  doctest Secp256k1.ElligatorSwift
+
+  setup_all do
+    {:ok,
+     %{
+       seckey: d("1111111111111111111111111111111111111111111111111111111111111111"),
+       pubkey: d("034f355bdcb7cc0af728ef3cceb9615d90684bb5b2ca5f859ab0f0b704075871aa")
+     }}
+  end
+
+  test "encode and decode", %{seckey: seckey, pubkey: pubkey} do
+    ell = ElligatorSwift.create(seckey)
+
+    assert byte_size(ell) == 64
+    assert ElligatorSwift.decode(ell) == pubkey
+    assert ElligatorSwift.create(seckey) != ell
+
+    assert ElligatorSwift.decode(ElligatorSwift.encode(pubkey)) == pubkey
+    assert ElligatorSwift.decode(ElligatorSwift.encode(ECDSA.decompress_pubkey(pubkey))) == pubkey
+
+    # BIP324 decoding test vector
+    assert binary_part(ElligatorSwift.decode(<<0::512>>), 1, 32) ==
+             d("edd1fd3e327ce90cc7a3542614289aee9682003e9cf7dcc9cf2ca9743be5aa0c")
+  end
+
+  test "xdh", %{seckey: seckey} do
+    {other_seckey, _} = Secp256k1.keypair(:compressed)
+    ell_a = ElligatorSwift.create(seckey)
+    ell_b = ElligatorSwift.create(other_seckey)
+
+    secret = ElligatorSwift.xdh(ell_a, ell_b, seckey, :initiator)
+    assert secret == ElligatorSwift.xdh(ell_a, ell_b, other_seckey, :responder)
+
+    # both encodings are part of the hash
+    other_ell_b = ElligatorSwift.create(other_seckey)
+    assert secret != ElligatorSwift.xdh(ell_a, other_ell_b, seckey, :initiator)
+    assert secret != ElligatorSwift.xdh(ell_b, ell_a, other_seckey, :initiator)
+  end
+
+  test "xdh BIP324 test vector" do
+    # packet encoding test vector 0 (initiating side)
+    seckey = d("61062ea5071d800bbfd59e2e8b53d47d194b095ae5a4df04936b49772ef0d4d7")
+
+    ours =
+      d(
+        "ec0adff257bbfe500c188c80b4fdd640f6b45a482bbc15fc7cef5931deff0aa1" <>
+          "86f6eb9bba7b85dc4dcc28b28722de1e3d9108b985e2967045668f66098e475b"
+      )
+
+    theirs =
+      d(
+        "a4a94dfce69b4a2a0a099313d10f9f7e7d649d60501c9e1d274c300e0d89aafa" <>
+          "ffffffffffffffffffffffffffffffffffffffffffffffffffffffff8faf88d5"
+      )
+
+    assert binary_part(ElligatorSwift.decode(ours), 1, 32) ==
+             binary_part(Secp256k1.pubkey(seckey, :compressed), 1, 32)
+
+    assert ElligatorSwift.xdh(ours, theirs, seckey, :initiator) ==
+             d("c6992a117f5edbea70c3f511d32d26b9798be4b81a62eaee1a5acaa8459a3592")
+
+    # same keys with the roles swapped hash the encodings in the other order
+    assert ElligatorSwift.xdh(theirs, ours, seckey, :responder) ==
+             d("81200f7148e18134225fe45b82d5bb5e4e29e7fd66bdad1c8eeacf4498ee2850")
+  end
+
+  test "invalid input", %{seckey: seckey} do
+    ell = ElligatorSwift.create(seckey)
+
+    assert_raise ArgumentError, fn -> ElligatorSwift.create(<<0::256>>) end
+    assert_raise ArgumentError, fn -> ElligatorSwift.encode(<<1, 2, 3>>) end
+    assert_raise ArgumentError, fn -> ElligatorSwift.decode(<<0::256>>) end
+    assert_raise ArgumentError, fn -> ElligatorSwift.xdh(ell, <<0::256>>, seckey, :initiator) end
+    assert_raise FunctionClauseError, fn -> ElligatorSwift.xdh(ell, ell, seckey, :other) end
+  end
+end
@@ -15,5 +15,64 @@ defmodule Secp256k1Test.Extrakeys do
 
   test "successful", %{seckey: s, pubkey: p} do
     assert Extrakeys.xonly_pubkey(s) == p
+    assert Extrakeys.xonly_from_pubkey(<<3>> <> p) == {p, 1}
+    assert Extrakeys.xonly_from_pubkey(<<2>> <> p) == {p, 0}
+  end
+
+  # BIP341 wallet test vectors
+  @taproot [
+    {d("d6889cb081036e0faefa3a35157ad71086b123b2b144b649798b494c300a961d"), nil,
+     d("53a1f6e454df1aa2776a2814a721372d6258050de330b3c6d10ee8f4e0dda343")},
+    {d("187791b6f712a8ea41c8ecdd0ee77fab3e85263b37e1ec18a3651926b3a6cf27"),
+     d("5b75adecf53548f3ec6ad7d78383bf84cc57b55a3127c72b9a2481752dd88b21"),
+     d("147c9c57132f6e7ecddba9800bb0c4449251c92a1e60371ee77557b6620f3ea3")}
+  ]
+
+  test "taproot output keys" do
+    for {internal, merkle_root, output} <- @taproot do
+      assert {^output, parity} = Extrakeys.taproot_output_key(internal, merkle_root)
+      tweak = :crypto.hash(:sha256, [tagged("TapTweak"), internal, merkle_root || <<>>])
+      assert Extrakeys.tweak_add(internal, tweak) == {output, parity}
+      assert Extrakeys.tweak_add_check(output, parity, internal, tweak)
+      refute Extrakeys.tweak_add_check(output, 1 - parity, internal, tweak)
+    end
+
+    [{internal, nil, output}, {internal_script, merkle_root, output_script}] = @taproot
+
+    assert [{^output, _}, {^output_script, _}, nil] =
+             Extrakeys.taproot_output_keys([internal, {internal_script, merkle_root}, <<0::256>>])
+
+    # large lists on dirty scheduler
+    items = for _ <- 1..100, do: {internal, :crypto.strong_rand_bytes(32)}
+    expected = Enum.map(items, fn {i, t} -> Extrakeys.tweak_add(i, t) end)
+    assert Extrakeys.tweak_add_many(items) == expected
+  end
+
+  test "tweak seckey", %{seckey: s, pubkey: p} do
+    tweaked = d("9dc320ff4d5f43b00f9571eb7e105b227769df66f2c7a4f82708f9da235785d0")
+    output = d("2a64b1ee3375f3bb4b367b8cb8384a47f73cf231717f827c6c6fbbf5aecf0c36")
+
+    assert Extrakeys.taproot_seckey(s) == tweaked
+    assert Extrakeys.taproot_output_key(p) == {output, 1}
+    assert Extrakeys.xonly_pubkey(tweaked) == output
+
+    tweak = :crypto.strong_rand_bytes(32)
+    {output, _parity} = Extrakeys.tweak_add(p, tweak)
+    assert Extrakeys.xonly_pubkey(Extrakeys.tweak_seckey(s, tweak)) == output
+  end
+
+  test "invalid input", %{seckey: s, pubkey: p} do
+    assert_raise ArgumentError, fn -> Extrakeys.tweak_add(p, <<1>>) end
+    assert_raise ArgumentError, fn -> Extrakeys.tweak_add_check(p, 2, p, <<0::256>>) end
+    assert_raise ArgumentError, fn -> Extrakeys.taproot_output_key(p, <<1>>) end
+    assert_raise ArgumentError, fn -> Extrakeys.tweak_seckey(<<0::256>>, <<0::256>>) end
+    assert_raise ArgumentError, fn -> Extrakeys.tweak_add_many([p]) end
+    assert {:error, _} = Extrakeys.tweak_add(p, <<0xFF::256>>)
+    assert_raise ArgumentError, fn -> Extrakeys.taproot_seckey(s, <<1>>) end
+  end
+
+  defp tagged(tag) do
+    tag_hash = :crypto.hash(:sha256, tag)
+    tag_hash <> tag_hash
   end
 end
@@ -0,0 +1,78 @@
+defmodule Secp256k1Test.KeyRange do
+  use Secp256k1Test.Case, async: true
+
+  alias Secp256k1.KeyRange
+
+  doctest Secp256k1.KeyRange
+
+  setup_all do
+    {:ok,
+     %{
+       seckey: d("eea73e861ec4ebda129c8fac849d28a244d43e0e51092736a704732c5377e9d2")
+     }}
+  end
+
+  defp add(seckey, i) do
+    <<n::256>> = seckey
+    <<n + i::256>>
+  end
+
+  test "pubkeys", %{seckey: s} do
+    assert KeyRange.pubkeys(s, 0) == []
+
+    for type <- [:compressed, :xonly] do
+      expected = for i <- 0..99, do: Secp256k1.pubkey(add(s, i), type)
+      assert KeyRange.pubkeys(s, 100, type) == expected
+    end
+
+    # large range on dirty scheduler
+    assert length(KeyRange.pubkeys(s, 1000)) == 1000
+  end
+
+  test "find", %{seckey: s} do
+    prefix = KeyRange.hex_prefix("ab")
+
+    {matches, tried} = KeyRange.find(s, prefix: prefix, threads: 4, count: 4096)
+
+    assert tried == 4096
+    assert matches != []
+
+    for {seckey, pubkey} <- matches do
+      assert <<0xAB, _::binary>> = pubkey
+      assert Secp256k1.pubkey(seckey, :xonly) == pubkey
+    end
+
+    # same matches as walking the range sequentially
+    expected =
+      s
+      |> KeyRange.pubkeys(4096, :xonly)
+      |> Enum.filter(&match?(<<0xAB, _::binary>>, &1))
+
+    assert Enum.sort(Enum.map(matches, &elem(&1, 1))) == Enum.sort(expected)
+  end
+
+  test "find compressed with limit", %{seckey: s} do
+    prefix = KeyRange.hex_prefix("03")
+
+    {[{seckey, pubkey}], _tried} = KeyRange.find(s, prefix: prefix, type: :compressed, limit: 1)
+
+    assert <<0x03, _::binary>> = pubkey
+    assert Secp256k1.pubkey(seckey, :compressed) == pubkey
+  end
+
+  test "stop", %{seckey: s} do
+    # 64 bits prefix is practically never found
+    {:ok, ref, grinder} = KeyRange.grind(s, prefix: <<0::64>>, threads: 2)
+
+    assert KeyRange.stop(grinder) == :ok
+    assert_receive {^ref, {:done, tried}}
+    assert is_integer(tried)
+
+    assert {[], _tried} = KeyRange.find(s, prefix: <<0::64>>, timeout: 50)
+  end
+
+  test "npub prefix" do
+    # "40x" are the 5 bit groups 10101 01111 00110
+    assert KeyRange.npub_prefix("npub140x") == <<0xAB, 0x66::7>>
+  end
+end
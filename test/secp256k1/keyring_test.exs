@@ -0,0 +1,57 @@
+defmodule Secp256k1Test.Keyring do
+  use Secp256k1Test.Case, async: true
+
+  alias Secp256k1.ECDSA
+  alias Secp256k1.Keyring
+  alias Secp256k1.Schnorr
+
+  doctest Secp256k1.Keyring
+
+  setup_all do
+    {:ok,
+     %{
+       seckey: d("1111111111111111111111111111111111111111111111111111111111111111"),
+       pubkey_xonly: d("4f355bdcb7cc0af728ef3cceb9615d90684bb5b2ca5f859ab0f0b704075871aa"),
+       pubkey_compressed: d("034f355bdcb7cc0af728ef3cceb9615d90684bb5b2ca5f859ab0f0b704075871aa"),
+       msg_hash: :crypto.hash(:sha256, "keyring")
+     }}
+  end
+
+  test "successful", %{seckey: s, pubkey_xonly: px, pubkey_compressed: pc, msg_hash: msg_hash} do
+    keyring = Keyring.new()
+    assert Keyring.size(keyring) == 0
+
+    # fill keyring past initial capacity
+    for i <- 0..99, do: assert(Keyring.add(keyring, elem(Secp256k1.keypair(:compressed), 1)) == i)
+
+    xonly = Keyring.add(keyring, px)
+    compressed = Keyring.add(keyring, pc)
+    uncompressed = Keyring.add(keyring, ECDSA.decompress_pubkey(pc))
+    assert Keyring.size(keyring) == 103
+
+    ecdsa_sig = ECDSA.sign(msg_hash, s)
+    assert Keyring.ecdsa_valid?(keyring, compressed, ecdsa_sig, msg_hash)
+    assert Keyring.ecdsa_valid?(keyring, uncompressed, ecdsa_sig, msg_hash)
+    refute Keyring.ecdsa_valid?(keyring, 0, ecdsa_sig, msg_hash)
+
+    schnorr_sig = Schnorr.sign(msg_hash, s)
+    assert Keyring.schnorr_valid?(keyring, xonly, schnorr_sig, msg_hash)
+    assert Keyring.schnorr_valid?(keyring, compressed, schnorr_sig, msg_hash)
+    refute Keyring.schnorr_valid?(keyring, 0, schnorr_sig, msg_hash)
+
+    {other_seckey, other_pubkey} = Secp256k1.keypair(:compressed)
+    other = Keyring.add(keyring, other_pubkey)
+    assert Keyring.ecdh(keyring, other, s) == Keyring.ecdh(keyring, compressed, other_seckey)
+  end
+
+  test "invalid input", %{pubkey_xonly: px, msg_hash: msg_hash} do
+    keyring = Keyring.new()
+
+    assert {:error, _} = Keyring.add(keyring, <<5::264>>)
+    assert_raise ArgumentError, fn -> Keyring.add(keyring, <<1, 2, 3>>) end
+
+    index = Keyring.add(keyring, px)
+    assert_raise ArgumentError, fn -> Keyring.ecdsa_valid?(keyring, index + 1, <<0::512>>, msg_hash) end
+    assert_raise ArgumentError, fn -> Keyring.schnorr_valid?(make_ref(), index, <<0::512>>, msg_hash) end
+  end
+end
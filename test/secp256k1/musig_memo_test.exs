@@ -0,0 +1,48 @@
+defmodule Secp256k1.MuSigMemoTest do
+  # the memo is shared by the whole VM
+  use Secp256k1Test.Case, async: false
+
+  alias Secp256k1.MuSig
+
+  setup do
+    %{size: size} = MuSig.keyagg_memo_info()
+    on_exit(fn -> MuSig.keyagg_memo_configure(size) end)
+  end
+
+  test "repeated aggregation returns memoized cache" do
+    pubkeys = for _ <- 1..20, do: elem(Secp256k1.keypair(:compressed), 1)
+
+    {:ok, agg_pubkey, cache} = MuSig.pubkey_agg(pubkeys, sort: true)
+    %{hits: hits} = MuSig.keyagg_memo_info()
+
+    assert {:ok, ^agg_pubkey, ^cache} = MuSig.pubkey_agg(Enum.shuffle(pubkeys), sort: true)
+    assert MuSig.keyagg_memo_info().hits == hits + 1
+
+    # unsorted aggregation of different order is a different key set
+    assert {:ok, _, other} = MuSig.pubkey_agg(Enum.reverse(pubkeys))
+    assert other != cache
+
+    # bypassing the memo builds a new cache of the same key
+    assert {:ok, ^agg_pubkey, fresh} = MuSig.pubkey_agg(pubkeys, sort: true, memo: false)
+    assert fresh != cache
+    assert MuSig.pubkey_get(fresh) == MuSig.pubkey_get(cache)
+  end
+
+  test "configure" do
+    assert MuSig.keyagg_memo_configure(16) == :ok
+    assert %{size: 16, entries: 0} = MuSig.keyagg_memo_info()
+
+    {_, pubkey} = Secp256k1.keypair(:compressed)
+    {:ok, _, cache} = MuSig.pubkey_agg([pubkey])
+    assert %{entries: 1} = MuSig.keyagg_memo_info()
+
+    # resizing drops entries, returned caches stay usable
+    assert MuSig.keyagg_memo_configure(0) == :ok
+    assert %{size: 0, entries: 0} = MuSig.keyagg_memo_info()
+    assert {:ok, _, other} = MuSig.pubkey_agg([pubkey])
+    assert other != cache
+    assert MuSig.pubkey_get(other) == MuSig.pubkey_get(cache)
+
+    assert_raise FunctionClauseError, fn -> MuSig.keyagg_memo_configure(-1) end
+  end
+end
@@ -4,6 +4,8 @@ defmodule Secp256k1.MuSigTest do
   alias Secp256k1.MuSig
   alias Secp256k1.Schnorr
 
+  doctest Secp256k1.MuSig
+
   test "3-of-3 signing flow" do
     msg = :crypto.strong_rand_bytes(32)
 
@@ -38,7 +40,7 @@ defmodule Secp256k1.MuSigTest do
 
     # 5. Process nonces (create session)
     session = MuSig.nonce_process(aggnonce, msg, cache)
-    assert byte_size(session) == 133
+    assert is_reference(session)
 
     # 6. Partial signing
     signers =
@@ -84,4 +86,145 @@ defmodule Secp256k1.MuSigTest do
     # Second sign with same nonce resource should fail
     assert {:error, "nonce already used"} = MuSig.partial_sign(secnonce, seckey, cache, session)
   end
+
+  test "nonce pool" do
+    signers = for _ <- 1..2, do: Secp256k1.keypair(:compressed)
+    {:ok, agg_pubkey, cache} = signers |> Enum.map(&elem(&1, 1)) |> MuSig.pubkey_agg()
+    msg = :crypto.strong_rand_bytes(32)
+
+    pools = for {seckey, pubkey} <- signers, do: MuSig.nonce_pool(seckey, pubkey, depth: 8)
+    assert Enum.all?(pools, &wait_for_pool/1)
+
+    nonces = for pool <- pools, do: MuSig.nonce_pool_take(pool)
+    aggnonce = nonces |> Enum.map(&elem(&1, 2)) |> MuSig.nonce_agg()
+    session = MuSig.nonce_process(aggnonce, msg, cache)
+
+    sigs =
+      for {{seckey, _}, {:ok, secnonce, _}} <- Enum.zip(signers, nonces),
+          do: MuSig.partial_sign(secnonce, seckey, cache, session)
+
+    assert Schnorr.valid?(MuSig.partial_sig_agg(session, sigs), msg, agg_pubkey)
+
+    # every pair is handed out once, an empty pool generates on the spot
+    [pool | _] = pools
+    :ok = MuSig.nonce_pool_configure(pool, rate: 1)
+    pubnonces = for _ <- 1..10, do: pool |> MuSig.nonce_pool_take() |> elem(2)
+    assert length(Enum.uniq(pubnonces)) == 10
+    assert %{taken: taken, misses: misses, rate: 1} = MuSig.nonce_pool_info(pool)
+    assert taken + misses == 11
+    assert misses >= 1
+
+    assert :ok = MuSig.nonce_pool_configure(pool, depth: 2)
+    assert MuSig.nonce_pool_info(pool).available <= 2
+
+    {_, other_pubkey} = Secp256k1.keypair(:compressed)
+    assert_raise ArgumentError, fn -> MuSig.nonce_pool(nil, <<0::264>>) end
+    assert_raise ArgumentError, fn -> MuSig.nonce_pool(<<0::256>>, other_pubkey) end
+    assert_raise ArgumentError, fn -> MuSig.nonce_pool(nil, other_pubkey, depth: 0) end
+  end
+
+  test "aggregation of many keys" do
+    pubkeys = for _ <- 1..200, do: elem(Secp256k1.keypair(:compressed), 1)
+
+    {:ok, agg_pubkey, cache} = MuSig.pubkey_agg(pubkeys)
+    assert {:ok, ^agg_pubkey, other_cache} = MuSig.pubkey_agg(pubkeys)
+    assert MuSig.pubkey_get(cache) == MuSig.pubkey_get(other_cache)
+  end
+
+  test "sorted aggregation" do
+    seckeys = for _ <- 1..5, do: elem(Secp256k1.keypair(:compressed), 0)
+    pubkeys = Enum.map(seckeys, &Secp256k1.ECDSA.pubkey/1)
+    sorted = Enum.sort(pubkeys)
+
+    {:ok, agg_pubkey, _} = MuSig.pubkey_agg(sorted)
+    assert {:ok, ^agg_pubkey, _} = MuSig.pubkey_agg(Enum.reverse(pubkeys), sort: true)
+    assert {:ok, ^agg_pubkey, _} =
+             MuSig.pubkey_agg(Enum.shuffle(pubkeys), sort: true, memo: false)
+    assert {:ok, other, _} = MuSig.pubkey_agg(Enum.reverse(sorted))
+    assert other != agg_pubkey
+
+    # uncompressed keys sort by their compressed serialization
+    uncompressed = Enum.map(seckeys, &Secp256k1.ECDSA.uncompressed_pubkey/1)
+    assert {:ok, ^agg_pubkey, _} = MuSig.pubkey_agg(uncompressed, sort: true)
+
+    assert_raise ArgumentError, fn -> MuSig.pubkey_agg([], sort: true) end
+    assert_raise ArgumentError, fn -> MuSig.pubkey_agg([<<2, 0::256>>], sort: true) end
+  end
+
+  test "native cache and session" do
+    {seckey, pubkey} = Secp256k1.keypair(:compressed)
+    {_, other_pubkey} = Secp256k1.keypair(:compressed)
+    {:ok, agg_pubkey, cache} = MuSig.pubkey_agg([pubkey, other_pubkey])
+    assert is_reference(cache)
+    assert binary_part(MuSig.pubkey_get(cache), 1, 32) == agg_pubkey
+
+    # tweaking returns new cache and leaves the original one untouched
+    tweak = :crypto.hash(:sha256, "tweak")
+    {:ok, tweaked, tweaked_pubkey} = MuSig.pubkey_xonly_tweak_add(cache, tweak)
+    assert MuSig.pubkey_get(tweaked) == tweaked_pubkey
+    assert binary_part(MuSig.pubkey_get(cache), 1, 32) == agg_pubkey
+    assert {:ok, _, _} = MuSig.pubkey_ec_tweak_add(cache, tweak)
+
+    # raw binaries are no longer accepted in place of the resources
+    msg = :crypto.strong_rand_bytes(32)
+    {:ok, secnonce, pubnonce} = MuSig.nonce_gen(seckey, pubkey, msg, cache, nil)
+    assert_raise ArgumentError, fn -> MuSig.pubkey_get(:binary.copy(<<0>>, 197)) end
+    assert_raise ArgumentError, fn -> MuSig.nonce_gen(seckey, pubkey, msg, <<0::1576>>, nil) end
+
+    session = MuSig.nonce_process(MuSig.nonce_agg([pubnonce, pubnonce]), msg, cache)
+    assert_raise ArgumentError, fn -> MuSig.partial_sign(secnonce, seckey, cache, cache) end
+    assert_raise ArgumentError, fn -> MuSig.partial_sig_agg(cache, []) end
+    assert is_binary(MuSig.partial_sign(secnonce, seckey, cache, session))
+  end
+
+  test "verify partial signatures of all signers" do
+    msg = :crypto.strong_rand_bytes(32)
+    signers = for _ <- 1..4, do: Secp256k1.keypair(:compressed)
+    {:ok, agg_pubkey, cache} = signers |> Enum.map(&elem(&1, 1)) |> MuSig.pubkey_agg()
+
+    nonces =
+      for {seckey, pubkey} <- signers do
+        {:ok, secnonce, pubnonce} = MuSig.nonce_gen(seckey, pubkey, msg, cache, nil)
+        {secnonce, pubnonce}
+      end
+
+    aggnonce = nonces |> Enum.map(&elem(&1, 1)) |> MuSig.nonce_agg()
+    session = MuSig.nonce_process(aggnonce, msg, cache)
+
+    entries =
+      for {{seckey, pubkey}, {secnonce, pubnonce}} <- Enum.zip(signers, nonces) do
+        {MuSig.partial_sign(secnonce, seckey, cache, session), pubnonce, pubkey}
+      end
+
+    assert MuSig.partial_sig_verify_many(session, cache, entries) == :ok
+
+    assert {:ok, signature} =
+             MuSig.partial_sig_verify_many(session, cache, entries, aggregate: true)
+
+    assert Schnorr.valid?(signature, msg, agg_pubkey)
+
+    packed = for {psig, pubnonce, pubkey} <- entries, into: <<>>, do: psig <> pubnonce <> pubkey
+
+    assert {:ok, ^signature} =
+             MuSig.partial_sig_verify_many(session, cache, packed, aggregate: true)
+
+    # signer 1 sends signature of signer 2, signer 3 garbage
+    [e0, {_, n1, p1}, {s2, _, _} = e2, {_, n3, p3}] = entries
+    bad = [e0, {s2, n1, p1}, e2, {<<0xFF::256>>, n3, p3}]
+    assert MuSig.partial_sig_verify_many(session, cache, bad, aggregate: true) == {:error, [1, 3]}
+
+    assert_raise ArgumentError, fn -> MuSig.partial_sig_verify_many(session, cache, []) end
+    assert_raise ArgumentError, fn -> MuSig.partial_sig_verify_many(session, cache, <<0>>) end
+    assert_raise ArgumentError, fn -> MuSig.partial_sig_verify_many(cache, session, entries) end
+  end
+
+  defp wait_for_pool(pool, attempts \\ 100) do
+    case MuSig.nonce_pool_info(pool) do
+      %{available: available, depth: depth} when available == depth -> true
+      _ when attempts == 0 -> false
+      _ ->
+        Process.sleep(10)
+        wait_for_pool(pool, attempts - 1)
+    end
+  end
 end
@@ -0,0 +1,92 @@
+defmodule Secp256k1Test.Nostr do
+  use Secp256k1Test.Case, async: true
+
+  alias Secp256k1.Nostr
+  alias Secp256k1.Schnorr
+
+  doctest Secp256k1.Nostr
+
+  setup_all do
+    seckey = d("1111111111111111111111111111111111111111111111111111111111111111")
+    pubkey = "4f355bdcb7cc0af728ef3cceb9615d90684bb5b2ca5f859ab0f0b704075871aa"
+
+    event = %{
+      "pubkey" => pubkey,
+      "created_at" => 1_700_000_000,
+      "kind" => 1,
+      "tags" => [
+        [
+          "e",
+          "5c83da77af1dec6d7289834998ad7aafbd9e2191396d75ec3cc27f5a77226f36",
+          "wss://relay.example"
+        ],
+        ["p", pubkey],
+        ["t"]
+      ],
+      "content" => "hello \"nostr\"\n\ttabs\\slash\r\b\f ünïcødé ⚡"
+    }
+
+    {:ok, %{seckey: seckey, event: event}}
+  end
+
+  test "event id", %{event: event} do
+    # expected ids computed from the canonical JSON serialization
+    assert e(Nostr.event_id(event)) ==
+             "9a1722a212790e4caf3a402b33b4c70b1c3e60a32e81570c892d091bb9d03f06"
+
+    empty = %{pubkey: event["pubkey"], created_at: 0, kind: 0, tags: [], content: ""}
+    assert e(Nostr.event_id(empty)) ==
+             "7643fe9d5e608d46dea2a62c4577c09fcbb3c677a39bd880f9200ea61b1d4eac"
+
+    assert_raise ArgumentError, fn -> Nostr.event_id(%{event | "tags" => [[1]]}) end
+    upper = %{event | "pubkey" => String.upcase(event["pubkey"])}
+    assert_raise ArgumentError, fn -> Nostr.event_id(upper) end
+  end
+
+  test "verify events", %{seckey: seckey, event: event} do
+    signed = sign(event, seckey)
+    {other_seckey, _} = Secp256k1.keypair(:xonly)
+    other = sign(event, other_seckey)
+
+    assert Nostr.verify_event(signed) == :ok
+    assert Nostr.valid_event?(signed)
+    assert Nostr.verify_event(%{signed | "kind" => 2}) == {:error, :invalid_id}
+    assert Nostr.verify_event(%{signed | "sig" => other["sig"]}) == {:error, :invalid_sig}
+    assert Nostr.verify_event(Map.delete(signed, "sig")) == {:error, :malformed}
+    assert Nostr.verify_event(%{signed | "id" => "00"}) == {:error, :malformed}
+    refute Nostr.valid_event?(:not_an_event)
+
+    # atom keys
+    atom_keys = Map.new(signed, fn {k, v} -> {String.to_atom(k), v} end)
+    assert Nostr.verify_event(atom_keys) == :ok
+
+    # large batches are verified on dirty scheduler
+    events =
+      for i <- 1..100 do
+        signed = sign(%{event | "created_at" => i}, seckey)
+        if rem(i, 10) == 0, do: %{signed | "content" => "changed"}, else: signed
+      end
+
+    expected = for i <- 1..100, do: if(rem(i, 10) == 0, do: {:error, :invalid_id}, else: :ok)
+    assert Nostr.verify_events(events) == expected
+    assert Nostr.verify_events([]) == []
+  end
+
+  test "contact list", %{seckey: seckey, event: event} do
+    # ~370 kB of tags, past a timeslice of hashing so it runs on a dirty scheduler
+    tags = for i <- 1..5000, do: ["p", e(:crypto.hash(:sha256, <<i::32>>))]
+    contacts = %{event | "kind" => 3, "tags" => tags, "content" => ""}
+
+    json =
+      ~s([0,"#{event["pubkey"]}",1700000000,3,[) <>
+        Enum.map_join(tags, ",", fn [p, key] -> ~s(["#{p}","#{key}"]) end) <> ~s(],""])
+
+    assert Nostr.event_id(contacts) == :crypto.hash(:sha256, json)
+    assert Nostr.verify_event(sign(contacts, seckey)) == :ok
+  end
+
+  defp sign(event, seckey) do
+    id = Nostr.event_id(event)
+    Map.merge(event, %{"id" => e(id), "sig" => e(Schnorr.sign(id, seckey))})
+  end
+end
@@ -0,0 +1,64 @@
+defmodule Secp256k1Test.Recovery do
+  use Secp256k1Test.Case, async: true
+
+  alias Secp256k1.ECDSA
+  alias Secp256k1.Recovery
+
+  doctest Secp256k1.Recovery
+
+  setup_all do
+    {:ok,
+     %{
+       seckey: d("1111111111111111111111111111111111111111111111111111111111111111"),
+       pubkey_compressed: d("034f355bdcb7cc0af728ef3cceb9615d90684bb5b2ca5f859ab0f0b704075871aa"),
+       pubkey_uncompressed:
+         d(
+           "044f355bdcb7cc0af728ef3cceb9615d90684bb5b2ca5f859ab0f0b704075871aa385b6b1b8ead809ca67454d9683fcf2ba03456d6fe2c4abe2b07f0fbdbb2f1c1"
+         ),
+       msg_hash: :crypto.hash(:sha256, "recovery")
+     }}
+  end
+
+  test "successful", %{seckey: s, pubkey_compressed: pc, pubkey_uncompressed: pu, msg_hash: m} do
+    signature = Recovery.sign(m, s)
+    assert byte_size(signature) == 65
+
+    assert Recovery.recover(signature, m) == pc
+    assert Recovery.recover(signature, m, :uncompressed) == pu
+
+    {compact, recid} = Recovery.serialize_compact(signature)
+    assert recid in 0..3
+    assert Recovery.parse_compact(compact, recid) == signature
+    assert Recovery.to_ecdsa(signature) == compact
+    assert ECDSA.valid?(Recovery.to_ecdsa(signature), m, pc)
+
+    # same nonce as plain ECDSA signature
+    aux = :crypto.strong_rand_bytes(32)
+    assert Recovery.to_ecdsa(Recovery.sign(m, s, aux)) == ECDSA.sign(m, s, aux)
+  end
+
+  test "recover many", %{seckey: s, pubkey_uncompressed: pu, msg_hash: m} do
+    signature = Recovery.sign(m, s)
+    other_hash = :crypto.hash(:sha256, "other")
+
+    # large enough to run on dirty scheduler
+    items = List.duplicate({signature, m}, 100) ++ [{<<1, 2, 3>>, m}]
+    assert Recovery.recover_many(items, :uncompressed) == List.duplicate(pu, 100) ++ [nil]
+
+    # valid signature of different message recovers different key
+    assert [pubkey] = Recovery.recover_many([{signature, other_hash}], :uncompressed)
+    assert pubkey != pu
+
+    assert Recovery.recover_many([]) == []
+  end
+
+  test "invalid input", %{seckey: s, msg_hash: m} do
+    signature = Recovery.sign(m, s)
+    <<compact::binary-64, _recid>> = signature
+
+    assert_raise ArgumentError, fn -> Recovery.recover(compact <> <<4>>, m) end
+    assert_raise ArgumentError, fn -> Recovery.parse_compact(compact, 4) end
+    assert_raise ArgumentError, fn -> Recovery.recover_many([{signature, <<1>>}]) end
+    assert_raise FunctionClauseError, fn -> Recovery.sign(m, <<1>>) end
+  end
+end
@@ -40,4 +40,86 @@ defmodule Secp256k1Test.Schnorr do
     assert Schnorr.valid?(sig, msg_hash, p)
     refute Schnorr.valid?(sig, msg, p)
   end
+
+  test "keypair", %{seckey: s, pubkey: p, message: msg, message_hash: msg_hash} do
+    keypair = Schnorr.keypair(s)
+    assert Schnorr.xonly_pubkey(keypair) == p
+
+    assert Schnorr.valid?(Schnorr.sign(msg, keypair), msg, p)
+    assert Schnorr.valid?(Schnorr.sign(msg_hash, keypair), msg_hash, p)
+    assert Schnorr.sign32(msg_hash, keypair, <<0::256>>) == Schnorr.sign32(msg_hash, s, <<0::256>>)
+
+    assert_raise ArgumentError, fn -> Schnorr.keypair(<<0::256>>) end
+    assert_raise ArgumentError, fn -> Schnorr.sign32(msg_hash, make_ref(), <<0::256>>) end
+  end
+
+  test "signing across schedulers", %{seckey: s, pubkey: p} do
+    # enough signatures for every scheduler context to be re-randomized a few times
+    1..5_000
+    |> Task.async_stream(
+      fn i ->
+        msg_hash = :crypto.hash(:sha256, Integer.to_string(i))
+        Schnorr.valid?(Schnorr.sign(msg_hash, s), msg_hash, p)
+      end,
+      ordered: false
+    )
+    |> Enum.each(fn result -> assert result == {:ok, true} end)
+  end
+
+  test "large message", %{seckey: s, pubkey: p} do
+    msg = :crypto.strong_rand_bytes(1_000_000)
+    sig = Schnorr.sign(msg, s)
+
+    assert Schnorr.valid?(sig, msg, p)
+    refute Schnorr.valid?(sig, binary_part(msg, 1, 999_999), p)
+  end
+
+  test "batch", %{seckey: s, pubkey: p, message: msg, message_hash: msg_hash} do
+    batch =
+      for i <- 1..40 do
+        msg = msg <> Integer.to_string(i)
+        {Schnorr.sign(msg, s), msg, p}
+      end
+
+    assert Schnorr.valid_batch?([])
+    assert Schnorr.valid_batch?(batch)
+    assert Schnorr.verify_batch(batch) == :ok
+
+    # invalid signature in the small and in the dirty scheduler path
+    bad = {Schnorr.sign(msg, s), msg_hash, p}
+
+    refute Schnorr.valid_batch?([bad])
+    refute Schnorr.valid_batch?(batch ++ [bad])
+    assert Schnorr.verify_batch([bad | batch] ++ [bad]) == {:error, [0, 41]}
+
+    # malformed entries
+    assert_raise ArgumentError, fn -> Schnorr.valid_batch?([{<<0>>, msg, p}]) end
+    assert_raise ArgumentError, fn -> Schnorr.verify_batch([{bad}]) end
+  end
+
+  test "iodata message", %{seckey: s, pubkey: p} do
+    aux = :crypto.strong_rand_bytes(32)
+    keypair = Schnorr.keypair(s)
+
+    # large binary split over many list entries makes the NIF yield
+    message = for i <- 1..1000, do: [Integer.to_string(i), :binary.copy(<<i>>, 3000)]
+    flat = IO.iodata_to_binary(message)
+    msg_hash = :crypto.hash(:sha256, flat)
+
+    signature = Schnorr.sign_message(message, keypair, aux: aux)
+    assert signature == Schnorr.sign32(msg_hash, s, aux)
+    assert Schnorr.valid_message?(signature, flat, p)
+    assert Schnorr.valid?(signature, msg_hash, p)
+
+    # BIP340 tagged hash
+    tag_hash = :crypto.hash(:sha256, "BIP0340/challenge")
+    tagged = :crypto.hash(:sha256, [tag_hash, tag_hash, flat])
+    signature = Schnorr.sign_message(message, s, hash: {:tagged, "BIP0340/challenge"}, aux: aux)
+    assert signature == Schnorr.sign32(tagged, s, aux)
+    assert Schnorr.valid_message?(signature, message, p, hash: {:tagged, "BIP0340/challenge"})
+    refute Schnorr.valid_message?(signature, message, p)
+
+    assert_raise ArgumentError, fn -> Schnorr.sign_message(["a", -1], s) end
+    assert_raise ArgumentError, fn -> Schnorr.valid_message?(<<0::512>>, "a", <<0::264>>) end
+  end
 end
@@ -0,0 +1,94 @@
+defmodule Secp256k1Test.SigCache do
+  # the cache is shared by the whole VM
+  use Secp256k1Test.Case, async: false
+
+  alias Secp256k1.ECDSA
+  alias Secp256k1.Nostr
+  alias Secp256k1.Schnorr
+  alias Secp256k1.SigCache
+
+  doctest Secp256k1.SigCache
+
+  setup do
+    :ok = SigCache.configure(65_536)
+    on_exit(fn -> SigCache.configure(0) end)
+  end
+
+  test "configure" do
+    assert SigCache.stats().bytes > 0
+    assert SigCache.stats().bytes <= 65_536
+    assert SigCache.stats().entries == 0
+
+    assert SigCache.configure(0) == :ok
+    assert SigCache.stats().bytes == 0
+
+    assert_raise FunctionClauseError, fn -> SigCache.configure(-1) end
+  end
+
+  test "ecdsa" do
+    {seckey, pubkey} = Secp256k1.keypair(:compressed)
+    msg_hash = :crypto.hash(:sha256, "sigcache ecdsa")
+    sig = ECDSA.sign(msg_hash, seckey)
+
+    before = SigCache.stats()
+    assert ECDSA.valid?(sig, msg_hash, pubkey)
+    assert SigCache.stats().misses == before.misses + 1
+    assert SigCache.stats().entries == before.entries + 1
+
+    assert ECDSA.valid?(sig, msg_hash, pubkey)
+    assert ECDSA.valid?(ECDSA.serialize_der(sig), msg_hash, pubkey, der: true)
+    assert SigCache.stats().hits == before.hits + 2
+  end
+
+  test "invalid signatures are not cached" do
+    {seckey, pubkey} = Secp256k1.keypair(:xonly)
+    msg_hash = :crypto.hash(:sha256, "sigcache schnorr")
+    sig = Schnorr.sign(msg_hash, seckey)
+    other = :crypto.hash(:sha256, "other")
+
+    before = SigCache.stats()
+    refute Schnorr.valid?(sig, other, pubkey)
+    refute Schnorr.valid?(sig, other, pubkey)
+    assert SigCache.stats().misses == before.misses + 2
+    assert SigCache.stats().entries == before.entries
+
+    assert Schnorr.valid?(sig, msg_hash, pubkey)
+    assert Schnorr.valid?(sig, msg_hash, pubkey)
+    assert SigCache.stats().hits == before.hits + 1
+  end
+
+  test "nostr events" do
+    {seckey, pubkey} = Secp256k1.keypair(:xonly)
+
+    event = %{
+      "pubkey" => e(pubkey),
+      "created_at" => 1_700_000_000,
+      "kind" => 1,
+      "tags" => [],
+      "content" => "gossip"
+    }
+
+    id = Nostr.event_id(event)
+    event = Map.merge(event, %{"id" => e(id), "sig" => e(Schnorr.sign(id, seckey))})
+
+    before = SigCache.stats()
+    assert Nostr.verify_events([event, event, event]) == [:ok, :ok, :ok]
+    assert SigCache.stats().hits == before.hits + 2
+
+    # the event signature is a plain Schnorr signature of the id
+    assert Schnorr.valid?(d(event["sig"]), id, pubkey)
+    assert SigCache.stats().hits == before.hits + 3
+  end
+
+  test "disabled" do
+    :ok = SigCache.configure(0)
+    {seckey, pubkey} = Secp256k1.keypair(:xonly)
+    msg_hash = :crypto.hash(:sha256, "sigcache disabled")
+    sig = Schnorr.sign(msg_hash, seckey)
+
+    before = SigCache.stats()
+    assert Schnorr.valid?(sig, msg_hash, pubkey)
+    assert Schnorr.valid?(sig, msg_hash, pubkey)
+    assert SigCache.stats() == before
+  end
+end
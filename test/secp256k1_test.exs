@@ -42,6 +42,24 @@ defmodule Secp256k1Test do
     assert pubkey == p
   end
 
+  test "keypairs" do
+    for {type, size} <- [compressed: 33, uncompressed: 65, xonly: 32] do
+      packed = Secp256k1.keypairs(50, type)
+      assert byte_size(packed) == 50 * (32 + size)
+
+      seckeys = for <<seckey::binary-32, _pubkey::binary-size(size) <- packed>>, do: seckey
+      assert length(Enum.uniq(seckeys)) == 50
+
+      for <<seckey::binary-32, pubkey::binary-size(size) <- packed>> do
+        assert Secp256k1.pubkey(seckey, type) == pubkey
+      end
+    end
+
+    assert Secp256k1.keypairs(0, :compressed) == <<>>
+    assert_raise FunctionClauseError, fn -> Secp256k1.keypairs(-1, :compressed) end
+    assert_raise ArgumentError, fn -> Secp256k1.keypairs(2_000_000, :xonly) end
+  end
+
   test "pubkey", %{seckey: s, pubkey: p} do
     # compressed
     pubkey = Secp256k1.pubkey(s, :compressed)
@@ -55,4 +73,23 @@ defmodule Secp256k1Test do
     pubkey = Secp256k1.pubkey(s, :xonly)
     assert pubkey == p
   end
+
+  test "stats", %{seckey: s, pubkey: p, message: m, signature: sig} do
+    # other tests run concurrently, counters can only grow
+    %{operations: before} = Secp256k1.stats()
+
+    refute Secp256k1.schnorr_valid?(<<0::512>>, m, p)
+    assert Secp256k1.schnorr_valid?(sig, m, p)
+    compressed = Secp256k1.pubkey(s, :compressed)
+    {:ok, secnonce, _pubnonce} = Secp256k1.MuSig.nonce_gen(s, compressed, nil, nil, nil)
+
+    %{operations: %{verify: verify}} = stats = Secp256k1.stats()
+    previous = Map.get(before, :verify, %{count: 0, failed: 0})
+
+    assert verify.count >= previous.count + 2
+    assert verify.failed >= previous.failed + 1
+    assert verify.p50_us <= verify.p99_us
+    assert stats.musig_secnonces_live >= 1
+    assert is_reference(secnonce)
+  end
 end